@@ -21,6 +21,8 @@ static const DLDataType kUInt8 = { kDLUInt, 8U, 1U };
 static const DLDataType kUInt16 = { kDLUInt, 16U, 1U };
 static const DLDataType kFloat16 = { kDLFloat, 16U, 1U };
 static const DLDataType kFloat32 = { kDLFloat, 32U, 1U };
+static const DLDataType kInt8 = {kDLInt, 8U, 1U};
+static const DLDataType kInt16 = {kDLInt, 16U, 1U};
 static const DLDataType kInt64 = {kDLInt, 64U, 1U};
 
 /*! \brief check if current date type equals another one */
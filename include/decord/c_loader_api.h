@@ -0,0 +1,97 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file decord/c_loader_api.h
+ * \brief Stable C ABI of VideoLoader for non-Python consumers.
+ *
+ *  Batches are returned as DLPack tensors in a single call, without going through the
+ *  PackedFunc registry, e.g. torch::fromDLPack takes them as is.
+ *
+ *  The common flow is:
+ *   - decord_loader_create, or use a handle created by the Python VideoLoader
+ *   - decord_loader_next until it returns DECORD_LOADER_END, then decord_loader_reset
+ *   - decord_loader_free
+ *
+ *  All functions return 0 when success and -1 when an error occured,
+ *  DECORDGetLastError can be called to retrieve the error.
+ */
+#ifndef DECORD_C_LOADER_API_H_
+#define DECORD_C_LOADER_API_H_
+
+#include "runtime/c_runtime_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Handle to VideoLoader, same as the handle used by the Python VideoLoader */
+typedef void* DECORDLoaderHandle;
+
+/*! \brief Returned by decord_loader_next when the epoch is exhausted */
+#define DECORD_LOADER_END 1
+
+/*!
+ * \brief Create a VideoLoader.
+ * \param uris Comma separated video paths.
+ * \param batch_size Number of frames of each batch.
+ * \param height Output height, -1 for original.
+ * \param width Output width, -1 for original.
+ * \param interval Intra-batch frame interval.
+ * \param skip Inter-batch frame interval.
+ * \param shuffle Shuffling strategy, see VideoLoaderShuffleType.
+ * \param device_type Decoding device, kDLCPU or kDLGPU.
+ * \param device_id Device id.
+ * \param out The created loader.
+ * \return 0 when success, -1 when failure happens
+ */
+DECORD_DLL int decord_loader_create(const char* uris,
+                                    int batch_size,
+                                    int height,
+                                    int width,
+                                    int interval,
+                                    int skip,
+                                    int shuffle,
+                                    int device_type,
+                                    int device_id,
+                                    DECORDLoaderHandle* out);
+
+/*!
+ * \brief Number of batches in each epoch.
+ * \param handle The loader.
+ * \param out The number of batches.
+ * \return 0 when success, -1 when failure happens
+ */
+DECORD_DLL int decord_loader_length(DECORDLoaderHandle handle, int64_t* out);
+
+/*!
+ * \brief Get the next batch, data and indices in one call.
+ *
+ *  Ownership of both tensors goes to the caller, release them with their deleter,
+ *  e.g. DECORDDLManagedTensorCallDeleter. Both are set to NULL at the end of epoch.
+ *
+ * \param handle The loader.
+ * \param data uint8 frames of shape [batch_size, height, width, 3].
+ * \param indices int64 [batch_size, 2], video index and frame index of each frame.
+ * \return 0 when success, DECORD_LOADER_END when the epoch is exhausted, -1 when failure happens
+ */
+DECORD_DLL int decord_loader_next(DECORDLoaderHandle handle,
+                                  DLManagedTensor** data,
+                                  DLManagedTensor** indices);
+
+/*!
+ * \brief Reset loader for next epoch.
+ * \param handle The loader.
+ * \return 0 when success, -1 when failure happens
+ */
+DECORD_DLL int decord_loader_reset(DECORDLoaderHandle handle);
+
+/*!
+ * \brief Free the loader, batches already returned stay valid.
+ * \param handle The loader.
+ * \return 0 when success, -1 when failure happens
+ */
+DECORD_DLL int decord_loader_free(DECORDLoaderHandle handle);
+
+#ifdef __cplusplus
+}  // DECORD_EXTERN_C
+#endif
+#endif  // DECORD_C_LOADER_API_H_
@@ -0,0 +1,150 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file decord/loader_iterator.h
+ * \brief Header only C++ range over VideoLoader batches, built on the C ABI in c_loader_api.h.
+ *
+ * \code
+ *   decord::LoaderRange loader("a.mp4,b.mp4", 8, 224, 224, 1, 0, 2);  // kShuffleBoth
+ *   for (auto& batch : loader) {
+ *       at::Tensor frames = torch::fromDLPack(batch.ReleaseData());
+ *   }
+ * \endcode
+ */
+#ifndef DECORD_LOADER_ITERATOR_H_
+#define DECORD_LOADER_ITERATOR_H_
+
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "c_loader_api.h"
+
+namespace decord {
+
+/*! \brief one batch of VideoLoader, owns its DLPack tensors until released */
+class LoaderBatch {
+ public:
+    LoaderBatch() : data_(nullptr), indices_(nullptr) {}
+    LoaderBatch(DLManagedTensor* data, DLManagedTensor* indices) : data_(data), indices_(indices) {}
+    LoaderBatch(LoaderBatch&& other) : data_(other.data_), indices_(other.indices_) {
+        other.data_ = nullptr;
+        other.indices_ = nullptr;
+    }
+    LoaderBatch& operator=(LoaderBatch&& other) {
+        if (this != &other) {
+            Free();
+            std::swap(data_, other.data_);
+            std::swap(indices_, other.indices_);
+        }
+        return *this;
+    }
+    LoaderBatch(const LoaderBatch&) = delete;
+    LoaderBatch& operator=(const LoaderBatch&) = delete;
+    ~LoaderBatch() { Free(); }
+    /*! \brief uint8 frames [batch_size, height, width, 3] */
+    const DLTensor& data() const { return data_->dl_tensor; }
+    /*! \brief int64 [batch_size, 2], video index and frame index of each frame */
+    const DLTensor& indices() const { return indices_->dl_tensor; }
+    /*! \brief give up ownership of frames, e.g. to torch::fromDLPack */
+    DLManagedTensor* ReleaseData() { return Release(&data_); }
+    /*! \brief give up ownership of indices */
+    DLManagedTensor* ReleaseIndices() { return Release(&indices_); }
+
+ private:
+    static DLManagedTensor* Release(DLManagedTensor** tensor) {
+        DLManagedTensor* ret = *tensor;
+        *tensor = nullptr;
+        return ret;
+    }
+    void Free() {
+        if (data_ && data_->deleter) data_->deleter(data_);
+        if (indices_ && indices_->deleter) indices_->deleter(indices_);
+        data_ = nullptr;
+        indices_ = nullptr;
+    }
+
+    DLManagedTensor* data_;
+    DLManagedTensor* indices_;
+};  // class LoaderBatch
+
+/**
+ * \brief Range over the batches of one epoch, usable in range-based for loops.
+ *
+ * begin() resets the loader, so every loop runs a full epoch. Errors are thrown as std::runtime_error.
+ */
+class LoaderRange {
+ public:
+    /*! \brief input iterator, batches are fetched on increment */
+    class Iterator {
+     public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = LoaderBatch;
+        using difference_type = std::ptrdiff_t;
+        using pointer = LoaderBatch*;
+        using reference = LoaderBatch&;
+
+        explicit Iterator(DECORDLoaderHandle handle = nullptr) : handle_(handle) {
+            if (handle_) Fetch();
+        }
+        reference operator*() { return batch_; }
+        pointer operator->() { return &batch_; }
+        Iterator& operator++() {
+            Fetch();
+            return *this;
+        }
+        /*! \brief iterators only compare equal once exhausted */
+        bool operator==(const Iterator& other) const { return handle_ == nullptr && other.handle_ == nullptr; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+     private:
+        void Fetch() {
+            DLManagedTensor *data = nullptr, *indices = nullptr;
+            int ret = decord_loader_next(handle_, &data, &indices);
+            if (ret < 0) throw std::runtime_error(DECORDGetLastError());
+            batch_ = LoaderBatch(data, indices);
+            if (ret == DECORD_LOADER_END) handle_ = nullptr;
+        }
+
+        DECORDLoaderHandle handle_;
+        LoaderBatch batch_;
+    };  // class Iterator
+
+    /*! \brief create and own a loader, see decord_loader_create */
+    LoaderRange(const std::string& uris, int batch_size, int height, int width,
+                int interval, int skip, int shuffle, DLContext ctx = DLContext{kDLCPU, 0})
+        : handle_(nullptr), owned_(true) {
+        Check(decord_loader_create(uris.c_str(), batch_size, height, width, interval, skip, shuffle,
+                                   ctx.device_type, ctx.device_id, &handle_));
+    }
+    /*! \brief wrap an existing loader handle, e.g. from the Python VideoLoader, not freed */
+    explicit LoaderRange(DECORDLoaderHandle handle) : handle_(handle), owned_(false) {}
+    LoaderRange(const LoaderRange&) = delete;
+    LoaderRange& operator=(const LoaderRange&) = delete;
+    ~LoaderRange() {
+        if (owned_ && handle_) decord_loader_free(handle_);
+    }
+    /*! \brief number of batches in each epoch */
+    int64_t size() const {
+        int64_t len = 0;
+        Check(decord_loader_length(handle_, &len));
+        return len;
+    }
+    Iterator begin() {
+        Check(decord_loader_reset(handle_));
+        return Iterator(handle_);
+    }
+    Iterator end() { return Iterator(); }
+    DECORDLoaderHandle handle() const { return handle_; }
+
+ private:
+    static void Check(int ret) {
+        if (ret != 0) throw std::runtime_error(DECORDGetLastError());
+    }
+
+    DECORDLoaderHandle handle_;
+    bool owned_;
+};  // class LoaderRange
+
+}  // namespace decord
+#endif  // DECORD_LOADER_ITERATOR_H_
@@ -16,6 +16,7 @@
 namespace decord {
 typedef void* VideoReaderInterfaceHandle;
 typedef void* VideoLoaderInterfaceHandle;
+typedef void* VideoWriterInterfaceHandle;
 
 enum VideoLoaderShuffleType {
     kSequential = 0U,
@@ -95,5 +96,23 @@ class VideoLoaderInterface {
         virtual int64_t Length() const = 0;
 };  // class VideoLoaderInterface
 
+/**
+ * \brief Interface of VideoWriter, pure virtual class
+ *
+ */
+class VideoWriterInterface {
+    public:
+        using NDArray = runtime::NDArray;
+        virtual ~VideoWriterInterface() = default;
+        /*! \brief queue a frame [H, W, 3] or a batch [N, H, W, 3] of RGB24 frames for encoding */
+        virtual void Write(NDArray frames) = 0;
+        /*! \brief block until every queued frame is handed to the encoder and produced packets are muxed */
+        virtual void Flush() = 0;
+        /*! \brief drain encoder, finish container and close file, no more writes allowed */
+        virtual void Close() = 0;
+        /*! \brief number of frames queued so far */
+        virtual int64_t GetFrameCount() const = 0;
+};  // class VideoWriterInterface
+
 }  // namespace decord
 #endif // DECORD_VIDEO_INTERFACE_H_
\ No newline at end of file
@@ -9,5 +9,9 @@ from .base import ALL
 
 from .ndarray import cpu, gpu
 from . import bridge
-from .video_reader import VideoReader
-from .video_loader import VideoLoader
+from .video_reader import VideoReader, MultiStreamVideoReader, ImageSequenceReader, ConcatVideoReader
+from .video_reader import ThreadSafeVideoReader, MultiCursorVideoReader, get_batch_multi
+from .video_loader import VideoLoader, VideoClipDataset
+from .video_writer import VideoWriter
+from .packet_reader import PacketReader
+from .memory import set_memory_budget, get_memory_budget, memory_usage
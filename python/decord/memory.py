@@ -0,0 +1,53 @@
+"""Process wide memory budget."""
+from __future__ import absolute_import
+
+from ._ffi.function import _init_api
+
+COMPONENTS = ('cache', 'pool', 'prefetch', 'reader')
+
+
+def set_memory_budget(budget):
+    """Limit memory held by all readers and loaders of the process.
+
+    Past the budget, memory is released in this order: frames decoded ahead by
+    `VideoReader(speculate=...)`, idle buffers of frame pools, batches prefetched by
+    `VideoLoader` (decoded again later, lowering prefetch depth), then decoders of idle
+    readers, least recently used first. A closed decoder is reopened at the same position
+    on next use. Memory in use is never taken away, so usage can still exceed the budget.
+    Decoder memory is estimated from frame size and decoder threads.
+
+    The initial budget is read from the environment variable `DECORD_MEMORY_BUDGET`.
+
+    Parameters
+    ----------
+    budget : int or None
+        Budget in bytes, `None` or 0 for no limit.
+
+    """
+    _CAPI_MemorySetBudget(int(budget or 0))
+
+
+def get_memory_budget():
+    """Get memory budget in bytes, 0 if unlimited."""
+    return _CAPI_MemoryGetBudget()
+
+
+def memory_usage():
+    """Get memory held by each component.
+
+    Returns
+    -------
+    dict
+        For each of 'cache', 'pool', 'prefetch' and 'reader', a dict of 'used' bytes held
+        now and 'released' bytes released to stay within the budget so far. 'total' is the
+        sum of bytes held.
+
+    """
+    values = _CAPI_MemoryGetUsage().asnumpy().tolist()
+    num = len(COMPONENTS)
+    ret = {c: {'used': values[i], 'released': values[num + i]} for i, c in enumerate(COMPONENTS)}
+    ret['total'] = sum(values[:num])
+    return ret
+
+
+_init_api("decord.memory")
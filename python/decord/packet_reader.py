@@ -0,0 +1,127 @@
+"""Demux only packet reader."""
+from __future__ import absolute_import
+
+import ctypes
+from fractions import Fraction
+
+from ._ffi.function import _init_api
+
+PacketReaderHandle = ctypes.c_void_p
+
+
+class PacketReader(object):
+    """Reader of raw compressed packets, no decoding involved.
+
+    Frame indices follow presentation order like `VideoReader`. A requested range is
+    extended to the closest preceding keyframe and packets are returned in decode order,
+    so they can be passed to any decoder, e.g. a hardware decoder on another process.
+
+    Parameters
+    ----------
+    uri : str
+        Path of video file.
+    bitstream_filter : str, default is 'auto'
+        Bitstream filter applied to packets. 'auto' converts H.264/HEVC in mp4 style
+        containers to Annex B, `None` or '' keeps packets untouched, otherwise the name
+        of an FFmpeg bitstream filter, e.g. 'h264_mp4toannexb'.
+    stream : int, default is -1
+        Video stream index, -1 for the best stream.
+
+    """
+    def __init__(self, uri, bitstream_filter='auto', stream=-1):
+        self._handle = None
+        bsf = bitstream_filter if bitstream_filter else ''
+        self._handle = _CAPI_PacketReaderGetPacketReader(uri, stream, bsf)
+        if self._handle is None:
+            raise RuntimeError("Error reading " + uri + "...")
+        self._num_frame = _CAPI_PacketReaderGetFrameCount(self._handle)
+        self._key_indices = _CAPI_PacketReaderGetKeyIndices(self._handle).asnumpy().tolist()
+
+    def __del__(self):
+        if self._handle:
+            _CAPI_PacketReaderFree(self._handle)
+
+    def __len__(self):
+        """Get length of the video, exact since every packet is indexed.
+
+        Returns
+        -------
+        int
+            The length of the video.
+
+        """
+        return self._num_frame
+
+    def get_key_indices(self):
+        """Get list of key frame indices.
+
+        Returns
+        -------
+        list
+            List of key frame indices.
+
+        """
+        return self._key_indices
+
+    def get_avg_fps(self):
+        """Get average FPS(frame per second).
+
+        Returns
+        -------
+        float
+            Average FPS.
+
+        """
+        assert self._handle is not None
+        return _CAPI_PacketReaderGetAverageFPS(self._handle)
+
+    @property
+    def codec_name(self):
+        """Codec name of the stream, e.g. 'h264'."""
+        assert self._handle is not None
+        return _CAPI_PacketReaderGetCodecName(self._handle)
+
+    @property
+    def time_base(self):
+        """Time base of packet pts and dts as `fractions.Fraction`."""
+        assert self._handle is not None
+        return Fraction(_CAPI_PacketReaderGetTimeBase(self._handle))
+
+    @property
+    def extradata(self):
+        """Codec extradata after bitstream filter, uint8 decord.nd.NDArray."""
+        assert self._handle is not None
+        return _CAPI_PacketReaderGetExtradata(self._handle)
+
+    def get_packets(self, start, end):
+        """Get packets of frames in [start, end), keyframe aligned.
+
+        Parameters
+        ----------
+        start : int
+            First frame index.
+        end : int
+            One past the last frame index.
+
+        Returns
+        -------
+        dict of decord.nd.NDArray
+            'data': contiguous uint8 packet bytes,
+            'offsets': int64 byte offsets of packets in data, one more than number of packets,
+            'pts', 'dts': int64 timestamps in `time_base`,
+            'flags': int64 packet flags, bit 0 marks keyframes,
+            'frame_indices': int64 frame index of packets, -1 if unknown.
+            Frames before `start` are only needed for decoding.
+
+        """
+        assert self._handle is not None
+        if start < 0:
+            start += self._num_frame
+        if end < 0:
+            end += self._num_frame
+        _CAPI_PacketReaderReadRange(self._handle, start, end)
+        fields = ('data', 'offsets', 'pts', 'dts', 'flags', 'frame_indices')
+        return {f: _CAPI_PacketReaderGetRangeField(self._handle, f) for f in fields}
+
+
+_init_api("decord.packet_reader")
@@ -8,7 +8,7 @@ from ._ffi.base import c_array, c_str
 from ._ffi.function import _init_api
 from .base import DECORDError
 from . import ndarray as _nd
-from .ndarray import DECORDContext
+from .ndarray import DECORDContext, cpu
 from .bridge import bridge_out
 
 VideoLoaderHandle = ctypes.c_void_p
@@ -20,7 +20,8 @@ class VideoLoader(object):
     Parameters
     ----------
     uris : list of str
-        List of video paths.
+        List of video paths. Directories and glob patterns of images (e.g. extracted frames)
+        are read as image sequences, see `ImageSequenceReader`.
     ctx : decord.Context or list of Context
         The context to decode the video file, can be decord.cpu() or decord.gpu().
         If ctx is a list, videos will be evenly split over many ctxs.
@@ -36,9 +37,44 @@ class VideoLoader(object):
         `1`:  random filename order, no random access for each video, very efficient
         `2`:  random order
         `3`:  random frame access in each video only.
+        `5`:  random order, batches drawn by weight of their video, see `weights`.
+    prefetch : int, default is 0
+        Number of batches decoded ahead in background.
+    on_error : str, default is 'raise'
+        Policy of unreadable videos. 'raise' aborts with an error, 'quarantine' skips
+        the video for the rest of the loader's life and fills the batch with a clip of
+        another video, see `quarantined`.
+    autotune : bool, default is False
+        Tune decoder threads and prefetch depth on the first few hundred batches by
+        measuring throughput. The result is logged and saved in the cache directory
+        (`DECORD_CACHE_DIR`), later loaders on the same files and shape reuse it.
+        `DECORD_AUTOTUNE_BATCHES` overrides the batch budget of tuning, 300 by default.
+        See `config`.
+    memory_cap : int, optional
+        Max memory in bytes of prefetched batches and decoder buffers, configurations
+        above it are not tried by autotuning. This is an estimate, not measured usage:
+        (prefetch + 2) batches plus (decoder threads + 1) frames per video, codec
+        internals are not counted. Use `decord.set_memory_budget` to bound memory
+        actually held at runtime.
+    weights : list of float, optional
+        With shuffle `5`, sampling weight of each video, e.g. inverse class frequency for
+        class balanced batches. A video's weight is shared by its batches, so long videos are
+        not favored. Uniform if not given, see `set_weights`.
+    replacement : bool, default is True
+        With shuffle `5`, draw batches with replacement. Otherwise each batch is drawn at most
+        once per epoch and batches of videos with weight 0 are left out of the epoch.
+    num_shards : int, default is 1
+        With shuffle `5`, number of distributed workers splitting each epoch, all with the
+        same `seed`. Without replacement, workers never get the same batch in an epoch.
+    shard_id : int, default is 0
+        Index of this worker in [0, num_shards).
+    seed : int, default is 0
+        Seed of weighted sampling, varied by epoch.
 
     """
-    def __init__(self, uris, ctx, shape, interval, skip, shuffle, prefetch=0):
+    def __init__(self, uris, ctx, shape, interval, skip, shuffle, prefetch=0, on_error='raise',
+                 autotune=False, memory_cap=None, weights=None, replacement=True, num_shards=1,
+                 shard_id=0, seed=0):
         self._handle = None
         assert isinstance(uris, (list, tuple))
         assert (len(uris) > 0)
@@ -51,8 +87,16 @@ class VideoLoader(object):
         device_ids = _nd.array([x.device_id for x in ctx])
         assert isinstance(shape, (list, tuple))
         assert len(shape) == 4, "expected shape: [bs, height, width, 3], given {}".format(shape)
+        if on_error not in ('raise', 'quarantine'):
+            raise ValueError("on_error must be 'raise' or 'quarantine', given {}".format(on_error))
+        if shuffle != 5 and (weights is not None or num_shards != 1):
+            raise ValueError("weights and num_shards require shuffle=5, given {}".format(shuffle))
+        if weights is None:
+            weights = np.ones(len(uris))
         self._handle = _CAPI_VideoLoaderGetVideoLoader(
-            uri, device_types, device_ids, shape[0], shape[1], shape[2], shape[3], interval, skip, shuffle, prefetch)
+            uri, device_types, device_ids, shape[0], shape[1], shape[2], shape[3], interval, skip, shuffle,
+            prefetch, on_error == 'quarantine', autotune, int(memory_cap or 0),
+            _nd.array(np.asarray(weights, dtype='float64')), replacement, num_shards, shard_id, seed)
         assert self._handle is not None
         self._len = _CAPI_VideoLoaderLength(self._handle)
         self._curr = 0
@@ -72,6 +116,43 @@ class VideoLoader(object):
         """
         return self._len
 
+    @property
+    def config(self):
+        """Decoder threads and prefetch depth in use, and whether autotuning is still running.
+
+        Returns
+        -------
+        dict
+            'decoder_threads': codec threads of each video, 0 lets FFmpeg decide,
+            'prefetch': batches decoded ahead in background,
+            'tuning': True while autotuning measures candidates.
+
+        """
+        assert self._handle is not None
+        threads, prefetch, tuning = _CAPI_VideoLoaderGetConfig(self._handle).asnumpy().tolist()
+        return {'decoder_threads': threads, 'prefetch': prefetch, 'tuning': bool(tuning)}
+
+    @property
+    def quarantined(self):
+        """List of videos skipped as unreadable, only with on_error='quarantine'."""
+        assert self._handle is not None
+        names = _CAPI_VideoLoaderGetQuarantined(self._handle)
+        return names.split('\n') if names else []
+
+    def set_weights(self, weights):
+        """Set sampling weight of each video, only with shuffle `5`.
+
+        Takes effect at next `reset`, the current epoch is not changed.
+
+        Parameters
+        ----------
+        weights : list of float
+            Weight of each video, in order of `uris`.
+
+        """
+        assert self._handle is not None
+        _CAPI_VideoLoaderSetWeights(self._handle, _nd.array(np.asarray(weights, dtype='float64')))
+
     def reset(self):
         """Reset loader for next epoch.
 
@@ -79,6 +160,8 @@ class VideoLoader(object):
         assert self._handle is not None
         self._curr = 0
         _CAPI_VideoLoaderReset(self._handle)
+        # epoch length follows weights without replacement
+        self._len = _CAPI_VideoLoaderLength(self._handle)
 
     def __next__(self):
         """Get the next batch.
@@ -118,4 +201,131 @@ class VideoLoader(object):
         return self
 
 
+class VideoClipDataset(object):
+    """Dataset of trimmed, labeled clips described by an annotation file.
+
+    Frames are sampled uniformly inside each clip's [start, end) interval. Clips of a batch
+    are decoded in parallel, and readers are reused across clips and batches of the same file.
+
+    Parameters
+    ----------
+    annotation : str
+        Path of annotation, a CSV file with header or a JSON array of objects. Required fields
+        are `path` (or `filename`, `video`) and `label` (or `class`), optional `start` and `end`
+        (or `time_start`, `time_end`) in seconds. Labels are used as is if all are integers,
+        otherwise class names are mapped to ids in sorted order, see `classes`.
+    batch_size : int
+        Number of clips per batch.
+    num_frames : int
+        Number of frames sampled from each clip.
+    width : int
+        Frame resize width.
+    height : int
+        Frame resize height.
+    ctx : decord.Context, default is cpu(0)
+        The context to decode the video files.
+    root : str, default is ''
+        Prefix of relative paths in annotation, defaults to directory of annotation.
+    shuffle : bool, default is False
+        Shuffle clip order at each `reset`, and randomly jitter sampled frames within segments.
+    max_open_readers : int, default is 16
+        Maximum number of video readers kept open for reuse.
+
+    """
+    def __init__(self, annotation, batch_size, num_frames, width, height, ctx=cpu(0), root='',
+                 shuffle=False, max_open_readers=16):
+        self._handle = None
+        assert isinstance(ctx, DECORDContext)
+        assert batch_size > 0 and num_frames > 0
+        self._handle = _CAPI_VideoClipDatasetGetVideoClipDataset(
+            annotation, root, ctx.device_type, ctx.device_id, batch_size, num_frames,
+            width, height, int(shuffle), max_open_readers)
+        assert self._handle is not None
+        self._num_clips = _CAPI_VideoClipDatasetNumClips(self._handle)
+        self._len = _CAPI_VideoLoaderLength(self._handle)
+        names = _CAPI_VideoClipDatasetGetClassNames(self._handle)
+        self._classes = names.split('\n') if names else []
+        self._curr = 0
+
+    def __del__(self):
+        if self._handle:
+            _CAPI_VideoLoaderFree(self._handle)
+
+    def __len__(self):
+        """Get number of clips.
+
+        Returns
+        -------
+        int
+            number of annotated clips.
+
+        """
+        return self._num_clips
+
+    @property
+    def num_batches(self):
+        """Number of batches in each epoch, the last incomplete batch is dropped."""
+        return self._len
+
+    @property
+    def classes(self):
+        """Class names ordered by label id, empty if labels are integers in annotation."""
+        return self._classes
+
+    def __getitem__(self, idx):
+        """Get frames and label of a single clip, sampled at segment centers.
+
+        Returns
+        -------
+        ndarray, int
+            Frames of shape (num_frames, height, width, 3) and clip label.
+
+        """
+        if idx < 0:
+            idx += self._num_clips
+        if idx < 0 or idx >= self._num_clips:
+            raise IndexError("Index: {} out of bound: {}".format(idx, self._num_clips))
+        return bridge_out(_CAPI_VideoClipDatasetGetClip(self._handle, idx)), \
+            _CAPI_VideoClipDatasetGetLabel(self._handle, idx)
+
+    def reset(self):
+        """Reset dataset for next epoch.
+
+        """
+        assert self._handle is not None
+        self._curr = 0
+        _CAPI_VideoLoaderReset(self._handle)
+
+    def __next__(self):
+        """Get the next batch.
+
+        Returns
+        -------
+        ndarray, ndarray, ndarray
+            Frame data of shape (batch_size, num_frames, height, width, 3), labels of shape
+            (batch_size,), and [(c0, k0), (c1, k1)...] where c is clip index and k is frame index
+            in video.
+
+        """
+        assert self._handle is not None
+        if self._curr >= self._len:
+            raise StopIteration
+        _CAPI_VideoLoaderNext(self._handle)
+        data = _CAPI_VideoLoaderNextData(self._handle)
+        labels = _CAPI_VideoClipDatasetNextLabels(self._handle)
+        indices = _CAPI_VideoLoaderNextIndices(self._handle)
+        self._curr += 1
+        return bridge_out(data), bridge_out(labels), bridge_out(indices)
+
+    def next(self):
+        """Alias of __next__ for python2.
+
+        """
+        return self.__next__()
+
+    def __iter__(self):
+        assert self._handle is not None
+        return self
+
+
 _init_api("decord.video_loader")
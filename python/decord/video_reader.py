@@ -28,13 +28,50 @@ class VideoReader(object):
         Desired output width of the video, unchanged if `-1` is specified.
     height : int, default is -1
         Desired output height of the video, unchanged if `-1` is specified.
+        If the file contains several renditions (video streams) of the same content and
+        `width` or `height` is specified, the smallest stream no smaller than the output size
+        is decoded, or the largest one if none is large enough.
+    output_format : str, default is 'rgb24'
+        Pixel format of output frames. 'rgb24' and 'gray' output uint8 HxWx3 and HxWx1 frames,
+        'rgb48' outputs uint16 HxWx3 frames keeping high bit-depth sources intact,
+        'p010' and 'yuv420p10' output uint16 (H*3/2)xW frames with luma followed by chroma planes,
+        decoded 10bit frames are passed through without conversion if size is unchanged.
+        Only 'rgb24' is supported by GPU context.
+    tone_mapping : bool, default is False
+        Map HDR10 (PQ) and HLG sources to SDR BT.709, requires 'rgb24' output.
+        SDR sources are not affected.
+    autorotate : bool, default is True
+        Apply rotation and mirroring from the container display matrix (e.g. phone videos)
+        during color conversion. `width` and `height` are always in display orientation.
+        Not supported by GPU context.
+    crop_detect : bool, default is False
+        Detect letterbox/pillarbox black bars once on a few keyframes when the video is indexed,
+        and crop them before scaling. Default `width` and `height` follow the cropped area.
+        Not supported by GPU context.
+    deinterlace : str, default is 'none'
+        Deinterlacing applied to frames flagged as interlaced by the decoder, progressive frames
+        are never touched. 'field' keeps the top field only and scales it to output size, which
+        halves conversion work. 'blend' averages neighbouring lines (linear blend), it requires
+        8bit planar YUV sources and falls back to 'field' otherwise.
+        Not supported by GPU context.
+    speculate : int, default is 0
+        Number of frames decoded ahead in background when requests follow a pattern, e.g.
+        sequential reading, a constant stride or a repeated window. Predicted frames are decoded
+        by a second decoder on the same file and kept in a small cache, 0 disables it.
+        See `get_speculation_stats`.
+    stream : int, default is -1
+        Index of the video stream to decode. `-1` picks one, by output size among several
+        renditions as described above, otherwise FFmpeg's best stream. An explicit index is
+        always decoded as is, whatever `width` and `height`. See `stream`.
 
     """
-    def __init__(self, uri, ctx=cpu(0), width=-1, height=-1):
+    def __init__(self, uri, ctx=cpu(0), width=-1, height=-1, output_format='rgb24', tone_mapping=False,
+                 autorotate=True, crop_detect=False, deinterlace='none', speculate=0, stream=-1):
         assert isinstance(ctx, DECORDContext)
         self._handle = None
         self._handle = _CAPI_VideoReaderGetVideoReader(
-            uri, ctx.device_type, ctx.device_id, width, height)
+            uri, ctx.device_type, ctx.device_id, width, height, output_format, int(tone_mapping),
+            int(autorotate), int(crop_detect), deinterlace, speculate, stream)
         if self._handle is None:
             raise RuntimeError("Error reading " + uri + "...")
         self._num_frame = _CAPI_VideoReaderGetFrameCount(self._handle)
@@ -126,6 +163,143 @@ class VideoReader(object):
         arr = _CAPI_VideoReaderGetBatch(self._handle, indices)
         return bridge_out(arr)
 
+    def get_batch_diff(self, indices, num_diff=1, dtype='int16'):
+        """Get differences of each frame against its previous frame(s), e.g. TSN style RGB diff.
+
+        For index `i`, difference `j` is frame(i - j) - frame(i - j - 1), frames before the
+        first frame are clamped to frame 0. Differences are computed while decoding, neighbour
+        frames are never returned or copied separately.
+
+        Parameters
+        ----------
+        indices : list of integers
+            A list of non-negative frame indices.
+        num_diff : int, default is 1
+            Number of stacked differences per index.
+        dtype : str, default is 'int16'
+            'int16' for exact differences, 'int8' for halved differences,
+            'float32' for differences normalized to [-1, 1].
+
+        Returns
+        -------
+        ndarray
+            Differences with shape N x num_diff x H x W x 3.
+
+        """
+        assert self._handle is not None
+        assert dtype in ('int16', 'int8', 'float32'), "Invalid dtype: {}".format(dtype)
+        indices = np.array(indices, dtype=np.int64)
+        indices[indices < 0] += self._num_frame
+        if not ((indices >= 0).all() and (indices < self._num_frame).all()):
+            raise IndexError('Out of bound indices: {}'.format(indices))
+        arr = _CAPI_VideoReaderGetBatchDiff(self._handle, _nd.array(indices), num_diff, dtype)
+        return bridge_out(arr)
+
+    def get_batch_stream(self, indices, callback, chunk_size=16):
+        """Stream frames to `callback` chunk by chunk as soon as they are decoded, e.g. for
+        feature extraction over thousands of frames. Frames are visited in ascending order,
+        the next chunks are decoded in background while `callback` runs, so memory stays
+        bounded by a few chunks and processing overlaps decoding.
+
+        Parameters
+        ----------
+        indices : list of integers
+            A list of frame indices.
+        callback : callable
+            Called as `callback(frames, positions)` from the calling thread, `frames` is a
+            batch of shape KxHxWx3 and `positions` an int64 numpy array with the position of
+            each frame in `indices`. Return `False` to stop early.
+        chunk_size : int, default is 16
+            Maximum number of frames per chunk.
+
+        """
+        assert self._handle is not None
+        indices = np.array(indices, dtype=np.int64)
+        indices[indices < 0] += self._num_frame
+        if not ((indices >= 0).all() and (indices < self._num_frame).all()):
+            raise IndexError('Out of bound indices: {}'.format(indices))
+
+        def _callback(frames, positions):
+            # frames are only valid during the call, hand out an owned copy
+            return callback(bridge_out(frames.copyto(frames.ctx)), positions.asnumpy())
+        _CAPI_VideoReaderGetBatchStream(self._handle, _nd.array(indices), chunk_size, _callback)
+
+    def get_batch_deadline(self, indices, timeout_ms, fill='nearest'):
+        """Get batch of frames within a time budget, e.g. for online serving.
+
+        Distinct frames are decoded in ascending order until `timeout_ms` has passed,
+        the check happens between frames, so one frame (and the seek it needs) may overrun.
+        The first frame is always decoded. The reader stays usable for the next call.
+
+        Parameters
+        ----------
+        indices : list of integers
+            A list of frame indices.
+        timeout_ms : float
+            Time budget in milliseconds.
+        fill : str, default is 'nearest'
+            How slots missing the deadline are filled, 'nearest' copies the closest decoded
+            frame, 'zeros' leaves them black.
+
+        Returns
+        -------
+        (ndarray, numpy.ndarray)
+            Frames with shape NxHxWx3 and a boolean mask of length N, True where the slot
+            holds the requested frame.
+
+        """
+        assert self._handle is not None
+        assert fill in ('nearest', 'zeros'), "Invalid fill: {}".format(fill)
+        indices = np.array(indices, dtype=np.int64)
+        indices[indices < 0] += self._num_frame
+        if not ((indices >= 0).all() and (indices < self._num_frame).all()):
+            raise IndexError('Out of bound indices: {}'.format(indices))
+        mask = _nd.empty((len(indices),), dtype='uint8')
+        arr = _CAPI_VideoReaderGetBatchDeadline(
+            self._handle, _nd.array(indices), float(timeout_ms), int(fill == 'nearest'), mask)
+        return bridge_out(arr), mask.asnumpy().astype(bool)
+
+    def get_batch_flow(self, indices, stride=1, downscale=2, bound=20.):
+        """Get batch of frames together with dense optical flow of each frame.
+
+        Flow of frame `i` points to frame `i + stride` (the last frame at the end of video), and
+        is computed on the luma plane downscaled by `downscale`, in parallel across frame pairs.
+
+        Parameters
+        ----------
+        indices : list of integers
+            A list of non-negative frame indices.
+        stride : int, default is 1
+            Distance to the second frame of each flow pair.
+        downscale : int, default is 2
+            Integer downscale factor of frames before computing flow.
+        bound : float, default is 20.
+            Flow in pixels of the downscaled plane is clipped to [-bound, bound] and quantized
+            linearly to [0, 255], 128 means still.
+
+        Returns
+        -------
+        ndarray, ndarray
+            Frames with shape NxHxWx3 and flow with shape Nx(H/downscale)x(W/downscale)x2,
+            (dx, dy) as the last dimension.
+
+        """
+        assert self._handle is not None
+        indices = np.array(indices, dtype=np.int64)
+        indices[indices < 0] += self._num_frame
+        if not ((indices >= 0).all() and (indices < self._num_frame).all()):
+            raise IndexError('Out of bound indices: {}'.format(indices))
+        indices = _nd.array(indices)
+        arr = _CAPI_VideoReaderGetBatch(self._handle, indices)
+        flow = _CAPI_VideoReaderGetBatchFlow(self._handle, indices, arr, stride, downscale, float(bound))
+        return bridge_out(arr), bridge_out(flow)
+
+    @property
+    def stream(self):
+        """Index of the decoded video stream."""
+        assert self._handle is not None
+        return _CAPI_VideoReaderGetVideoStream(self._handle)
+
     def get_key_indices(self):
         """Get list of key frame indices.
 
@@ -148,6 +322,40 @@ class VideoReader(object):
         """
         return self._avg_fps
 
+    def get_error_counts(self):
+        """Get number of errors tolerated so far.
+
+        Corrupt packets are concealed with the previous decoded frame and unreadable
+        packets are skipped instead of aborting.
+
+        Returns
+        -------
+        dict
+            'decode': frames concealed after decoder errors,
+            'demux': packets skipped after read errors.
+
+        """
+        assert self._handle is not None
+        values = _CAPI_VideoReaderGetErrorCounts(self._handle).asnumpy().tolist()
+        return dict(zip(('decode', 'demux'), values))
+
+    def get_speculation_stats(self):
+        """Get statistics of speculative decoding, requires `speculate` > 0.
+
+        Returns
+        -------
+        dict
+            'requests': frames requested,
+            'hits': requests served by frames decoded ahead,
+            'decoded': frames decoded ahead,
+            'wasted': frames decoded ahead and evicted before use,
+            'cancelled': predictions dropped since requests changed pattern.
+
+        """
+        assert self._handle is not None
+        values = _CAPI_VideoReaderGetSpeculationStats(self._handle).asnumpy().tolist()
+        return dict(zip(('requests', 'hits', 'decoded', 'wasted', 'cancelled'), values))
+
     def seek(self, pos):
         """Fast seek to frame position, this does not guarantee accurate position.
         To obtain accurate seeking, see `accurate_seek`.
@@ -195,4 +403,303 @@ class VideoReader(object):
         assert num > 0
         _CAPI_VideoReaderSkipFrames(self._handle, num)
 
+
+class MultiStreamVideoReader(VideoReader):
+    """Video reader decoding several video streams (e.g. camera angles) of one file at once.
+    The file is demuxed only once, each stream is decoded by its own decoder in parallel.
+
+    Frame indices refer to the reference stream (the first active stream), other streams
+    return the frame closest in presentation time, so frames are aligned in time.
+
+    Parameters
+    ----------
+    uri : str
+        Path of video file.
+    ctx : decord.Context
+        The context to decode the video file, only decord.cpu() is supported.
+    streams : list of int, optional
+        Indices of the video streams to activate, all video streams are used if not specified.
+    width : int, default is -1
+        Desired output width of all streams, follows the reference stream if `-1` is specified.
+    height : int, default is -1
+        Desired output height of all streams, follows the reference stream if `-1` is specified.
+
+    """
+    def __init__(self, uri, ctx=cpu(0), streams=None, width=-1, height=-1):
+        # pylint: disable=super-init-not-called
+        assert isinstance(ctx, DECORDContext)
+        self._handle = None
+        streams = [-1] if not streams else list(streams)
+        self._handle = _CAPI_VideoReaderGetMultiStreamReader(
+            uri, ctx.device_type, ctx.device_id, width, height,
+            _nd.array(np.array(streams, dtype=np.int64)))
+        if self._handle is None:
+            raise RuntimeError("Error reading " + uri + "...")
+        self._num_frame = _CAPI_VideoReaderGetFrameCount(self._handle)
+        assert self._num_frame > 0, "Invalid frame count: {}".format(self._num_frame)
+        self._key_indices = _CAPI_VideoReaderGetKeyIndices(self._handle).asnumpy().tolist()
+        self._avg_fps = _CAPI_VideoReaderGetAverageFPS(self._handle)
+        self._streams = _CAPI_VideoReaderGetActiveStreams(self._handle).asnumpy().tolist()
+
+    @property
+    def streams(self):
+        """Indices of the active video streams, in output order.
+
+        Returns
+        -------
+        list of int
+            Stream indices in the container.
+
+        """
+        return self._streams
+
+    def get_batch(self, indices):
+        """Get time aligned frames from all active streams.
+
+        Parameters
+        ----------
+        indices : list of integers
+            A list of non-negative frame indices of the reference stream.
+
+        Returns
+        -------
+        ndarray
+            Frames with shape SxNxHxWx3, where S is the number of active streams
+            and N is the length of `indices`.
+
+        """
+        return super(MultiStreamVideoReader, self).get_batch(indices)
+
+
+class ImageSequenceReader(VideoReader):
+    """Reader presenting a directory of images (e.g. extracted JPEG frames) as a video.
+    Images are sorted in natural order of file names, every frame is a keyframe and
+    batches are decoded in parallel.
+
+    Parameters
+    ----------
+    uri : str
+        Directory of images, or glob pattern such as `frames/*.jpg`.
+        JPEG, PNG, BMP, TIFF and WebP files are recognized.
+    ctx : decord.Context
+        The context to decode the images, only decord.cpu() is supported.
+    width : int, default is -1
+        Desired output width, follows the first image if `-1` is specified.
+    height : int, default is -1
+        Desired output height, follows the first image if `-1` is specified.
+    output_format : str, default is 'rgb24'
+        Pixel format of output frames, same as `VideoReader`.
+    fps : float, default is 25.0
+        Nominal frame rate reported by `get_avg_fps`.
+
+    """
+    def __init__(self, uri, ctx=cpu(0), width=-1, height=-1, output_format='rgb24', fps=25.0):
+        # pylint: disable=super-init-not-called
+        assert isinstance(ctx, DECORDContext)
+        self._handle = None
+        self._handle = _CAPI_VideoReaderGetImageSequenceReader(
+            uri, ctx.device_type, ctx.device_id, width, height, output_format, float(fps))
+        if self._handle is None:
+            raise RuntimeError("Error reading " + uri + "...")
+        self._num_frame = _CAPI_VideoReaderGetFrameCount(self._handle)
+        assert self._num_frame > 0, "Invalid frame count: {}".format(self._num_frame)
+        self._key_indices = _CAPI_VideoReaderGetKeyIndices(self._handle).asnumpy().tolist()
+        self._avg_fps = _CAPI_VideoReaderGetAverageFPS(self._handle)
+
+
+class ConcatVideoReader(VideoReader):
+    """Reader presenting segmented recordings (e.g. 1 minute dashcam clips) as one video
+    with global frame indices and timestamps. Only container headers of later segments are
+    read on construction, their readers are opened on first access and the next segment
+    is opened in background during sequential reads.
+
+    Parameters
+    ----------
+    uris : list of str or str
+        Ordered segment paths, or a local playlist file (.m3u8/.m3u or ffconcat .ffconcat/.txt).
+    ctx : decord.Context
+        The context to decode the video files, can be decord.cpu() or decord.gpu().
+    width : int, default is -1
+        Desired output width, follows the first segment if `-1` is specified.
+    height : int, default is -1
+        Desired output height, follows the first segment if `-1` is specified.
+    output_format : str, default is 'rgb24'
+        Pixel format of output frames, same as `VideoReader`.
+
+    """
+    def __init__(self, uris, ctx=cpu(0), width=-1, height=-1, output_format='rgb24'):
+        # pylint: disable=super-init-not-called
+        assert isinstance(ctx, DECORDContext)
+        self._handle = None
+        if isinstance(uris, (list, tuple)):
+            # paths are kept verbatim, commas and spaces are valid in file names
+            uri = '\n'.join(uris)
+        else:
+            uri = uris
+        self._handle = _CAPI_VideoReaderGetConcatReader(
+            uri, ctx.device_type, ctx.device_id, width, height, output_format)
+        if self._handle is None:
+            raise RuntimeError("Error reading " + uri + "...")
+        self._num_frame = _CAPI_VideoReaderGetFrameCount(self._handle)
+        assert self._num_frame > 0, "Invalid frame count: {}".format(self._num_frame)
+        self._key_indices = _CAPI_VideoReaderGetKeyIndices(self._handle).asnumpy().tolist()
+        self._avg_fps = _CAPI_VideoReaderGetAverageFPS(self._handle)
+
+    def get_frame_timestamp(self, idx):
+        """Get presentation time of frame at global index `idx`.
+
+        Parameters
+        ----------
+        idx : int
+            Global frame index.
+
+        Returns
+        -------
+        float
+            Timestamp in seconds since start of the first segment.
+
+        """
+        if idx < 0:
+            idx += self._num_frame
+        return _CAPI_VideoReaderGetFrameTimestamp(self._handle, idx)
+
+
+class ThreadSafeVideoReader(VideoReader):
+    """Video reader safe to share between threads, e.g. by workers of a thread pool.
+
+    The file is opened and indexed once. Each concurrent `get_batch` borrows a cursor
+    (own demuxer and decoder) from a small pool, cursors are cloned on demand without
+    scanning the file again. Frame access by index goes through `get_batch` as well.
+
+    Parameters
+    ----------
+    uri : str
+        Path of video file.
+    ctx : decord.Context
+        The context to decode the video file, can be decord.cpu() or decord.gpu().
+    width : int, default is -1
+        Desired output width of the video, unchanged if `-1` is specified.
+    height : int, default is -1
+        Desired output height of the video, unchanged if `-1` is specified.
+    output_format : str, default is 'rgb24'
+        Pixel format of output frames, same as `VideoReader`.
+    max_cursors : int, default is 4
+        Maximum number of concurrent `get_batch` calls, others wait for a free cursor.
+        0 for number of CPU cores.
+    park : bool, default is False
+        Open new cursors up to `max_cursors` before moving any, see `MultiCursorVideoReader`.
+
+    """
+    def __init__(self, uri, ctx=cpu(0), width=-1, height=-1, output_format='rgb24', max_cursors=4,
+                 park=False):
+        # pylint: disable=super-init-not-called
+        assert isinstance(ctx, DECORDContext)
+        self._handle = None
+        self._handle = _CAPI_VideoReaderGetThreadSafeReader(
+            uri, ctx.device_type, ctx.device_id, width, height, output_format, max_cursors,
+            int(park))
+        if self._handle is None:
+            raise RuntimeError("Error reading " + uri + "...")
+        self._num_frame = _CAPI_VideoReaderGetFrameCount(self._handle)
+        assert self._num_frame > 0, "Invalid frame count: {}".format(self._num_frame)
+        self._key_indices = _CAPI_VideoReaderGetKeyIndices(self._handle).asnumpy().tolist()
+        self._avg_fps = _CAPI_VideoReaderGetAverageFPS(self._handle)
+
+    def __getitem__(self, idx):
+        if isinstance(idx, slice):
+            return self.get_batch(range(*idx.indices(len(self))))
+        # seek then next would race with other threads, a single call does not
+        return self.get_batch([idx])[0]
+
+    @property
+    def num_cursors(self):
+        """Number of cursors opened so far."""
+        return _CAPI_VideoReaderGetNumCursors(self._handle)
+
+    def get_cursor_stats(self):
+        """Get cursor routing statistics.
+
+        Returns
+        -------
+        dict
+            'requests': number of `get_batch` calls,
+            'hits': requests served by decoding forward within the GOP of a cursor, no seek,
+            'seeks': requests that needed a seek,
+            'opened': cursors opened,
+            'recycled': parked cursors moved to another region.
+
+        """
+        values = _CAPI_VideoReaderGetCursorStats(self._handle).asnumpy().tolist()
+        return dict(zip(('requests', 'hits', 'seeks', 'opened', 'recycled'), values))
+
+
+class MultiCursorVideoReader(ThreadSafeVideoReader):
+    """Video reader keeping several decoder cursors parked at different positions, for
+    workloads alternating between a few regions of a long video (e.g. annotated events).
+
+    Each request goes to the cursor that reaches its first frame by decoding forward within
+    its GOP, avoiding a seek and a GOP decode. Otherwise a new cursor is opened until
+    `num_cursors` exist, after that the least recently used cursor is moved.
+    Use `get_cursor_stats` to check how many seeks are avoided.
+
+    Parameters
+    ----------
+    uri : str
+        Path of video file.
+    ctx : decord.Context
+        The context to decode the video file, can be decord.cpu() or decord.gpu().
+    width : int, default is -1
+        Desired output width of the video, unchanged if `-1` is specified.
+    height : int, default is -1
+        Desired output height of the video, unchanged if `-1` is specified.
+    output_format : str, default is 'rgb24'
+        Pixel format of output frames, same as `VideoReader`.
+    num_cursors : int, default is 4
+        Number of parked cursors, each holds one demuxer and decoder.
+
+    """
+    def __init__(self, uri, ctx=cpu(0), width=-1, height=-1, output_format='rgb24', num_cursors=4):
+        super(MultiCursorVideoReader, self).__init__(
+            uri, ctx, width, height, output_format, max_cursors=num_cursors, park=True)
+
+
+def get_batch_multi(readers, indices, out=None):
+    """Get batches of several readers with a single call, e.g. one clip from each of 32 videos.
+    Readers are decoded concurrently on the worker pool and frames are stacked in order.
+
+    Parameters
+    ----------
+    readers : list of VideoReader
+        Readers to decode from, the same reader may appear more than once.
+        Frames of all readers must have the same shape and dtype.
+        `MultiStreamVideoReader` is not supported.
+    indices : list of list of integers
+        Frame indices for each reader.
+    out : decord.nd.NDArray, optional
+        Preallocated output of shape (sum of lengths of `indices`, H, W, C), every reader
+        decodes straight into its slice of it.
+
+    Returns
+    -------
+    ndarray
+        Stacked frames with shape NxHxWx3, where N is the total length of `indices`.
+
+    """
+    assert len(readers) == len(indices), "{} readers but {} index lists".format(
+        len(readers), len(indices))
+    args = []
+    for reader, idx in zip(readers, indices):
+        assert reader._handle is not None
+        assert not isinstance(reader, MultiStreamVideoReader), "Multiple streams can not be stacked"
+        # pylint: disable=protected-access
+        num_frame = reader._num_frame
+        idx = np.array(idx, dtype=np.int64).reshape(-1)
+        idx[idx < 0] += num_frame
+        if not ((idx >= 0) & (idx < num_frame)).all():
+            raise IndexError('Out of bound indices: {}'.format(idx[(idx < 0) | (idx >= num_frame)]))
+        args += [reader._handle, _nd.array(idx)]
+    arr = _CAPI_VideoReaderGetBatchMulti(out, *args)
+    return bridge_out(arr)
+
+
 _init_api("decord.video_reader")
@@ -0,0 +1,115 @@
+"""Video Writer."""
+from __future__ import absolute_import
+
+import ctypes
+import numpy as np
+
+from ._ffi.function import _init_api
+from . import ndarray as _nd
+from .bridge import bridge_in
+
+VideoWriterHandle = ctypes.c_void_p
+
+
+class VideoWriter(object):
+    """Threaded video writer encoding RGB frames.
+
+    Frames are copied on `write`; conversion to the encoder pixel format, encoding and
+    muxing run on background threads. `write` blocks only when `queue_size` frames are
+    already waiting for the encoder.
+
+    Parameters
+    ----------
+    uri : str
+        Path of output file, container is deduced from extension.
+    fps : float
+        Frame rate.
+    width : int, default is -1
+        Output width, follows the first frame if `-1` is specified.
+    height : int, default is -1
+        Output height, follows the first frame if `-1` is specified.
+    codec : str, default is ''
+        Encoder name, e.g. 'libx264', 'mpeg4'. Default encoder of the container if empty.
+    pix_fmt : str, default is ''
+        Encoder pixel format, e.g. 'yuv420p'. Prefers yuv420p if supported by encoder when empty.
+    bit_rate : int, default is 0
+        Target bit rate, encoder default if 0.
+    thread_type : str, default is 'frame'
+        Encoder threading, 'frame' or 'slice'.
+    thread_count : int, default is 0
+        Number of encoder threads, 0 for auto.
+    options : dict, default is None
+        Private encoder options, e.g. {'crf': 23, 'preset': 'fast'}.
+    queue_size : int, default is 16
+        Maximum number of frames in flight before `write` blocks.
+
+    """
+    def __init__(self, uri, fps, width=-1, height=-1, codec='', pix_fmt='', bit_rate=0,
+                 thread_type='frame', thread_count=0, options=None, queue_size=16):
+        self._handle = None
+        assert fps > 0, "Invalid fps: {}".format(fps)
+        assert thread_type in ('frame', 'slice'), "Invalid thread type: {}".format(thread_type)
+        options = options if options else {}
+        opts = ','.join(['{}={}'.format(k, v) for k, v in options.items()])
+        self._handle = _CAPI_VideoWriterGetVideoWriter(
+            uri, float(fps), width, height, codec, pix_fmt, bit_rate, thread_type,
+            thread_count, opts, queue_size)
+        if self._handle is None:
+            raise RuntimeError("Error creating " + uri + "...")
+
+    def __del__(self):
+        if self._handle:
+            _CAPI_VideoWriterFree(self._handle)
+
+    def __len__(self):
+        """Number of frames written so far.
+
+        Returns
+        -------
+        int
+            Number of frames.
+
+        """
+        assert self._handle is not None
+        return _CAPI_VideoWriterGetFrameCount(self._handle)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def write(self, frames):
+        """Queue frames for encoding.
+
+        Parameters
+        ----------
+        frames : decord.nd.NDArray or numpy.ndarray
+            A uint8 RGB frame of shape (H, W, 3) or a batch of shape (N, H, W, 3).
+            Frames not matching writer size are scaled.
+
+        """
+        assert self._handle is not None
+        if isinstance(frames, np.ndarray):
+            # writer copies frames, no need to copy here
+            frames = _nd.zerocopy_from_numpy(np.ascontiguousarray(frames))
+        elif not isinstance(frames, _nd.NDArray):
+            frames = bridge_in(frames)
+        _CAPI_VideoWriterWrite(self._handle, frames)
+
+    def flush(self):
+        """Block until all queued frames are encoded and their packets are written.
+
+        """
+        assert self._handle is not None
+        _CAPI_VideoWriterFlush(self._handle)
+
+    def close(self):
+        """Drain encoder and finish file, no more writes are allowed.
+
+        """
+        assert self._handle is not None
+        _CAPI_VideoWriterClose(self._handle)
+
+
+_init_api("decord.video_writer")
@@ -0,0 +1,72 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file crop_detect.cc
+ * \brief Letterbox/pillarbox detection on luma plane
+ */
+
+#include "crop_detect.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace decord {
+namespace improc {
+
+CropRect DetectActiveArea(const uint8_t *luma, int linesize, int pixel_stride, int bit_depth,
+                          int width, int height, int limit) {
+    CropRect rect;
+    if (width < 2 || height < 2) return rect;
+    const int64_t thresh = static_cast<int64_t>(limit) << std::max(bit_depth - 8, 0);
+    // single pass over the plane, row sums and column sums together
+    std::vector<int64_t> row_sum(height, 0);
+    std::vector<int64_t> col_sum(width, 0);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *line = luma + static_cast<int64_t>(y) * linesize;
+        int64_t sum = 0;
+        if (bit_depth > 8) {
+            for (int x = 0; x < width; ++x) {
+                const uint8_t *p = line + x * pixel_stride;
+                int v = p[0] | (p[1] << 8);
+                sum += v;
+                col_sum[x] += v;
+            }
+        } else {
+            for (int x = 0; x < width; ++x) {
+                int v = line[x * pixel_stride];
+                sum += v;
+                col_sum[x] += v;
+            }
+        }
+        row_sum[y] = sum;
+    }
+
+    int y1 = 0, y2 = height - 1, x1 = 0, x2 = width - 1;
+    while (y1 < height && row_sum[y1] <= thresh * width) ++y1;
+    if (y1 == height) return rect;  // all black
+    while (y2 > y1 && row_sum[y2] <= thresh * width) --y2;
+    while (x1 < width && col_sum[x1] <= thresh * height) ++x1;
+    if (x1 == width) return rect;
+    while (x2 > x1 && col_sum[x2] <= thresh * height) --x2;
+
+    // even aligned, rounding inwards
+    rect.x = (x1 + 1) & ~1;
+    rect.y = (y1 + 1) & ~1;
+    rect.width = ((x2 + 1) & ~1) - rect.x;
+    rect.height = ((y2 + 1) & ~1) - rect.y;
+    if (rect.Empty()) return CropRect();
+    return rect;
+}
+
+CropRect UnionRect(const CropRect& a, const CropRect& b) {
+    if (a.Empty()) return b;
+    if (b.Empty()) return a;
+    CropRect rect;
+    rect.x = std::min(a.x, b.x);
+    rect.y = std::min(a.y, b.y);
+    rect.width = std::max(a.x + a.width, b.x + b.width) - rect.x;
+    rect.height = std::max(a.y + a.height, b.y + b.height) - rect.y;
+    return rect;
+}
+
+}  // namespace improc
+}  // namespace decord
@@ -0,0 +1,52 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file crop_detect.h
+ * \brief Letterbox/pillarbox detection on luma plane
+ */
+
+#ifndef DECORD_IMPROC_CROP_DETECT_H_
+#define DECORD_IMPROC_CROP_DETECT_H_
+
+#include <stdint.h>
+
+namespace decord {
+namespace improc {
+
+/*! \brief Rectangle in pixels, width 0 means empty */
+struct CropRect {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    CropRect() : x(0), y(0), width(0), height(0) {}
+    bool Empty() const { return width <= 0 || height <= 0; }
+};  // struct CropRect
+
+/**
+ * \brief Detect active picture area, cropdetect style.
+ *
+ * Rows and columns whose mean luma does not exceed `limit` are treated as black borders.
+ * Returned rectangle is aligned to even coordinates so it can be applied on 4:2:0 frames.
+ *
+ * \param luma Luma plane
+ * \param linesize Line size in bytes
+ * \param pixel_stride Distance between two luma samples in bytes
+ * \param bit_depth Luma bit depth, samples above 8bit are little endian 16bit
+ * \param width Frame width
+ * \param height Frame height
+ * \param limit Black threshold in 8bit scale, scaled with bit depth
+ * \return CropRect Active area, empty if the whole frame is black
+ */
+CropRect DetectActiveArea(const uint8_t *luma, int linesize, int pixel_stride, int bit_depth,
+                          int width, int height, int limit = 24);
+
+/**
+ * \brief Smallest rectangle containing both, empty rectangles are ignored
+ */
+CropRect UnionRect(const CropRect& a, const CropRect& b);
+
+}  // namespace improc
+}  // namespace decord
+
+#endif  // DECORD_IMPROC_CROP_DETECT_H_
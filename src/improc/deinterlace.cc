@@ -0,0 +1,47 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file deinterlace.cc
+ * \brief CPU deinterlacing kernels
+ */
+
+#include "deinterlace.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace decord {
+namespace improc {
+
+namespace detail {
+inline uint8_t Avg(uint8_t a, uint8_t b) {
+    return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+}  // namespace detail
+
+void LinearBlendPlane(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                      int width, int height) {
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *a = src + static_cast<int64_t>(std::max(y - 1, 0)) * src_stride;
+        const uint8_t *b = src + static_cast<int64_t>(y) * src_stride;
+        const uint8_t *c = src + static_cast<int64_t>(std::min(y + 1, height - 1)) * src_stride;
+        uint8_t *d = dst + static_cast<int64_t>(y) * dst_stride;
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 16 <= width; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+            __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), _mm_avg_epu8(_mm_avg_epu8(va, vc), vb));
+        }
+#endif
+        for (; x < width; ++x) {
+            d[x] = detail::Avg(detail::Avg(a[x], c[x]), b[x]);
+        }
+    }
+}
+
+}  // namespace improc
+}  // namespace decord
@@ -0,0 +1,34 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file deinterlace.h
+ * \brief CPU deinterlacing kernels
+ */
+
+#ifndef DECORD_IMPROC_DEINTERLACE_H_
+#define DECORD_IMPROC_DEINTERLACE_H_
+
+#include <stdint.h>
+
+namespace decord {
+namespace improc {
+
+/**
+ * \brief Linear blend deinterlace of one 8bit plane.
+ *
+ * Each output line is avg(avg(above, below), line), i.e. a [1 2 1] / 4 vertical filter with
+ * SSE2 pavgb rounding, first and last lines reuse themselves as missing neighbour.
+ *
+ * \param src Source plane
+ * \param src_stride Source line size in bytes
+ * \param dst Destination plane, must not overlap source
+ * \param dst_stride Destination line size in bytes
+ * \param width Line width in bytes
+ * \param height Number of lines
+ */
+void LinearBlendPlane(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                      int width, int height);
+
+}  // namespace improc
+}  // namespace decord
+
+#endif  // DECORD_IMPROC_DEINTERLACE_H_
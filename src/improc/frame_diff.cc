@@ -0,0 +1,58 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file frame_diff.cc
+ * \brief CPU temporal difference of 8bit frames
+ */
+
+#include "frame_diff.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace decord {
+namespace improc {
+
+void FrameDiff(const uint8_t *a, const uint8_t *b, int64_t size, DiffType type, void *dst) {
+    int64_t i = 0;
+    const float kInv255 = 1.f / 255.f;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vscale = _mm_set1_ps(kInv255);
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+        if (type == kDiffInt16) {
+            int16_t *d = static_cast<int16_t*>(dst) + i;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), hi);
+        } else if (type == kDiffInt8) {
+            int8_t *d = static_cast<int8_t*>(dst) + i;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d),
+                             _mm_packs_epi16(_mm_srai_epi16(lo, 1), _mm_srai_epi16(hi, 1)));
+        } else {
+            float *d = static_cast<float*>(dst) + i;
+            // sign extend 16bit to 32bit by unpacking into the high half and shifting back
+            _mm_storeu_ps(d, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(zero, lo), 16)), vscale));
+            _mm_storeu_ps(d + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(zero, lo), 16)), vscale));
+            _mm_storeu_ps(d + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(zero, hi), 16)), vscale));
+            _mm_storeu_ps(d + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(zero, hi), 16)), vscale));
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        if (type == kDiffInt16) {
+            static_cast<int16_t*>(dst)[i] = static_cast<int16_t>(diff);
+        } else if (type == kDiffInt8) {
+            static_cast<int8_t*>(dst)[i] = static_cast<int8_t>(diff >> 1);
+        } else {
+            static_cast<float*>(dst)[i] = diff * kInv255;
+        }
+    }
+}
+
+}  // namespace improc
+}  // namespace decord
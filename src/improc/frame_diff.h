@@ -0,0 +1,36 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file frame_diff.h
+ * \brief CPU temporal difference of 8bit frames
+ */
+
+#ifndef DECORD_IMPROC_FRAME_DIFF_H_
+#define DECORD_IMPROC_FRAME_DIFF_H_
+
+#include <stdint.h>
+
+namespace decord {
+namespace improc {
+
+/*! \brief output encoding of frame differences */
+enum DiffType {
+    kDiffInt16 = 0,  // a - b, exact
+    kDiffInt8,       // (a - b) >> 1, halved to fit
+    kDiffFloat32,    // (a - b) / 255, in [-1, 1]
+};  // enum DiffType
+
+/**
+ * \brief Element wise difference a - b of two 8bit buffers, 16 bytes per SSE2 iteration.
+ *
+ * \param a Minuend, e.g. the later frame
+ * \param b Subtrahend, e.g. the earlier frame
+ * \param size Number of bytes
+ * \param type Output encoding
+ * \param dst Output of size elements of int16, int8 or float depending on type
+ */
+void FrameDiff(const uint8_t *a, const uint8_t *b, int64_t size, DiffType type, void *dst);
+
+}  // namespace improc
+}  // namespace decord
+
+#endif  // DECORD_IMPROC_FRAME_DIFF_H_
@@ -0,0 +1,293 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file optical_flow.cc
+ * \brief CPU dense optical flow on luma planes
+ */
+
+#include "optical_flow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace decord {
+namespace improc {
+namespace detail {
+
+/*! \brief coarsest pyramid level is kept at least this size */
+static const int kMinLevelSize = 16;
+/*! \brief Tikhonov regularization per window pixel, keeps flat areas still instead of unstable */
+static const float kRegularization = 1.f;
+
+using Plane = std::vector<float>;
+
+inline int Clamp(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/*! \brief 2x2 average, odd last row and column are dropped */
+void Downsample(const float *src, int w, int h, float *dst) {
+    const int dw = w / 2, dh = h / 2;
+    for (int y = 0; y < dh; ++y) {
+        const float *s0 = src + static_cast<int64_t>(2 * y) * w;
+        const float *s1 = s0 + w;
+        float *d = dst + static_cast<int64_t>(y) * dw;
+        for (int x = 0; x < dw; ++x) {
+            d[x] = 0.25f * (s0[2 * x] + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1]);
+        }
+    }
+}
+
+/*! \brief bilinear sample with clamped coordinates */
+inline float Sample(const float *src, int w, int h, float x, float y) {
+    x = std::min(std::max(x, 0.f), static_cast<float>(w - 1));
+    y = std::min(std::max(y, 0.f), static_cast<float>(h - 1));
+    int x0 = std::min(static_cast<int>(x), w - 2 < 0 ? 0 : w - 2);
+    int y0 = std::min(static_cast<int>(y), h - 2 < 0 ? 0 : h - 2);
+    int x1 = std::min(x0 + 1, w - 1), y1 = std::min(y0 + 1, h - 1);
+    float fx = x - x0, fy = y - y0;
+    const float *r0 = src + static_cast<int64_t>(y0) * w;
+    const float *r1 = src + static_cast<int64_t>(y1) * w;
+    float top = r0[x0] + fx * (r0[x1] - r0[x0]);
+    float bottom = r1[x0] + fx * (r1[x1] - r1[x0]);
+    return top + fy * (bottom - top);
+}
+
+/*! \brief window sum with replicated borders, separable running sums, tmp has w * h floats */
+void BoxSum(const float *src, int w, int h, int r, float *tmp, float *dst) {
+    for (int y = 0; y < h; ++y) {
+        const float *s = src + static_cast<int64_t>(y) * w;
+        float *t = tmp + static_cast<int64_t>(y) * w;
+        float acc = 0;
+        for (int k = -r; k <= r; ++k) acc += s[Clamp(k, 0, w - 1)];
+        for (int x = 0; x < w; ++x) {
+            t[x] = acc;
+            acc += s[Clamp(x + r + 1, 0, w - 1)] - s[Clamp(x - r, 0, w - 1)];
+        }
+    }
+    // vertical pass works on whole rows so the inner loops vectorize
+    std::vector<float> acc(w, 0.f);
+    for (int k = -r; k <= r; ++k) {
+        const float *t = tmp + static_cast<int64_t>(Clamp(k, 0, h - 1)) * w;
+        for (int x = 0; x < w; ++x) acc[x] += t[x];
+    }
+    for (int y = 0; y < h; ++y) {
+        float *d = dst + static_cast<int64_t>(y) * w;
+        const float *add = tmp + static_cast<int64_t>(Clamp(y + r + 1, 0, h - 1)) * w;
+        const float *sub = tmp + static_cast<int64_t>(Clamp(y - r, 0, h - 1)) * w;
+        for (int x = 0; x < w; ++x) {
+            d[x] = acc[x];
+            acc[x] += add[x] - sub[x];
+        }
+    }
+}
+
+/*! \brief central differences with replicated borders */
+void Gradient(const float *src, int w, int h, float *gx, float *gy) {
+    for (int y = 0; y < h; ++y) {
+        const float *s = src + static_cast<int64_t>(y) * w;
+        const float *up = src + static_cast<int64_t>(std::max(y - 1, 0)) * w;
+        const float *down = src + static_cast<int64_t>(std::min(y + 1, h - 1)) * w;
+        float *dx = gx + static_cast<int64_t>(y) * w;
+        float *dy = gy + static_cast<int64_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            dx[x] = 0.5f * (s[std::min(x + 1, w - 1)] - s[std::max(x - 1, 0)]);
+            dy[x] = 0.5f * (down[x] - up[x]);
+        }
+    }
+}
+
+/*! \brief u += -(A^-1 b) for every pixel, A is the regularized structure tensor */
+void SolveUpdate(const float *a11, const float *a12, const float *a22, const float *b1, const float *b2,
+                 int64_t n, float reg, float *u, float *v) {
+    int64_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vreg = _mm_set1_ps(reg);
+    for (; i + 4 <= n; i += 4) {
+        __m128 m11 = _mm_add_ps(_mm_loadu_ps(a11 + i), vreg);
+        __m128 m12 = _mm_loadu_ps(a12 + i);
+        __m128 m22 = _mm_add_ps(_mm_loadu_ps(a22 + i), vreg);
+        __m128 c1 = _mm_loadu_ps(b1 + i);
+        __m128 c2 = _mm_loadu_ps(b2 + i);
+        __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.f), _mm_sub_ps(_mm_mul_ps(m11, m22), _mm_mul_ps(m12, m12)));
+        __m128 du = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(m12, c2), _mm_mul_ps(m22, c1)), inv_det);
+        __m128 dv = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(m12, c1), _mm_mul_ps(m11, c2)), inv_det);
+        _mm_storeu_ps(u + i, _mm_add_ps(_mm_loadu_ps(u + i), du));
+        _mm_storeu_ps(v + i, _mm_add_ps(_mm_loadu_ps(v + i), dv));
+    }
+#endif
+    for (; i < n; ++i) {
+        float m11 = a11[i] + reg, m12 = a12[i], m22 = a22[i] + reg;
+        float inv_det = 1.f / (m11 * m22 - m12 * m12);
+        u[i] += (m12 * b2[i] - m22 * b1[i]) * inv_det;
+        v[i] += (m12 * b1[i] - m11 * b2[i]) * inv_det;
+    }
+}
+
+/*! \brief it = next(x + u, y + v) - prev, bilinear as Sample, 4 pixels per SSE2 iteration */
+void WarpDifference(const float *prev, const float *next, int w, int h, const float *u, const float *v,
+                    float *it) {
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 xmax = _mm_set1_ps(static_cast<float>(w - 1));
+    const __m128 ymax = _mm_set1_ps(static_cast<float>(h - 1));
+    // same clamping of the top left corner as Sample
+    const __m128 x0max = _mm_set1_ps(static_cast<float>(std::max(w - 2, 0)));
+    const __m128 y0max = _mm_set1_ps(static_cast<float>(std::max(h - 2, 0)));
+    const __m128 lanes = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+#endif
+    for (int y = 0; y < h; ++y) {
+        const int64_t row = static_cast<int64_t>(y) * w;
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128 vy = _mm_set1_ps(static_cast<float>(y));
+        for (; x + 4 <= w; x += 4) {
+            const int64_t i = row + x;
+            __m128 sx = _mm_add_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes), _mm_loadu_ps(u + i));
+            __m128 sy = _mm_add_ps(vy, _mm_loadu_ps(v + i));
+            sx = _mm_min_ps(_mm_max_ps(sx, zero), xmax);
+            sy = _mm_min_ps(_mm_max_ps(sy, zero), ymax);
+            // coordinates are non negative, truncation is floor
+            __m128 x0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(sx)), x0max);
+            __m128 y0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(sy)), y0max);
+            __m128 x1 = _mm_min_ps(_mm_add_ps(x0, one), xmax);
+            __m128 y1 = _mm_min_ps(_mm_add_ps(y0, one), ymax);
+            __m128 fx = _mm_sub_ps(sx, x0);
+            __m128 fy = _mm_sub_ps(sy, y0);
+            // no gather in SSE2, corners are loaded one by one
+            alignas(16) int32_t ix0[4], ix1[4], iy0[4], iy1[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(ix0), _mm_cvttps_epi32(x0));
+            _mm_store_si128(reinterpret_cast<__m128i*>(ix1), _mm_cvttps_epi32(x1));
+            _mm_store_si128(reinterpret_cast<__m128i*>(iy0), _mm_cvttps_epi32(y0));
+            _mm_store_si128(reinterpret_cast<__m128i*>(iy1), _mm_cvttps_epi32(y1));
+            alignas(16) float p00[4], p01[4], p10[4], p11[4];
+            for (int k = 0; k < 4; ++k) {
+                const float *r0 = next + static_cast<int64_t>(iy0[k]) * w;
+                const float *r1 = next + static_cast<int64_t>(iy1[k]) * w;
+                p00[k] = r0[ix0[k]];
+                p01[k] = r0[ix1[k]];
+                p10[k] = r1[ix0[k]];
+                p11[k] = r1[ix1[k]];
+            }
+            __m128 a = _mm_load_ps(p00), b = _mm_load_ps(p01), c = _mm_load_ps(p10), d = _mm_load_ps(p11);
+            __m128 top = _mm_add_ps(a, _mm_mul_ps(fx, _mm_sub_ps(b, a)));
+            __m128 bottom = _mm_add_ps(c, _mm_mul_ps(fx, _mm_sub_ps(d, c)));
+            __m128 warped = _mm_add_ps(top, _mm_mul_ps(fy, _mm_sub_ps(bottom, top)));
+            _mm_storeu_ps(it + i, _mm_sub_ps(warped, _mm_loadu_ps(prev + i)));
+        }
+#endif
+        for (; x < w; ++x) {
+            const int64_t i = row + x;
+            it[i] = Sample(next, w, h, x + u[i], y + v[i]) - prev[i];
+        }
+    }
+}
+
+/*! \brief refine flow (u, v) of one pyramid level */
+void RefineLevel(const float *prev, const float *next, int w, int h, const FlowParams& params,
+                 float *u, float *v) {
+    const int64_t n = static_cast<int64_t>(w) * h;
+    Plane gx(n), gy(n), prod(n), tmp(n), a11(n), a12(n), a22(n), b1(n), b2(n), it(n);
+    Gradient(prev, w, h, gx.data(), gy.data());
+    for (int64_t i = 0; i < n; ++i) prod[i] = gx[i] * gx[i];
+    BoxSum(prod.data(), w, h, params.radius, tmp.data(), a11.data());
+    for (int64_t i = 0; i < n; ++i) prod[i] = gx[i] * gy[i];
+    BoxSum(prod.data(), w, h, params.radius, tmp.data(), a12.data());
+    for (int64_t i = 0; i < n; ++i) prod[i] = gy[i] * gy[i];
+    BoxSum(prod.data(), w, h, params.radius, tmp.data(), a22.data());
+    const float area = static_cast<float>((2 * params.radius + 1) * (2 * params.radius + 1));
+    for (int iter = 0; iter < params.iterations; ++iter) {
+        // temporal difference against next warped by current flow
+        WarpDifference(prev, next, w, h, u, v, it.data());
+        for (int64_t i = 0; i < n; ++i) prod[i] = gx[i] * it[i];
+        BoxSum(prod.data(), w, h, params.radius, tmp.data(), b1.data());
+        for (int64_t i = 0; i < n; ++i) prod[i] = gy[i] * it[i];
+        BoxSum(prod.data(), w, h, params.radius, tmp.data(), b2.data());
+        SolveUpdate(a11.data(), a12.data(), a22.data(), b1.data(), b2.data(), n,
+                    kRegularization * area, u, v);
+    }
+}
+
+}  // namespace detail
+
+void RGBToLuma(const uint8_t *src, int src_stride, int width, int height, int factor, float *dst) {
+    factor = std::max(factor, 1);
+    const int dw = width / factor, dh = height / factor;
+    const float scale = 1.f / (factor * factor);
+    for (int y = 0; y < dh; ++y) {
+        float *d = dst + static_cast<int64_t>(y) * dw;
+        std::fill(d, d + dw, 0.f);
+        for (int k = 0; k < factor; ++k) {
+            const uint8_t *s = src + static_cast<int64_t>(y * factor + k) * src_stride;
+            for (int x = 0; x < dw; ++x) {
+                float sum = 0;
+                for (int j = 0; j < factor; ++j) {
+                    const uint8_t *p = s + 3 * (x * factor + j);
+                    sum += 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+                }
+                d[x] += sum;
+            }
+        }
+        for (int x = 0; x < dw; ++x) d[x] *= scale;
+    }
+}
+
+void DenseFlow(const float *prev, const float *next, int width, int height, float *flow,
+               const FlowParams& params) {
+    // pyramid, level 0 is full resolution
+    std::vector<detail::Plane> prev_pyr(1, detail::Plane(prev, prev + static_cast<int64_t>(width) * height));
+    std::vector<detail::Plane> next_pyr(1, detail::Plane(next, next + static_cast<int64_t>(width) * height));
+    std::vector<int> ws(1, width), hs(1, height);
+    while (static_cast<int>(ws.size()) < params.levels
+           && std::min(ws.back(), hs.back()) / 2 >= detail::kMinLevelSize) {
+        int w = ws.back() / 2, h = hs.back() / 2;
+        prev_pyr.emplace_back(static_cast<int64_t>(w) * h);
+        next_pyr.emplace_back(static_cast<int64_t>(w) * h);
+        detail::Downsample(prev_pyr[prev_pyr.size() - 2].data(), ws.back(), hs.back(), prev_pyr.back().data());
+        detail::Downsample(next_pyr[next_pyr.size() - 2].data(), ws.back(), hs.back(), next_pyr.back().data());
+        ws.emplace_back(w);
+        hs.emplace_back(h);
+    }
+
+    detail::Plane u, v;
+    for (int level = static_cast<int>(ws.size()) - 1; level >= 0; --level) {
+        const int w = ws[level], h = hs[level];
+        detail::Plane fu(static_cast<int64_t>(w) * h, 0.f), fv(static_cast<int64_t>(w) * h, 0.f);
+        if (!u.empty()) {
+            // upsample coarser flow, displacement doubles
+            const int cw = ws[level + 1], ch = hs[level + 1];
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    float cx = (x + 0.5f) * 0.5f - 0.5f, cy = (y + 0.5f) * 0.5f - 0.5f;
+                    int64_t i = static_cast<int64_t>(y) * w + x;
+                    fu[i] = 2.f * detail::Sample(u.data(), cw, ch, cx, cy);
+                    fv[i] = 2.f * detail::Sample(v.data(), cw, ch, cx, cy);
+                }
+            }
+        }
+        detail::RefineLevel(prev_pyr[level].data(), next_pyr[level].data(), w, h, params, fu.data(), fv.data());
+        u.swap(fu);
+        v.swap(fv);
+    }
+    const int64_t n = static_cast<int64_t>(width) * height;
+    for (int64_t i = 0; i < n; ++i) {
+        flow[2 * i] = u[i];
+        flow[2 * i + 1] = v[i];
+    }
+}
+
+void QuantizeFlow(const float *flow, int64_t size, float bound, uint8_t *dst) {
+    const float scale = 255.f / (2.f * bound);
+    for (int64_t i = 0; i < size; ++i) {
+        float q = (std::min(std::max(flow[i], -bound), bound) + bound) * scale;
+        dst[i] = static_cast<uint8_t>(q + 0.5f);
+    }
+}
+
+}  // namespace improc
+}  // namespace decord
@@ -0,0 +1,67 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file optical_flow.h
+ * \brief CPU dense optical flow on luma planes
+ */
+
+#ifndef DECORD_IMPROC_OPTICAL_FLOW_H_
+#define DECORD_IMPROC_OPTICAL_FLOW_H_
+
+#include <stdint.h>
+
+namespace decord {
+namespace improc {
+
+/*! \brief parameters of dense pyramidal Lucas-Kanade flow */
+struct FlowParams {
+    /*! \brief max pyramid levels, coarsest level is kept at least 16 pixels */
+    int levels = 4;
+    /*! \brief radius of the square integration window */
+    int radius = 3;
+    /*! \brief warp and solve iterations per level */
+    int iterations = 3;
+};  // struct FlowParams
+
+/**
+ * \brief Convert packed RGB24 to BT.601 luma, box downscaled by an integer factor.
+ *
+ * \param src Source pixels, packed 8bit RGB
+ * \param src_stride Source line size in bytes
+ * \param width Source width
+ * \param height Source height
+ * \param factor Downscale factor, output is (width / factor) x (height / factor)
+ * \param dst Output luma in [0, 255], contiguous
+ */
+void RGBToLuma(const uint8_t *src, int src_stride, int width, int height, int factor, float *dst);
+
+/**
+ * \brief Dense optical flow from prev to next, i.e. next(x + flow(x)) ~ prev(x).
+ *
+ * Coarse to fine Lucas-Kanade: per level the structure tensor of prev is box filtered once,
+ * each iteration bilinearly warps next by the current flow and solves the 2x2 system of
+ * every pixel (both 4 pixels per SSE2 iteration), flow is upsampled to the next finer level.
+ *
+ * \param prev First luma plane, contiguous
+ * \param next Second luma plane, contiguous
+ * \param width Plane width
+ * \param height Plane height
+ * \param flow Output, interleaved (dx, dy) per pixel in pixels, width * height * 2
+ * \param params Flow parameters
+ */
+void DenseFlow(const float *prev, const float *next, int width, int height, float *flow,
+               const FlowParams& params = FlowParams());
+
+/**
+ * \brief Quantize flow to uint8, [-bound, bound] maps linearly to [0, 255], 128 is still.
+ *
+ * \param flow Input flow values
+ * \param size Number of values
+ * \param bound Max absolute displacement, larger values are clipped
+ * \param dst Output
+ */
+void QuantizeFlow(const float *flow, int64_t size, float bound, uint8_t *dst);
+
+}  // namespace improc
+}  // namespace decord
+
+#endif  // DECORD_IMPROC_OPTICAL_FLOW_H_
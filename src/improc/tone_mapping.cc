@@ -0,0 +1,160 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file tone_mapping.cc
+ * \brief CPU HDR to SDR tone mapping
+ */
+
+#include "tone_mapping.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace decord {
+namespace improc {
+namespace detail {
+
+/*! \brief size of transfer function tables, 12bit precision */
+static const int kLUTSize = 4096;
+/*! \brief SDR reference white in nits (ITU-R BT.2408) */
+static const float kRefWhite = 203.f;
+/*! \brief assumed mastering peak in nits */
+static const float kPeak = 1000.f;
+
+/*! \brief linear BT.2020 to linear BT.709 primaries */
+static const float kGamutMat[9] = {
+     1.6605f, -0.5876f, -0.0728f,
+    -0.1246f,  1.1329f, -0.0083f,
+    -0.0182f, -0.1006f,  1.1187f
+};
+
+/*! \brief A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30, products folded as in ToneMapPixel4 */
+inline float Hable(float x) {
+    // (x(Ax + CB) + DE) / (x(Ax + B) + DF) - E/F
+    return (x * (0.15f * x + 0.05f) + 0.004f) / (x * (0.15f * x + 0.5f) + 0.06f) - 0.02f / 0.30f;
+}
+
+/*! \brief transfer function tables, normalized so that 1.0 is SDR reference white */
+struct ToneMapLUT {
+    float eotf[2][kLUTSize];
+    uint8_t oetf[kLUTSize];
+    float peak;
+    float inv_hable_peak;
+
+    ToneMapLUT() {
+        const double m1 = 2610. / 16384, m2 = 2523. / 4096 * 128;
+        const double c1 = 3424. / 4096, c2 = 2413. / 4096 * 32, c3 = 2392. / 4096 * 32;
+        const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+        for (int i = 0; i < kLUTSize; ++i) {
+            double e = static_cast<double>(i) / (kLUTSize - 1);
+            // SMPTE ST 2084 EOTF, absolute luminance up to 10000 nits
+            double ep = std::pow(e, 1. / m2);
+            double pq = std::pow(std::max(ep - c1, 0.) / (c2 - c3 * ep), 1. / m1) * 10000.;
+            eotf[kTransferPQ][i] = static_cast<float>(pq / kRefWhite);
+            // ARIB STD-B67 inverse OETF, with per channel approximation of the 1.2 system gamma OOTF
+            double hlg = e <= 0.5 ? e * e / 3. : (std::exp((e - c) / a) + b) / 12.;
+            eotf[kTransferHLG][i] = static_cast<float>(std::pow(hlg, 1.2) * kPeak / kRefWhite);
+            // BT.709 OETF
+            double l = e < 0.018 ? 4.5 * e : 1.099 * std::pow(e, 0.45) - 0.099;
+            oetf[i] = static_cast<uint8_t>(std::min(255., std::round(l * 255.)));
+        }
+        peak = kPeak / kRefWhite;
+        inv_hable_peak = 1.f / Hable(peak);
+    }
+};
+
+inline const ToneMapLUT& GetLUT() {
+    static const ToneMapLUT lut;
+    return lut;
+}
+
+/*! \brief scalar path, used for the tail of each line or without SSE2, same operations and rounding as ToneMapPixel4 */
+inline void ToneMapPixel(const ToneMapLUT& lut, const float *eotf, const uint16_t *s, uint8_t *d) {
+    float r = eotf[s[0] >> 4], g = eotf[s[1] >> 4], b = eotf[s[2] >> 4];
+    const float *m = kGamutMat;
+    float r2 = std::max(0.f, m[0] * r + m[1] * g + m[2] * b);
+    float g2 = std::max(0.f, m[3] * r + m[4] * g + m[5] * b);
+    float b2 = std::max(0.f, m[6] * r + m[7] * g + m[8] * b);
+    float sig = std::max(std::max(r2, g2), std::max(b2, 1e-6f));
+    float scale = Hable(std::min(sig, lut.peak)) * lut.inv_hable_peak / sig;
+    const float maxv = static_cast<float>(kLUTSize - 1);
+    d[0] = lut.oetf[static_cast<int>(std::min(r2 * scale, 1.f) * maxv + 0.5f)];
+    d[1] = lut.oetf[static_cast<int>(std::min(g2 * scale, 1.f) * maxv + 0.5f)];
+    d[2] = lut.oetf[static_cast<int>(std::min(b2 * scale, 1.f) * maxv + 0.5f)];
+}
+
+#if defined(__SSE2__)
+/*! \brief 4 pixels per iteration */
+inline void ToneMapPixel4(const ToneMapLUT& lut, const float *eotf, const uint16_t *s, uint8_t *d) {
+    float r[4], g[4], b[4];
+    for (int k = 0; k < 4; ++k) {
+        r[k] = eotf[s[3 * k] >> 4];
+        g[k] = eotf[s[3 * k + 1] >> 4];
+        b[k] = eotf[s[3 * k + 2] >> 4];
+    }
+    const __m128 vr = _mm_loadu_ps(r), vg = _mm_loadu_ps(g), vb = _mm_loadu_ps(b);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const float *m = kGamutMat;
+    __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), vr), _mm_mul_ps(_mm_set1_ps(m[1]), vg)),
+                           _mm_mul_ps(_mm_set1_ps(m[2]), vb));
+    __m128 g2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), vr), _mm_mul_ps(_mm_set1_ps(m[4]), vg)),
+                           _mm_mul_ps(_mm_set1_ps(m[5]), vb));
+    __m128 b2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[6]), vr), _mm_mul_ps(_mm_set1_ps(m[7]), vg)),
+                           _mm_mul_ps(_mm_set1_ps(m[8]), vb));
+    r2 = _mm_max_ps(r2, zero);
+    g2 = _mm_max_ps(g2, zero);
+    b2 = _mm_max_ps(b2, zero);
+    __m128 sig = _mm_max_ps(_mm_max_ps(r2, g2), _mm_max_ps(b2, _mm_set1_ps(1e-6f)));
+    __m128 x = _mm_min_ps(sig, _mm_set1_ps(lut.peak));
+    // Hable curve: (x(Ax + CB) + DE) / (x(Ax + B) + DF) - E/F
+    const __m128 a = _mm_set1_ps(0.15f);
+    __m128 num = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(a, x), _mm_set1_ps(0.05f))), _mm_set1_ps(0.004f));
+    __m128 den = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(a, x), _mm_set1_ps(0.5f))), _mm_set1_ps(0.06f));
+    __m128 mapped = _mm_sub_ps(_mm_div_ps(num, den), _mm_set1_ps(0.02f / 0.30f));
+    __m128 scale = _mm_div_ps(_mm_mul_ps(mapped, _mm_set1_ps(lut.inv_hable_peak)), sig);
+    const __m128 maxv = _mm_set1_ps(static_cast<float>(kLUTSize - 1));
+    const __m128 half = _mm_set1_ps(0.5f);
+    int32_t ir[4], ig[4], ib[4];
+    // + 0.5 and truncate like the scalar path, _mm_cvtps_epi32 would round half to even
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ir),
+                     _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_mul_ps(r2, scale), one), maxv), half)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ig),
+                     _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_mul_ps(g2, scale), one), maxv), half)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ib),
+                     _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_mul_ps(b2, scale), one), maxv), half)));
+    for (int k = 0; k < 4; ++k) {
+        d[3 * k] = lut.oetf[ir[k]];
+        d[3 * k + 1] = lut.oetf[ig[k]];
+        d[3 * k + 2] = lut.oetf[ib[k]];
+    }
+}
+#endif
+
+}  // namespace detail
+
+void ToneMapRGB48ToRGB24(const uint16_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                         int width, int height, HDRTransfer transfer, bool simd) {
+    const detail::ToneMapLUT& lut = detail::GetLUT();
+    const float *eotf = lut.eotf[transfer];
+    for (int h = 0; h < height; ++h) {
+        const uint16_t *s = reinterpret_cast<const uint16_t*>(
+            reinterpret_cast<const uint8_t*>(src) + static_cast<int64_t>(h) * src_stride);
+        uint8_t *d = dst + static_cast<int64_t>(h) * dst_stride;
+        int w = 0;
+#if defined(__SSE2__)
+        for (; simd && w + 4 <= width; w += 4) {
+            detail::ToneMapPixel4(lut, eotf, s + 3 * w, d + 3 * w);
+        }
+#endif
+        for (; w < width; ++w) {
+            detail::ToneMapPixel(lut, eotf, s + 3 * w, d + 3 * w);
+        }
+    }
+}
+
+}  // namespace improc
+}  // namespace decord
@@ -0,0 +1,42 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file tone_mapping.h
+ * \brief CPU HDR to SDR tone mapping
+ */
+
+#ifndef DECORD_IMPROC_TONE_MAPPING_H_
+#define DECORD_IMPROC_TONE_MAPPING_H_
+
+#include <stdint.h>
+
+namespace decord {
+namespace improc {
+
+/*! \brief HDR transfer characteristics supported by tone mapping */
+enum HDRTransfer {
+    kTransferPQ = 0,   // SMPTE ST 2084, HDR10
+    kTransferHLG,      // ARIB STD-B67
+};  // enum HDRTransfer
+
+/**
+ * \brief Tone map HDR RGB48 frame (BT.2020 primaries) to SDR RGB24 (BT.709 primaries and transfer).
+ *
+ * Transfer functions are table driven, gamut mapping and the filmic (Hable) curve run on SSE2 lanes,
+ * the curve is applied on max(R, G, B) so that hue is preserved.
+ *
+ * \param src Source pixels, packed 16bit RGB
+ * \param src_stride Source line size in bytes
+ * \param dst Destination pixels, packed 8bit RGB
+ * \param dst_stride Destination line size in bytes
+ * \param width Frame width
+ * \param height Frame height
+ * \param transfer Transfer characteristic of source
+ * \param simd Use SSE2 lanes if available, the scalar path gives the same output
+ */
+void ToneMapRGB48ToRGB24(const uint16_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                         int width, int height, HDRTransfer transfer, bool simd = true);
+
+}  // namespace improc
+}  // namespace decord
+
+#endif  // DECORD_IMPROC_TONE_MAPPING_H_
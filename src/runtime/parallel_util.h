@@ -0,0 +1,94 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file parallel_util.h
+ * \brief Minimum parallel-for util on top of the runtime thread pool.
+ */
+#ifndef DECORD_RUNTIME_PARALLEL_UTIL_H_
+#define DECORD_RUNTIME_PARALLEL_UTIL_H_
+
+#include <decord/runtime/c_backend_api.h>
+#include <dmlc/logging.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace decord {
+namespace runtime {
+
+/*!
+ * \brief Whether the current thread is running a ParallelFor task, pool workers and the launching
+ *  thread alike. The pool cannot launch from inside a task, nested loops then run serially.
+ */
+inline bool& InParallelFor() {
+  static thread_local bool in_parallel_for = false;
+  return in_parallel_for;
+}
+
+/*!
+ * \brief Launch flambda on the process-wide pool shared by all ParallelFor callers.
+ *
+ * \param ret Result of the launch, set only if launched.
+ * \return false without running anything if the pool is busy with a loop of another thread.
+ */
+bool TryParallelLaunch(FDECORDParallelLambda flambda, void* cdata, int num_task, int* ret);
+
+/*!
+ * \brief Run f(i) for every i in [0, n) on the shared runtime thread pool.
+ *
+ * Tasks are strided over the pool workers, the calling thread participates as worker 0.
+ * Errors raised inside tasks are collected and rethrown in the calling thread.
+ * Called from inside another ParallelFor, e.g. a reader batching its own decoding while a dataset
+ * decodes several readers in parallel, the loop runs serially on the current thread.
+ * There is one pool per process, not per calling thread, so prefetch and producer threads do not
+ * add workers: while it runs the loop of another thread, the loop runs serially on the caller.
+ *
+ * \param n Number of work items.
+ * \param f Work function, must be safe to call concurrently for different i.
+ * \param num_task Number of pool tasks to launch, 0 means all available workers.
+ */
+inline void ParallelFor(int64_t n, std::function<void(int64_t)> f, int num_task = 0) {
+  if (n < 1) return;
+  if (n == 1 || InParallelFor()) {
+    for (int64_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+  struct Closure {
+    int64_t n;
+    std::function<void(int64_t)>* f;
+    std::mutex mutex;
+    std::string error;
+  } closure;
+  closure.n = n;
+  closure.f = &f;
+  if (num_task > n) num_task = static_cast<int>(n);
+  auto flambda = [](int task_id, DECORDParallelGroupEnv* penv, void* cdata) -> int {
+    auto* c = static_cast<Closure*>(cdata);
+    InParallelFor() = true;
+    try {
+      for (int64_t i = task_id; i < c->n; i += penv->num_task) {
+        (*c->f)(i);
+      }
+    } catch (const std::exception& e) {
+      InParallelFor() = false;
+      std::lock_guard<std::mutex> lock(c->mutex);
+      c->error += e.what();
+      c->error += '\n';
+      return -1;
+    }
+    InParallelFor() = false;
+    return 0;
+  };
+  int ret = 0;
+  if (!TryParallelLaunch(flambda, &closure, num_task, &ret)) {
+    for (int64_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+  if (ret != 0 || !closure.error.empty()) {
+    LOG(FATAL) << "ParallelFor failed: " << closure.error;
+  }
+}
+
+}  // namespace runtime
+}  // namespace decord
+#endif  // DECORD_RUNTIME_PARALLEL_UTIL_H_
@@ -300,6 +300,18 @@ class ThreadPool {
     return dmlc::ThreadLocalStore<ThreadPool>::Get();
   }
 
+  // process-wide pool behind ParallelFor, never destroyed as loops may run during static destruction
+  static ThreadPool* Shared() {
+    static ThreadPool* inst = new ThreadPool();
+    return inst;
+  }
+
+  // task queues take one producer, so the shared pool runs one launch at a time
+  static std::mutex& SharedMutex() {
+    static std::mutex* inst = new std::mutex();
+    return *inst;
+  }
+
   void UpdateWorkerConfiguration(threading::ThreadGroup::AffinityMode mode, int nthreads) {
     // this will also reset the affinity of the ThreadGroup
     // may use less than the MaxConcurrency number of workers
@@ -346,9 +358,17 @@ DECORD_REGISTER_GLOBAL("runtime.config_threadpool")
     static_cast<threading::ThreadGroup::AffinityMode>(\
     static_cast<int>(args[0]));
     int nthreads = args[1];
-    ThreadPool::ThreadLocal()->UpdateWorkerConfiguration(mode, nthreads);
+    std::lock_guard<std::mutex> lock(ThreadPool::SharedMutex());
+    ThreadPool::Shared()->UpdateWorkerConfiguration(mode, nthreads);
 });
 
+bool TryParallelLaunch(FDECORDParallelLambda flambda, void* cdata, int num_task, int* ret) {
+  std::unique_lock<std::mutex> lock(ThreadPool::SharedMutex(), std::try_to_lock);
+  if (!lock.owns_lock()) return false;
+  *ret = ThreadPool::Shared()->Launch(flambda, cdata, num_task, 1);
+  return true;
+}
+
 
 }  // namespace runtime
 }  // namespace decord
@@ -0,0 +1,189 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file weighted_sampler.cc
+ * \brief Random sampler with per video weights, e.g. class balanced or difficulty based
+ */
+
+#include "weighted_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <dmlc/logging.h>
+
+namespace decord {
+namespace sampler {
+
+AliasTable::AliasTable(const std::vector<double>& weights) : prob_(weights.size(), 0), alias_(weights.size(), 0) {
+    const size_t n = weights.size();
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if (n == 0 || total <= 0) return;
+    // scaled to mean 1, split into under and over full columns
+    std::vector<double> scaled(n);
+    std::vector<size_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = weights[i] * n / total;
+        if (scaled[i] < 1) {
+            small.emplace_back(i);
+        } else {
+            large.emplace_back(i);
+        }
+    }
+    // fill each under full column with the rest of an over full one
+    while (!small.empty() && !large.empty()) {
+        size_t s = small.back();
+        small.pop_back();
+        size_t l = large.back();
+        prob_[s] = scaled[s];
+        alias_[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.emplace_back(l);
+        }
+    }
+    // left over columns are full up to rounding errors
+    for (size_t i : large) prob_[i] = 1;
+    for (size_t i : small) prob_[i] = 1;
+}
+
+size_t AliasTable::Draw(std::mt19937_64& rng) const {
+    CHECK(!prob_.empty());
+    size_t i = std::uniform_int_distribution<size_t>(0, prob_.size() - 1)(rng);
+    return std::uniform_real_distribution<double>(0, 1)(rng) < prob_[i] ? i : alias_[i];
+}
+
+WeightedSampler::WeightedSampler(std::vector<int64_t> lens, std::vector<int64_t> range, int bs, int interval, int skip,
+                                 WeightedSamplerOptions opts)
+    : bs_(bs), opts_(opts), curr_(0), size_(0), epoch_(0) {
+    CHECK(range.size() % 2 == 0) << "Range (begin, end) size incorrect, expected: " << lens.size() * 2;
+    CHECK_EQ(lens.size(), range.size() / 2) << "Video reader size mismatch with range: " << lens.size() << " vs " << range.size() / 2;
+    CHECK_GE(opts_.num_shards, 1) << "Invalid number of shards: " << opts_.num_shards;
+    CHECK(opts_.shard_id >= 0 && opts_.shard_id < opts_.num_shards)
+        << "Shard id " << opts_.shard_id << " out of range [0, " << opts_.num_shards << ")";
+
+    // output buffer
+    samples_.resize(bs);
+
+    // every batch, drawn by weight
+    video_batches_.assign(lens.size(), 0);
+    for (size_t i = 0; i < lens.size(); ++i) {
+        auto begin = range[i*2];
+        auto end = range[i*2 + 1];
+        if (end < 0) {
+            // allow negative indices, e.g., -20 means total_frame - 20
+            end = lens[i] - end;
+        }
+        CHECK_GE(end, 0) << "Video{" << i << "} has range end smaller than 0: " << end;
+        CHECK(begin < end) << "Video{" << i << "} has invalid begin and end config: " << begin << "->" << end;
+        CHECK(end < lens[i]) << "Video{" << i <<"} has range end larger than # frames: " << lens[i];
+        int64_t bs_skip = bs * (1 + interval) - interval + skip;
+        int64_t bs_length = bs_skip - skip;
+        for (int64_t b = begin; b + bs_length < end; b += bs_skip) {
+            int offset = 0;
+            for (int j = 0; j < bs; ++j) {
+                samples_[j] = std::make_pair(i, b + offset);
+                offset += interval + 1;
+            }
+            batches_.emplace_back(samples_);
+            batch_video_.emplace_back(i);
+            ++video_batches_[i];
+        }
+    }
+    ApplyWeights(opts_.weights);
+}
+
+void WeightedSampler::ApplyWeights(const std::vector<double>& weights) {
+    const size_t num_videos = video_batches_.size();
+    CHECK(weights.empty() || weights.size() == num_videos)
+        << "Expected " << num_videos << " video weights, given " << weights.size();
+    for (double w : weights) CHECK_GE(w, 0) << "Video weights must not be negative";
+    batch_weights_.resize(batches_.size());
+    size_t positive = 0;
+    for (size_t i = 0; i < batches_.size(); ++i) {
+        const size_t v = batch_video_[i];
+        const double w = weights.empty() ? 1.0 : weights[v];
+        // video weight shared by its batches
+        batch_weights_[i] = w / video_batches_[v];
+        if (batch_weights_[i] > 0) ++positive;
+    }
+    CHECK_GT(positive, 0) << "All videos have weight 0, nothing to sample";
+    table_ = AliasTable(batch_weights_);
+    size_ = (opts_.replacement ? batches_.size() : positive) / opts_.num_shards;
+    CHECK_GT(size_, 0) << "Fewer batches than shards: " << (opts_.replacement ? batches_.size() : positive)
+                       << " vs " << opts_.num_shards;
+}
+
+void WeightedSampler::SetWeights(std::vector<double> weights) {
+    CHECK_EQ(weights.size(), video_batches_.size())
+        << "Expected " << video_batches_.size() << " video weights, given " << weights.size();
+    pending_weights_ = weights;
+}
+
+std::vector<size_t> WeightedSampler::DrawWithReplacement(size_t num, std::mt19937_64& rng) const {
+    std::vector<size_t> ret(num);
+    for (size_t i = 0; i < num; ++i) ret[i] = table_.Draw(rng);
+    return ret;
+}
+
+std::vector<size_t> WeightedSampler::DrawWithoutReplacement(size_t num, std::mt19937_64& rng) const {
+    // Efraimidis-Spirakis: key -log(u) / w is exponential with rate w, the num smallest keys are a
+    // weighted draw without replacement in order, O(n + num log n) regardless of weight skew
+    std::vector<std::pair<double, size_t> > keys;
+    keys.reserve(batches_.size());
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (size_t i = 0; i < batches_.size(); ++i) {
+        if (batch_weights_[i] <= 0) continue;
+        // u in (0, 1], log(0) would tie every key at infinity
+        double u = 1 - uniform(rng);
+        keys.emplace_back(-std::log(u) / batch_weights_[i], i);
+    }
+    num = std::min(num, keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + num, keys.end());
+    std::vector<size_t> ret(num);
+    for (size_t i = 0; i < num; ++i) ret[i] = keys[i].second;
+    return ret;
+}
+
+void WeightedSampler::Reset() {
+    if (!pending_weights_.empty()) {
+        ApplyWeights(pending_weights_);
+        pending_weights_.clear();
+    }
+    const uint64_t shards = static_cast<uint64_t>(opts_.num_shards);
+    const uint64_t shard = static_cast<uint64_t>(opts_.shard_id);
+    if (opts_.replacement) {
+        // independent draws, one stream per shard
+        std::seed_seq seq{opts_.seed, epoch_, shard};
+        std::mt19937_64 rng(seq);
+        visit_order_ = DrawWithReplacement(size_, rng);
+    } else {
+        // same epoch order on all shards, each takes its own stride
+        std::seed_seq seq{opts_.seed, epoch_};
+        std::mt19937_64 rng(seq);
+        std::vector<size_t> order = DrawWithoutReplacement(size_ * shards, rng);
+        visit_order_.resize(size_);
+        for (size_t i = 0; i < size_; ++i) visit_order_[i] = order[i * shards + shard];
+    }
+    ++epoch_;
+    // reset visit idx
+    curr_ = 0;
+}
+
+bool WeightedSampler::HasNext() const {
+    return curr_ < visit_order_.size();
+}
+
+const Samples& WeightedSampler::Next() {
+    CHECK(HasNext());
+    CHECK_EQ(samples_.size(), bs_);
+    samples_ = batches_[visit_order_[curr_++]];
+    return samples_;
+}
+
+size_t WeightedSampler::Size() const {
+    return size_;
+}
+}  // sampler
+}  // decord
@@ -0,0 +1,103 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file weighted_sampler.h
+ * \brief Random sampler with per video weights, e.g. class balanced or difficulty based
+ */
+
+#ifndef DECORD_SAMPLER_WEIGHTED_SAMPLER_H_
+#define DECORD_SAMPLER_WEIGHTED_SAMPLER_H_
+
+#include "sampler_interface.h"
+
+#include <cstdint>
+#include <random>
+
+namespace decord {
+namespace sampler {
+
+/**
+ * \brief Alias table (Vose's method) over non negative weights.
+ *
+ * Built in O(n), each draw is a single uniform index and a coin flip, O(1).
+ */
+class AliasTable {
+    public:
+        AliasTable() = default;
+        explicit AliasTable(const std::vector<double>& weights);
+        /*! \brief index drawn with probability proportional to its weight, weights must not be all 0 */
+        size_t Draw(std::mt19937_64& rng) const;
+        size_t Size() const { return prob_.size(); }
+
+    private:
+        /*! \brief probability of keeping the uniformly drawn index instead of its alias */
+        std::vector<double> prob_;
+        std::vector<size_t> alias_;
+};  // class AliasTable
+
+/*! \brief options of WeightedSampler */
+struct WeightedSamplerOptions {
+    /*! \brief weight of each video, shared by its batches, empty for uniform */
+    std::vector<double> weights;
+    /*! \brief draw with replacement, otherwise each batch at most once per epoch */
+    bool replacement = true;
+    /*! \brief number of distributed workers, each iterates its own part of the epoch */
+    int num_shards = 1;
+    int shard_id = 0;
+    /*! \brief must be the same on all shards */
+    uint64_t seed = 0;
+};  // struct WeightedSamplerOptions
+
+/**
+ * \brief WeightedSampler draws batches with probability proportional to the weight of their video.
+ *
+ * Video weights are spread over its batches, so a video's share of an epoch does not depend on its
+ * length. With replacement, every draw is O(1) from an alias table, and an epoch has as many batches
+ * as the videos hold. Without replacement, the epoch order is sorted by random keys (Efraimidis-Spirakis),
+ * O(log n) per batch whatever the weights; batches of weight 0 are never drawn and do not count in the epoch.
+ *
+ * Shards draw from the same seed and epoch: without replacement, the epoch order is shared and each
+ * shard takes every num_shards-th batch, so shards never overlap; with replacement, shards draw
+ * independently. All shards have the same epoch length, a remainder is dropped. New weights are
+ * applied at the next Reset, i.e. the next epoch.
+ */
+class WeightedSampler : public SamplerInterface {
+    public:
+        WeightedSampler(std::vector<int64_t> lens, std::vector<int64_t> range, int bs, int interval, int skip,
+                        WeightedSamplerOptions opts);
+        ~WeightedSampler() = default;
+        void Reset();
+        bool HasNext() const;
+        const Samples& Next();
+        size_t Size() const;
+        /*! \brief weight of each video, used from next Reset */
+        void SetWeights(std::vector<double> weights);
+
+    private:
+        /*! \brief weight of each batch from video weights, recounts epoch size */
+        void ApplyWeights(const std::vector<double>& weights);
+        std::vector<size_t> DrawWithReplacement(size_t num, std::mt19937_64& rng) const;
+        std::vector<size_t> DrawWithoutReplacement(size_t num, std::mt19937_64& rng) const;
+
+        size_t bs_;
+        Samples samples_;
+        /*! \brief every batch of every video */
+        std::vector<Samples> batches_;
+        /*! \brief video of each batch, and number of batches per video */
+        std::vector<size_t> batch_video_;
+        std::vector<size_t> video_batches_;
+        std::vector<double> batch_weights_;
+        AliasTable table_;
+        WeightedSamplerOptions opts_;
+        /*! \brief weights set since last Reset */
+        std::vector<double> pending_weights_;
+        /*! \brief batches drawn for this shard in current epoch */
+        std::vector<size_t> visit_order_;
+        size_t curr_;
+        size_t size_;
+        uint64_t epoch_;
+};  // class WeightedSampler
+
+}  // sampler
+}  // decord
+
+#endif  // DECORD_SAMPLER_WEIGHTED_SAMPLER_H_
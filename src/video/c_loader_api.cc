@@ -0,0 +1,74 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file c_loader_api.cc
+ * \brief Stable C ABI of VideoLoader
+ */
+
+#include "video_loader.h"
+#include "../runtime/runtime_base.h"
+#include "../runtime/str_util.h"
+
+#include <decord/c_loader_api.h>
+
+using namespace decord;
+
+int decord_loader_create(const char* uris,
+                         int batch_size,
+                         int height,
+                         int width,
+                         int interval,
+                         int skip,
+                         int shuffle,
+                         int device_type,
+                         int device_id,
+                         DECORDLoaderHandle* out) {
+  API_BEGIN();
+  CHECK(uris != nullptr && out != nullptr);
+  DLContext ctx;
+  ctx.device_type = static_cast<DLDeviceType>(device_type);
+  ctx.device_id = device_id;
+  std::vector<int> shape({batch_size, height, width, 3});
+  VideoLoaderInterface *p = new VideoLoader(runtime::SplitString(uris, ','), {ctx}, shape,
+                                            interval, skip, shuffle, 0);
+  *out = static_cast<DECORDLoaderHandle>(p);
+  API_END();
+}
+
+int decord_loader_length(DECORDLoaderHandle handle, int64_t* out) {
+  API_BEGIN();
+  *out = static_cast<VideoLoaderInterface*>(handle)->Length();
+  API_END();
+}
+
+int decord_loader_next(DECORDLoaderHandle handle,
+                       DLManagedTensor** data,
+                       DLManagedTensor** indices) {
+  API_BEGIN();
+  CHECK(data != nullptr && indices != nullptr);
+  *data = nullptr;
+  *indices = nullptr;
+  auto loader = static_cast<VideoLoaderInterface*>(handle);
+  if (!loader->HasNext()) return DECORD_LOADER_END;
+  loader->Next();
+  *data = loader->NextData().ToDLPack();
+  *indices = loader->NextIndices().ToDLPack();
+  API_END_HANDLE_ERROR({
+    // no half batch on failure
+    if (data && *data) {
+      DECORDDLManagedTensorCallDeleter(*data);
+      *data = nullptr;
+    }
+  });
+}
+
+int decord_loader_reset(DECORDLoaderHandle handle) {
+  API_BEGIN();
+  static_cast<VideoLoaderInterface*>(handle)->Reset();
+  API_END();
+}
+
+int decord_loader_free(DECORDLoaderHandle handle) {
+  API_BEGIN();
+  delete static_cast<VideoLoaderInterface*>(handle);
+  API_END();
+}
@@ -0,0 +1,387 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file clip_dataset.cc
+ * \brief Annotated video clip dataset, implements VideoLoaderInterface
+ */
+
+#include "clip_dataset.h"
+#include "image_sequence_reader.h"
+#include "../runtime/parallel_util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+#include <dmlc/json.h>
+#include <dmlc/logging.h>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+
+namespace {
+
+const char* const kPathKeys[] = {"path", "filename", "video"};
+const char* const kLabelKeys[] = {"label", "class"};
+const char* const kStartKeys[] = {"start", "time_start", "start_time"};
+const char* const kEndKeys[] = {"end", "time_end", "end_time"};
+
+template<std::size_t N>
+bool IsKey(const std::string& key, const char* const (&names)[N]) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (key == names[i]) return true;
+    }
+    return false;
+}
+
+template<std::size_t N>
+int FindColumn(const std::vector<std::string>& header, const char* const (&names)[N]) {
+    for (std::size_t i = 0; i < header.size(); ++i) {
+        if (IsKey(header[i], names)) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+/*! \brief split one CSV line, supports double quoted fields with "" escapes */
+std::vector<std::string> ParseCSVLine(const std::string& line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                ++i;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back() += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+double ParseTime(const std::string& s, double default_value) {
+    if (s.empty()) return default_value;
+    char *end = nullptr;
+    double v = std::strtod(s.c_str(), &end);
+    CHECK(end && *end == '\0') << "Invalid time in annotation: " << s;
+    return v;
+}
+
+bool IsInteger(const std::string& s) {
+    if (s.empty()) return false;
+    char *end = nullptr;
+    std::strtoll(s.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+}  // namespace
+
+VideoClipDataset::VideoClipDataset(std::string annotation, std::string root, DLContext ctx,
+                                   int batch_size, int num_frames, int width, int height,
+                                   bool shuffle, int max_open_readers)
+    : ctx_(ctx), bs_(batch_size), num_frames_(num_frames), width_(width), height_(height),
+    shuffle_(shuffle), max_open_(static_cast<std::size_t>(std::max(1, max_open_readers))),
+    curr_(0), rng_(std::random_device{}()), next_ready_(0) {
+    CHECK_GT(bs_, 0) << "Invalid batch size: " << bs_;
+    CHECK_GT(num_frames_, 0) << "Invalid number of frames per clip: " << num_frames_;
+    CHECK_GT(width_, 0) << "Invalid width: " << width_;
+    CHECK_GT(height_, 0) << "Invalid height: " << height_;
+    LoadAnnotation(annotation, root);
+    CHECK_GT(clips_.size(), 0) << "No clip found in annotation: " << annotation;
+    Reset();
+}
+
+VideoClipDataset::~VideoClipDataset() {
+}
+
+void VideoClipDataset::LoadAnnotation(const std::string& annotation, const std::string& root) {
+    std::string prefix = root;
+    if (prefix.empty()) {
+        // relative paths are resolved against the annotation file by default
+        std::size_t slash = annotation.find_last_of("/\\");
+        if (slash != std::string::npos) prefix = annotation.substr(0, slash);
+    }
+    std::vector<std::string> paths;
+    std::vector<std::string> labels;
+    std::vector<double> starts;
+    std::vector<double> ends;
+
+    std::ifstream fin(annotation);
+    CHECK(fin.good()) << "Error opening annotation: " << annotation;
+    std::string ext = annotation.substr(annotation.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "json") {
+        dmlc::JSONReader reader(&fin);
+        reader.BeginArray();
+        while (reader.NextArrayItem()) {
+            std::string key, path, label;
+            double start = 0, end = -1;
+            reader.BeginObject();
+            while (reader.NextObjectItem(&key)) {
+                // peek value type, labels can be either class names or ids
+                fin >> std::ws;
+                bool is_string = fin.peek() == '"';
+                if (IsKey(key, kPathKeys)) {
+                    reader.Read(&path);
+                } else if (IsKey(key, kLabelKeys) && is_string) {
+                    reader.Read(&label);
+                } else if (IsKey(key, kLabelKeys)) {
+                    int64_t id;
+                    reader.Read(&id);
+                    label = std::to_string(id);
+                } else if (IsKey(key, kStartKeys)) {
+                    reader.Read(&start);
+                } else if (IsKey(key, kEndKeys)) {
+                    reader.Read(&end);
+                } else if (is_string) {
+                    std::string ignored;
+                    reader.Read(&ignored);
+                } else {
+                    double ignored;
+                    reader.Read(&ignored);
+                }
+            }
+            paths.emplace_back(path);
+            labels.emplace_back(label);
+            starts.emplace_back(start);
+            ends.emplace_back(end);
+        }
+    } else {
+        std::string line;
+        CHECK(std::getline(fin, line)) << "Empty annotation: " << annotation;
+        std::vector<std::string> header = ParseCSVLine(line);
+        int path_col = FindColumn(header, kPathKeys);
+        int label_col = FindColumn(header, kLabelKeys);
+        int start_col = FindColumn(header, kStartKeys);
+        int end_col = FindColumn(header, kEndKeys);
+        CHECK_GE(path_col, 0) << "Annotation requires a path column: " << annotation;
+        CHECK_GE(label_col, 0) << "Annotation requires a label column: " << annotation;
+        while (std::getline(fin, line)) {
+            if (line.empty() || line == "\r") continue;
+            std::vector<std::string> row = ParseCSVLine(line);
+            CHECK_EQ(row.size(), header.size()) << "Malformed annotation line: " << line;
+            paths.emplace_back(row[path_col]);
+            labels.emplace_back(row[label_col]);
+            starts.emplace_back(start_col < 0 ? 0 : ParseTime(row[start_col], 0));
+            ends.emplace_back(end_col < 0 ? -1 : ParseTime(row[end_col], -1));
+        }
+    }
+
+    // integer labels are used as is, otherwise class names are mapped to ids in sorted order
+    bool integer_labels = std::all_of(labels.begin(), labels.end(), IsInteger);
+    std::map<std::string, int64_t> class_ids;
+    if (!integer_labels) {
+        for (auto& label : labels) class_ids.emplace(label, 0);
+        for (auto& kv : class_ids) {
+            kv.second = static_cast<int64_t>(class_names_.size());
+            class_names_.emplace_back(kv.first);
+        }
+    }
+
+    std::unordered_map<std::string, std::size_t> file_ids;
+    clips_.reserve(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        CHECK(!paths[i].empty()) << "Missing path of clip " << i << " in " << annotation;
+        std::string path = paths[i];
+        if (!prefix.empty() && path[0] != '/') path = prefix + "/" + path;
+        auto it = file_ids.find(path);
+        if (it == file_ids.end()) {
+            it = file_ids.emplace(path, files_.size()).first;
+            files_.emplace_back(File(path));
+        }
+        Clip clip;
+        clip.file = it->second;
+        clip.label = integer_labels ? std::strtoll(labels[i].c_str(), nullptr, 10) : class_ids[labels[i]];
+        clip.start = std::max(0., starts[i]);
+        clip.end = ends[i];
+        CHECK(clip.end < 0 || clip.end > clip.start)
+            << "Invalid clip interval [" << clip.start << ", " << clip.end << ") in " << path;
+        clips_.emplace_back(clip);
+    }
+}
+
+std::vector<int64_t> VideoClipDataset::SampleIndices(int64_t begin, int64_t end, int num_frames,
+                                                     std::mt19937 *rng) {
+    CHECK_LT(begin, end) << "Empty clip interval: [" << begin << ", " << end << ")";
+    CHECK_GT(num_frames, 0);
+    const int64_t len = end - begin;
+    const double seg = static_cast<double>(len) / num_frames;
+    std::uniform_real_distribution<double> jitter(0, seg);
+    std::vector<int64_t> indices(num_frames);
+    for (int i = 0; i < num_frames; ++i) {
+        double pos = rng ? seg * i + jitter(*rng) : seg * (i + 0.5);
+        indices[i] = begin + std::min(len - 1, static_cast<int64_t>(pos));
+    }
+    return indices;
+}
+
+void VideoClipDataset::OpenFile(File *file) {
+    if (file->reader) return;
+    if (ImageSequenceReader::IsImageSequence(file->path)) {
+        file->reader = std::make_shared<ImageSequenceReader>(file->path, ctx_, width_, height_);
+    } else {
+        file->reader = std::make_shared<VideoReader>(file->path, ctx_, width_, height_);
+    }
+    if (file->frame_count < 0) {
+        file->frame_count = file->reader->GetFrameCount();
+        file->fps = file->reader->GetAverageFPS();
+        CHECK_GT(file->frame_count, 0) << "Error getting total frame from " << file->path;
+        CHECK_GT(file->fps, 0) << "Error getting fps from " << file->path;
+    }
+}
+
+void VideoClipDataset::DecodeClips(const std::vector<std::size_t>& clip_ids, bool jitter, NDArray buf,
+                                   std::vector<std::vector<int64_t> > *frame_indices) {
+    // group slots by file, each group is decoded by one worker with a single reader
+    std::vector<std::vector<std::size_t> > groups;
+    std::unordered_map<std::size_t, std::size_t> group_of_file;
+    for (std::size_t slot = 0; slot < clip_ids.size(); ++slot) {
+        std::size_t file = clips_[clip_ids[slot]].file;
+        auto it = group_of_file.emplace(file, groups.size()).first;
+        if (it->second == groups.size()) groups.emplace_back();
+        groups[it->second].emplace_back(slot);
+    }
+    for (auto& group : groups) {
+        // visit clips in time order so the reader mostly moves forward
+        std::stable_sort(group.begin(), group.end(), [&](std::size_t a, std::size_t b) {
+            return clips_[clip_ids[a]].start < clips_[clip_ids[b]].start;
+        });
+        // mark files used before decoding, so failed opens are still evicted later
+        File& f = files_[clips_[clip_ids[group[0]]].file];
+        if (f.in_lru) open_files_.erase(f.lru);
+        open_files_.push_front(clips_[clip_ids[group[0]]].file);
+        f.lru = open_files_.begin();
+        f.in_lru = true;
+    }
+    std::vector<uint32_t> seeds(clip_ids.size());
+    for (auto& seed : seeds) seed = rng_();
+
+    frame_indices->resize(clip_ids.size());
+    const std::vector<int64_t> clip_shape = {num_frames_, height_, width_, 3};
+    const uint64_t clip_bytes = static_cast<uint64_t>(num_frames_) * height_ * width_ * 3;
+    runtime::ParallelFor(static_cast<int64_t>(groups.size()), [&](int64_t g) {
+        for (std::size_t slot : groups[g]) {
+            const Clip& clip = clips_[clip_ids[slot]];
+            File& file = files_[clip.file];
+            OpenFile(&file);
+            int64_t begin = std::min(static_cast<int64_t>(clip.start * file.fps + 0.5), file.frame_count - 1);
+            int64_t end = file.frame_count;
+            if (clip.end >= 0) {
+                end = std::max(begin + 1, std::min(static_cast<int64_t>(clip.end * file.fps + 0.5), end));
+            }
+            std::mt19937 rng(seeds[slot]);
+            (*frame_indices)[slot] = SampleIndices(begin, end, num_frames_, jitter ? &rng : nullptr);
+            uint64_t offset = slot * clip_bytes;
+            NDArray view = buf.CreateOffsetView(clip_shape, kUInt8, &offset);
+            file.reader->GetBatch((*frame_indices)[slot], view);
+        }
+    });
+
+    // release least recently used readers, frame count and fps are kept
+    while (open_files_.size() > max_open_) {
+        File& f = files_[open_files_.back()];
+        f.reader = nullptr;
+        f.in_lru = false;
+        open_files_.pop_back();
+    }
+}
+
+void VideoClipDataset::Reset() {
+    visit_order_.resize(clips_.size());
+    std::iota(visit_order_.begin(), visit_order_.end(), 0);
+    if (shuffle_) {
+        std::shuffle(visit_order_.begin(), visit_order_.end(), rng_);
+    }
+    curr_ = 0;
+}
+
+bool VideoClipDataset::HasNext() const {
+    return curr_ + bs_ <= visit_order_.size();
+}
+
+int64_t VideoClipDataset::Length() const {
+    // last incomplete batch is dropped, use GetClip to access every clip
+    return static_cast<int64_t>(clips_.size() / bs_);
+}
+
+void VideoClipDataset::Next() {
+    if (next_ready_ & 1) {
+        LOG(WARNING) << "VideoClipDataset: previous data not consumed."
+            << "You should call NextData() to fetch data.";
+    }
+    next_indices_.clear();
+    next_labels_.clear();
+    if (!HasNext()) {
+        next_data_ = NDArray::Empty({}, kUInt8, ctx_);
+        next_ready_ = 7;
+        return;
+    }
+    std::vector<std::size_t> clip_ids(visit_order_.begin() + curr_, visit_order_.begin() + curr_ + bs_);
+    curr_ += bs_;
+    next_data_ = NDArray::Empty({bs_, num_frames_, height_, width_, 3}, kUInt8, ctx_);
+    std::vector<std::vector<int64_t> > frame_indices;
+    DecodeClips(clip_ids, shuffle_, next_data_, &frame_indices);
+    next_indices_.reserve(bs_ * num_frames_ * 2);
+    for (std::size_t i = 0; i < clip_ids.size(); ++i) {
+        for (auto idx : frame_indices[i]) {
+            // clip index first
+            next_indices_.emplace_back(static_cast<int64_t>(clip_ids[i]));
+            // frame index in video second
+            next_indices_.emplace_back(idx);
+        }
+        next_labels_.emplace_back(clips_[clip_ids[i]].label);
+    }
+    next_ready_ = 7;
+}
+
+NDArray VideoClipDataset::NextData() {
+    CHECK(next_ready_ & 1) << "Data fetched already.";
+    next_ready_ &= 0xFE;
+    return next_data_;
+}
+
+NDArray VideoClipDataset::NextIndices() {
+    CHECK(next_ready_ & 2) << "Indices fetch already.";
+    std::vector<int64_t> shape = {static_cast<int64_t>(next_indices_.size() / 2), 2};
+    auto indices = NDArray::Empty(shape, kInt64, ctx_);
+    indices.CopyFrom(next_indices_, shape);
+    next_ready_ &= 0xFD;
+    return indices;
+}
+
+NDArray VideoClipDataset::NextLabels() {
+    CHECK(next_ready_ & 4) << "Labels fetch already.";
+    std::vector<int64_t> shape = {static_cast<int64_t>(next_labels_.size())};
+    auto labels = NDArray::Empty(shape, kInt64, ctx_);
+    labels.CopyFrom(next_labels_, shape);
+    next_ready_ &= 0xFB;
+    return labels;
+}
+
+NDArray VideoClipDataset::GetClip(int64_t idx) {
+    CHECK(idx >= 0 && idx < NumClips()) << "Clip index out of range: " << idx;
+    NDArray buf = NDArray::Empty({1, num_frames_, height_, width_, 3}, kUInt8, ctx_);
+    std::vector<std::vector<int64_t> > frame_indices;
+    DecodeClips({static_cast<std::size_t>(idx)}, false, buf, &frame_indices);
+    return buf.CreateView({num_frames_, height_, width_, 3}, kUInt8);
+}
+
+int64_t VideoClipDataset::GetLabel(int64_t idx) const {
+    CHECK(idx >= 0 && idx < NumClips()) << "Clip index out of range: " << idx;
+    return clips_[idx].label;
+}
+
+}  // namespace decord
@@ -0,0 +1,111 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file clip_dataset.h
+ * \brief Annotated video clip dataset, implements VideoLoaderInterface
+ */
+
+#ifndef DECORD_VIDEO_CLIP_DATASET_H_
+#define DECORD_VIDEO_CLIP_DATASET_H_
+
+#include "video_reader.h"
+
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <decord/video_interface.h>
+
+namespace decord {
+
+/**
+ * \brief Dataset of trimmed clips described by an annotation file.
+ *
+ * Annotation is a CSV file with header, or a JSON array of objects, with fields
+ *   path (aliases: filename, video), label, start and end (in seconds, optional).
+ * Each batch is [batch, num_frames, height, width, 3] with num_frames sampled uniformly
+ * inside [start, end), randomly jittered per segment when shuffling.
+ * Clips of a batch are decoded in parallel on the runtime thread pool, clips from the same
+ * file share one reader, and readers are kept open across batches (LRU, max_open_readers).
+ */
+class VideoClipDataset : public VideoLoaderInterface {
+    public:
+        VideoClipDataset(std::string annotation, std::string root, DLContext ctx,
+                         int batch_size, int num_frames, int width, int height,
+                         bool shuffle, int max_open_readers = 16);
+        ~VideoClipDataset();
+        void Reset();
+        bool HasNext() const;
+        int64_t Length() const;
+        void Next();
+        NDArray NextData();
+        /*! \brief (clip index, frame index) pairs, [batch * num_frames, 2] */
+        NDArray NextIndices();
+        /*! \brief labels of the last batch, [batch] int64 */
+        NDArray NextLabels();
+        /*! \brief number of annotated clips */
+        int64_t NumClips() const { return static_cast<int64_t>(clips_.size()); }
+        /*! \brief frames of a single clip, [num_frames, height, width, 3], not jittered */
+        NDArray GetClip(int64_t idx);
+        int64_t GetLabel(int64_t idx) const;
+        /*! \brief label names ordered by label id, empty if labels are integers in annotation */
+        const std::vector<std::string>& GetClassNames() const { return class_names_; }
+
+        /**
+         * \brief Sample frame indices in [begin, end).
+         * \param begin First frame of clip
+         * \param end One past last frame of clip
+         * \param num_frames Number of frames to sample, repeats frames for short clips
+         * \param rng Random engine for per segment jitter, segment centers if nullptr
+         * \return Non-decreasing frame indices
+         */
+        static std::vector<int64_t> SampleIndices(int64_t begin, int64_t end, int num_frames,
+                                                  std::mt19937 *rng);
+
+    private:
+        struct Clip {
+            std::size_t file;
+            int64_t label;
+            double start;
+            double end;  // < 0 means end of video
+        };
+        struct File {
+            std::string path;
+            VideoReaderPtr reader;
+            int64_t frame_count;
+            double fps;
+            bool in_lru;
+            std::list<std::size_t>::iterator lru;
+
+            explicit File(std::string p) : path(p), reader(nullptr), frame_count(-1), fps(0), in_lru(false) {}
+        };
+
+        void LoadAnnotation(const std::string& annotation, const std::string& root);
+        /*! \brief decode clips into consecutive slots of buf, clips of the same file run in order */
+        void DecodeClips(const std::vector<std::size_t>& clip_ids, bool jitter, NDArray buf,
+                         std::vector<std::vector<int64_t> > *frame_indices);
+        /*! \brief open reader of file if not yet, called by at most one worker per file */
+        void OpenFile(File *file);
+
+        std::vector<Clip> clips_;
+        std::vector<File> files_;
+        std::vector<std::string> class_names_;
+        DLContext ctx_;
+        int bs_;
+        int num_frames_;
+        int width_;
+        int height_;
+        bool shuffle_;
+        std::size_t max_open_;
+        std::list<std::size_t> open_files_;  // most recently used first
+        std::vector<std::size_t> visit_order_;
+        std::size_t curr_;
+        std::mt19937 rng_;
+        char next_ready_;  // ready flag, use with 0xFE for data, 0xFD for indices, 0xFB for labels
+        NDArray next_data_;
+        std::vector<int64_t> next_indices_;
+        std::vector<int64_t> next_labels_;
+};  // class VideoClipDataset
+}  // namespace decord
+
+#endif  // DECORD_VIDEO_CLIP_DATASET_H_
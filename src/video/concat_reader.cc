@@ -0,0 +1,311 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file concat_reader.cc
+ * \brief Concatenated segment reader Impl
+ */
+
+#include "concat_reader.h"
+#include "../runtime/parallel_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+
+/*! \brief maximum number of segment readers kept open */
+static const std::size_t kMaxOpenSegments = 4;
+
+namespace {
+
+/**
+ * \brief stream, frame count and fps of the segment without indexing it.
+ *
+ * Picks the stream a VideoReader opened at width x height decodes and counts frames the same way,
+ * so offsets match the reader opened later on the pinned stream.
+ */
+void ProbeSegment(const std::string& fn, int width, int height, bool autorotate,
+                  int *stream, int64_t *frame_count, double *fps) {
+    #if ( LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100) )
+    av_register_all();
+    #endif
+    AVFormatContext *fmt_ctx = nullptr;
+    int open_ret = avformat_open_input(&fmt_ctx, fn.c_str(), NULL, NULL);
+    if (open_ret != 0) {
+        char errstr[200];
+        av_strerror(open_ret, errstr, 200);
+        LOG(FATAL) << "ERROR opening file: " << fn.c_str() << ", " << errstr;
+    }
+    ffmpeg::AVFormatContextPtr holder(fmt_ctx);
+    CHECK_GE(avformat_find_stream_info(fmt_ctx, NULL), 0) << "ERROR getting stream info of file" << fn;
+    int wanted = -1;
+    if (width > 0 || height > 0) wanted = VideoReader::SelectRendition(fmt_ctx, width, height, autorotate);
+    *stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, wanted, -1, NULL, 0);
+    CHECK_GE(*stream, 0) << "ERROR cannot find video stream in " << fn;
+    AVStream *st = fmt_ctx->streams[*stream];
+    *fps = static_cast<double>(st->avg_frame_rate.num) / st->avg_frame_rate.den;
+    *frame_count = st->nb_frames;
+    if (*frame_count < 1) {
+        *frame_count = static_cast<double>(st->avg_frame_rate.num) / st->avg_frame_rate.den
+            * fmt_ctx->duration / AV_TIME_BASE;
+    }
+}
+
+std::string Trim(const std::string& s) {
+    std::size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    std::size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+}  // namespace
+
+ConcatVideoReader::ConcatVideoReader(std::vector<std::string> segments, DLContext ctx,
+                                     int width, int height, FrameOptions opts)
+    : ctx_(ctx), segments_(), curr_frame_(0), width_(width), height_(height),
+    opts_(opts), use_clock_(0) {
+    CHECK_GT(segments.size(), 0) << "At least one segment is required.";
+    segments_.resize(segments.size());
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        segments_[i].path = segments[i];
+        segments_[i].last_use = 0;
+    }
+    // first segment decides output size of all segments and is read first anyway
+    auto first = std::make_shared<VideoReader>(segments_[0].path, ctx_, width_, height_, opts_);
+    width_ = first->GetWidth();
+    height_ = first->GetHeight();
+    segments_[0].stream = first->GetVideoStream();
+    segments_[0].frame_count = first->GetFrameCount();
+    segments_[0].fps = first->GetAverageFPS();
+    std::promise<SegmentReaderPtr> opened;
+    opened.set_value(first);
+    segments_[0].reader = opened.get_future().share();
+    segments_[0].last_use = ++use_clock_;
+    // header probing only, at the size segments are reopened with, segments are independent
+    runtime::ParallelFor(static_cast<int64_t>(segments_.size()) - 1, [&](int64_t i) {
+        auto& seg = segments_[i + 1];
+        ProbeSegment(seg.path, width_, height_, opts_.autorotate, &seg.stream, &seg.frame_count, &seg.fps);
+    });
+    int64_t start = 0;
+    double start_time = 0;
+    for (auto& seg : segments_) {
+        CHECK_GT(seg.frame_count, 0) << "Error getting total frame from " << seg.path;
+        seg.start = start;
+        seg.start_time = start_time;
+        start += seg.frame_count;
+        start_time += seg.frame_count / seg.fps;
+    }
+}
+
+ConcatVideoReader::~ConcatVideoReader() {
+    // wait for background opening before readers are released
+    for (auto& seg : segments_) {
+        if (seg.reader.valid()) seg.reader.wait();
+    }
+}
+
+std::vector<std::string> ConcatVideoReader::ParsePlaylist(const std::string& fn) {
+    std::ifstream fin(fn);
+    CHECK(fin.good()) << "Error opening playlist: " << fn;
+    std::size_t sep = fn.find_last_of("/\\");
+    std::string dir = sep == std::string::npos ? "" : fn.substr(0, sep + 1);
+    std::vector<std::string> segments;
+    std::string line;
+    while (std::getline(fin, line)) {
+        line = Trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        if (line.compare(0, 5, "file ") == 0) {
+            // ffconcat: file 'path'
+            line = Trim(line.substr(5));
+            if (line.size() >= 2 && (line[0] == '\'' || line[0] == '"') && line.back() == line[0]) {
+                line = line.substr(1, line.size() - 2);
+            }
+        } else if (line.compare(0, 8, "ffconcat") == 0 || line.find(' ') != std::string::npos) {
+            // ffconcat header and other directives
+            continue;
+        }
+        if (line[0] != '/' && line.find("://") == std::string::npos) line = dir + line;
+        segments.emplace_back(line);
+    }
+    CHECK_GT(segments.size(), 0) << "No segment found in playlist: " << fn;
+    return segments;
+}
+
+void ConcatVideoReader::OpenSegment(std::size_t idx) {
+    auto& seg = segments_[idx];
+    if (seg.reader.valid()) return;
+    seg.last_use = ++use_clock_;
+    std::string path = seg.path;
+    DLContext ctx = ctx_;
+    int width = width_;
+    int height = height_;
+    FrameOptions opts = opts_;
+    // pinned to the probed stream, size alone may pick another rendition than the probe did
+    int stream = seg.stream;
+    seg.reader = std::async(std::launch::async, [path, ctx, width, height, opts, stream]() {
+        return std::make_shared<VideoReader>(path, ctx, width, height, opts, stream);
+    }).share();
+}
+
+ConcatVideoReader::SegmentReaderPtr ConcatVideoReader::GetSegment(std::size_t idx) {
+    CHECK_LT(idx, segments_.size());
+    OpenSegment(idx);
+    auto& seg = segments_[idx];
+    seg.last_use = ++use_clock_;
+    SegmentReaderPtr reader = seg.reader.get();
+    // offsets of all later segments depend on it
+    CHECK_EQ(reader->GetFrameCount(), seg.frame_count) << "Segment " << seg.path << " changed since opened";
+    CloseSegments(idx);
+    return reader;
+}
+
+void ConcatVideoReader::CloseSegments(std::size_t keep) {
+    std::vector<std::size_t> opened;
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        if (segments_[i].reader.valid()) opened.emplace_back(i);
+    }
+    if (opened.size() <= kMaxOpenSegments) return;
+    std::sort(opened.begin(), opened.end(), [this](std::size_t a, std::size_t b) {
+        return segments_[a].last_use < segments_[b].last_use;
+    });
+    for (std::size_t i = 0; i < opened.size() - kMaxOpenSegments; ++i) {
+        auto& seg = segments_[opened[i]];
+        if (opened[i] == keep) continue;
+        // never block on a segment still being opened in background
+        if (seg.reader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        seg.reader = std::shared_future<SegmentReaderPtr>();
+    }
+}
+
+std::pair<std::size_t, int64_t> ConcatVideoReader::Locate(int64_t pos) const {
+    CHECK_GE(pos, 0);
+    CHECK_LT(pos, GetFrameCount());
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), pos,
+        [](int64_t p, const Segment& seg) { return p < seg.start; });
+    std::size_t idx = static_cast<std::size_t>(it - segments_.begin()) - 1;
+    return std::make_pair(idx, pos - segments_[idx].start);
+}
+
+void ConcatVideoReader::SetVideoStream(int stream_nb) {
+    CHECK_LE(stream_nb, 0) << "Stream selection is not supported for concatenated segments.";
+}
+
+unsigned int ConcatVideoReader::QueryStreams() const {
+    LOG(INFO) << "concatenated video: " << segments_.size() << " segments, " << GetFrameCount()
+        << " frames, first: " << segments_.front().path;
+    return 1;
+}
+
+int64_t ConcatVideoReader::GetFrameCount() const {
+    const auto& last = segments_.back();
+    return last.start + last.frame_count;
+}
+
+int64_t ConcatVideoReader::GetCurrentPosition() const {
+    return curr_frame_;
+}
+
+NDArray ConcatVideoReader::NextFrame() {
+    if (curr_frame_ >= GetFrameCount()) {
+        return NDArray::Empty({}, kUInt8, ctx_);
+    }
+    auto loc = Locate(curr_frame_);
+    auto reader = GetSegment(loc.first);
+    int64_t reader_pos = reader->GetCurrentPosition();
+    if (reader_pos < loc.second) {
+        reader->SkipFrames(loc.second - reader_pos);
+    } else if (reader_pos > loc.second) {
+        reader->SeekAccurate(loc.second);
+    }
+    NDArray frame = reader->NextFrame();
+    ++curr_frame_;
+    // sequential read, have next segment ready when this one ends
+    if (loc.first + 1 < segments_.size()) OpenSegment(loc.first + 1);
+    return frame;
+}
+
+NDArray ConcatVideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    std::vector<int64_t> frame_shape = ffmpeg::FrameShape(opts_.pix_fmt, height_, width_);
+    DLDataType dtype = ffmpeg::FrameDType(opts_.pix_fmt);
+    int64_t frame_elems = 1;
+    for (auto s : frame_shape) frame_elems *= s;
+    if (!buf.defined()) {
+        std::vector<int64_t> buf_shape = {bs};
+        buf_shape.insert(buf_shape.end(), frame_shape.begin(), frame_shape.end());
+        buf = NDArray::Empty(buf_shape, dtype, ctx_);
+    }
+    CHECK_EQ(buf.Size(), bs * frame_elems) << "Invalid output buffer size";
+    uint64_t offset = 0;
+    int64_t i = 0;
+    while (i < bs) {
+        // consecutive indices in the same segment are decoded by one reader into a view of output
+        auto loc = Locate(indices[i]);
+        std::vector<int64_t> local = {loc.second};
+        int64_t j = i + 1;
+        for (; j < bs; ++j) {
+            auto next = Locate(indices[j]);
+            if (next.first != loc.first) break;
+            local.emplace_back(next.second);
+        }
+        std::vector<int64_t> view_shape = {j - i};
+        view_shape.insert(view_shape.end(), frame_shape.begin(), frame_shape.end());
+        NDArray view = buf.CreateOffsetView(view_shape, dtype, &offset);
+        GetSegment(loc.first)->GetBatch(local, view);
+        i = j;
+    }
+    if (bs > 0) curr_frame_ = indices.back() + 1;
+    return buf;
+}
+
+void ConcatVideoReader::SkipFrames(int64_t num) {
+    // segment readers catch up lazily in NextFrame
+    curr_frame_ = std::min(curr_frame_ + std::max(num, static_cast<int64_t>(0)), GetFrameCount());
+}
+
+bool ConcatVideoReader::Seek(int64_t pos) {
+    if (pos < 0 || pos >= GetFrameCount()) {
+        LOG(WARNING) << "Failed to seek file to position: " << pos;
+        return false;
+    }
+    auto loc = Locate(pos);
+    auto reader = GetSegment(loc.first);
+    if (!reader->Seek(loc.second)) return false;
+    curr_frame_ = segments_[loc.first].start + reader->GetCurrentPosition();
+    return true;
+}
+
+bool ConcatVideoReader::SeekAccurate(int64_t pos) {
+    if (pos < 0 || pos >= GetFrameCount()) {
+        LOG(WARNING) << "Failed to seek file to position: " << pos;
+        return false;
+    }
+    auto loc = Locate(pos);
+    if (!GetSegment(loc.first)->SeekAccurate(loc.second)) return false;
+    curr_frame_ = pos;
+    return true;
+}
+
+NDArray ConcatVideoReader::GetKeyIndices() {
+    std::vector<int64_t> keys;
+    keys.reserve(segments_.size());
+    for (auto& seg : segments_) keys.emplace_back(seg.start);
+    std::vector<int64_t> shape = {static_cast<int64_t>(keys.size())};
+    NDArray ret = NDArray::Empty(shape, kInt64, kCPU);
+    ret.CopyFrom(keys, shape);
+    return ret;
+}
+
+double ConcatVideoReader::GetAverageFPS() const {
+    return segments_.front().fps;
+}
+
+double ConcatVideoReader::GetFrameTimestamp(int64_t pos) const {
+    auto loc = Locate(pos);
+    const auto& seg = segments_[loc.first];
+    return seg.start_time + loc.second / seg.fps;
+}
+
+}  // namespace decord
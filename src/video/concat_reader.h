@@ -0,0 +1,104 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file concat_reader.h
+ * \brief Reader presenting segmented recordings as one video, implements VideoReaderInterface
+ */
+
+#ifndef DECORD_VIDEO_CONCAT_READER_H_
+#define DECORD_VIDEO_CONCAT_READER_H_
+
+#include "video_reader.h"
+#include <decord/video_interface.h>
+
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/**
+ * \brief ConcatVideoReader concatenates ordered segment files into one virtual video.
+ *
+ * Only container headers of segments are probed for stream, frame count and fps, which define the
+ * global frame indices and timestamps. Segment readers are pinned to the probed stream, so indices
+ * match what they decode. Readers are opened lazily on first access, except the first segment which
+ * decides the output size, the next segment is opened in background during sequential reads, and
+ * only a few segments are kept open at a time.
+ */
+class ConcatVideoReader : public VideoReaderInterface {
+    using NDArray = runtime::NDArray;
+    using SegmentReaderPtr = std::shared_ptr<VideoReader>;
+    public:
+        /**
+         * \brief Construct a new ConcatVideoReader object
+         *
+         * \param segments Ordered segment files
+         * \param ctx Decoding context
+         * \param width Output width, -1 to follow the first segment
+         * \param height Output height, -1 to follow the first segment
+         * \param opts Frame conversion options applied to every segment
+         */
+        ConcatVideoReader(std::vector<std::string> segments, DLContext ctx, int width=-1, int height=-1,
+                          FrameOptions opts=FrameOptions());
+        ~ConcatVideoReader();
+        void SetVideoStream(int stream_nb = -1);
+        unsigned int QueryStreams() const;
+        int64_t GetFrameCount() const;
+        int64_t GetCurrentPosition() const;
+        NDArray NextFrame();
+        NDArray GetBatch(std::vector<int64_t> indices, NDArray buf);
+        void SkipFrames(int64_t num = 1);
+        bool Seek(int64_t pos);
+        bool SeekAccurate(int64_t pos);
+        /*! \brief segment boundaries, per segment keyframes are not indexed to keep segments lazy */
+        NDArray GetKeyIndices();
+        double GetAverageFPS() const;
+        /*! \brief presentation time of frame at global position in seconds, from start of first segment */
+        double GetFrameTimestamp(int64_t pos) const;
+        /**
+         * \brief Read segment list from local playlist.
+         *
+         * Supports m3u/m3u8 (non comment lines are segments) and ffconcat ("file 'path'" lines),
+         * relative paths are resolved against the playlist directory.
+         *
+         * \param fn Playlist file
+         * \return std::vector<std::string> Segment files
+         */
+        static std::vector<std::string> ParsePlaylist(const std::string& fn);
+
+    private:
+        struct Segment {
+            std::string path;
+            /*! \brief probed video stream, readers of the segment decode this one */
+            int stream;
+            /*! \brief global index of first frame */
+            int64_t start;
+            int64_t frame_count;
+            /*! \brief start time in seconds */
+            double start_time;
+            double fps;
+            /*! \brief reader being opened or opened, invalid if closed */
+            std::shared_future<SegmentReaderPtr> reader;
+            /*! \brief access clock for closing least recently used segments */
+            uint64_t last_use;
+        };
+
+        /*! \brief segment index and local frame index of global position */
+        std::pair<std::size_t, int64_t> Locate(int64_t pos) const;
+        void OpenSegment(std::size_t idx);
+        SegmentReaderPtr GetSegment(std::size_t idx);
+        void CloseSegments(std::size_t keep);
+
+        DLContext ctx_;
+        std::vector<Segment> segments_;
+        int64_t curr_frame_;
+        int width_;
+        int height_;
+        FrameOptions opts_;
+        uint64_t use_clock_;
+};  // class ConcatVideoReader
+}  // namespace decord
+#endif  // DECORD_VIDEO_CONCAT_READER_H_
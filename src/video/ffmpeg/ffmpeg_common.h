@@ -12,8 +12,12 @@
 #include <decord/runtime/ndarray.h>
 #include <decord/runtime/device_api.h>
 
+#include <cmath>
+#include <cstring>
 #include <memory>
+#include <string>
 #include <queue>
+#include <vector>
 #include <functional>
 #include <atomic>
 
@@ -27,6 +31,9 @@ extern "C" {
 #include <libavfilter/buffersrc.h>
 #include <libavutil/avutil.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/display.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/opt.h>
 #include <libavutil/version.h>
 #ifdef __cplusplus
@@ -182,13 +189,112 @@ using AVCodecParametersPtr = std::unique_ptr<
     AVCodecParameters, Deleterp<AVCodecParameters, void, avcodec_parameters_free> >;
 
 
+/**
+ * \brief Whether pixel format can be converted to NDArray
+ *
+ * \param fmt Pixel format
+ * \return true Packed RGB24/RGB48/GRAY8 or 4:2:0 10bit P010/YUV420P10
+ */
+inline bool IsSupportedPixelFormat(AVPixelFormat fmt) {
+    return fmt == AV_PIX_FMT_RGB24 || fmt == AV_PIX_FMT_GRAY8 || fmt == AV_PIX_FMT_RGB48LE
+        || fmt == AV_PIX_FMT_P010LE || fmt == AV_PIX_FMT_YUV420P10LE;
+}
+
+/**
+ * \brief Whether pixel format is a single packed plane
+ *
+ * \param fmt Pixel format
+ */
+inline bool IsPackedPixelFormat(AVPixelFormat fmt) {
+    return fmt == AV_PIX_FMT_RGB24 || fmt == AV_PIX_FMT_GRAY8 || fmt == AV_PIX_FMT_RGB48LE;
+}
+
+/**
+ * \brief NDArray data type of frames in pixel format
+ *
+ * \param fmt Pixel format
+ * \return DLDataType kUInt8 for 8bit formats, kUInt16 otherwise
+ */
+inline DLDataType FrameDType(AVPixelFormat fmt) {
+    CHECK(IsSupportedPixelFormat(fmt)) << "Unsupported output pixel format: " << fmt;
+    return (fmt == AV_PIX_FMT_RGB24 || fmt == AV_PIX_FMT_GRAY8) ? kUInt8 : kUInt16;
+}
+
+/**
+ * \brief NDArray shape of frames in pixel format
+ *
+ * Packed formats are (H, W, C), 4:2:0 formats stack luma and chroma planes as (H * 3 / 2, W).
+ *
+ * \param fmt Pixel format
+ * \param height Frame height
+ * \param width Frame width
+ * \return std::vector<int64_t> Shape
+ */
+inline std::vector<int64_t> FrameShape(AVPixelFormat fmt, int height, int width) {
+    CHECK(IsSupportedPixelFormat(fmt)) << "Unsupported output pixel format: " << fmt;
+    if (fmt == AV_PIX_FMT_GRAY8) return {height, width, 1};
+    if (IsPackedPixelFormat(fmt)) return {height, width, 3};
+    CHECK(height % 2 == 0 && width % 2 == 0)
+        << "4:2:0 output requires even resolution, given: " << width << "x" << height;
+    return {height * 3 / 2, width};
+}
+
+/**
+ * \brief Read display orientation from stream display matrix side data
+ *
+ * \param st Video stream
+ * \param rotation Clockwise rotation in degrees, one of 0, 90, 180, 270
+ * \param hflip Whether frame is mirrored horizontally before rotation
+ */
+inline void GetDisplayOrientation(const AVStream *st, int *rotation, bool *hflip) {
+    *rotation = 0;
+    *hflip = false;
+    uint8_t *side_data = av_stream_get_side_data(st, AV_PKT_DATA_DISPLAYMATRIX, NULL);
+    if (!side_data) return;
+    int32_t matrix[9];
+    std::memcpy(matrix, side_data, sizeof(matrix));
+    // negative determinant means mirrored, undo the flip so the rest is a pure rotation
+    if (static_cast<int64_t>(matrix[0]) * matrix[4] - static_cast<int64_t>(matrix[1]) * matrix[3] < 0) {
+        *hflip = true;
+        matrix[0] = -matrix[0];
+        matrix[3] = -matrix[3];
+        matrix[6] = -matrix[6];
+    }
+    double theta = -av_display_rotation_get(matrix);
+    if (std::isnan(theta)) return;
+    int degree = static_cast<int>(std::lround(theta / 90.)) * 90;
+    if (std::fabs(theta - degree) > 1.) {
+        LOG(WARNING) << "Ignore display rotation of " << theta << " degrees, not a multiple of 90.";
+        return;
+    }
+    *rotation = ((degree % 360) + 360) % 360;
+}
+
+/**
+ * \brief Filter description applying display orientation, empty if nothing to do
+ *
+ * \param rotation Clockwise rotation in degrees, one of 0, 90, 180, 270
+ * \param hflip Whether to mirror horizontally before rotation
+ * \return std::string Comma separated filters
+ */
+inline std::string OrientationFilter(int rotation, bool hflip) {
+    switch (rotation) {
+        case 90: return hflip ? "transpose=clock_flip" : "transpose=clock";
+        case 180: return hflip ? "vflip" : "hflip,vflip";
+        case 270: return hflip ? "transpose=cclock_flip" : "transpose=cclock";
+        default: return hflip ? "hflip" : "";
+    }
+}
+
 inline void ToDLTensor(AVFramePtr p, DLTensor& dlt, int64_t *shape) {
 	CHECK(p) << "Error: converting empty AVFrame to DLTensor";
-	// int channel = p->linesize[0] / p->width;
-	CHECK(AVPixelFormat(p->format) == AV_PIX_FMT_RGB24 || AVPixelFormat(p->format) == AV_PIX_FMT_GRAY8)
-        << "Only support RGB24/GRAY8 image to NDArray conversion, given: "
-        << AVPixelFormat(p->format);
-    CHECK(p->linesize[0] % p->width == 0)
+	AVPixelFormat fmt = AVPixelFormat(p->format);
+	CHECK(IsPackedPixelFormat(fmt))
+        << "Only support RGB24/RGB48/GRAY8 image to NDArray zero copy conversion, given: "
+        << fmt;
+    auto frame_shape = FrameShape(fmt, p->height, p->width);
+    DLDataType dtype = FrameDType(fmt);
+    CHECK(p->linesize[0] == p->width * frame_shape[2] * (dtype.bits / 8))
         << "AVFrame data is not a compact array. linesize: " << p->linesize[0]
         << " width: " << p->width;
 
@@ -200,16 +306,13 @@ inline void ToDLTensor(AVFramePtr p, DLTensor& dlt, int64_t *shape) {
 	else {
 		ctx = kCPU;
 	}
-	// LOG(INFO) << p->height << " x";
-	// std::vector<int64_t> shape = { p->height, p->width, p->linesize[0] / p->width };
-    // LOG(INFO) << p->height << " x " << p->width;
-	shape[0] = p->height;
-	shape[1] = p->width;
-	shape[2] = p->linesize[0] / p->width;
+	shape[0] = frame_shape[0];
+	shape[1] = frame_shape[1];
+	shape[2] = frame_shape[2];
 	dlt.data = p->data[0];
 	dlt.ctx = ctx;
 	dlt.ndim = 3;
-	dlt.dtype = kUInt8;
+	dlt.dtype = dtype;
 	dlt.shape = shape;
     dlt.strides = NULL;
 	dlt.byte_offset = 0;
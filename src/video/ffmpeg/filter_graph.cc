@@ -11,18 +11,18 @@
 namespace decord {
 namespace ffmpeg {
 
-FFMPEGFilterGraph::FFMPEGFilterGraph(std::string filters_descr, AVCodecContext *dec_ctx)
+FFMPEGFilterGraph::FFMPEGFilterGraph(std::string filters_descr, AVCodecContext *dec_ctx,
+                                     AVPixelFormat out_fmt)
     : buffersink_ctx_(nullptr), buffersrc_ctx_(nullptr), filter_graph_(nullptr), count_(0) {
-    Init(filters_descr, dec_ctx);
+    Init(filters_descr, dec_ctx, out_fmt);
 }
 
 FFMPEGFilterGraph::~FFMPEGFilterGraph() {
-    // avfilter_free(buffersink_ctx_);
-    // avfilter_free(buffersrc_ctx_);
-    // avfilter_graph_free(&filter_graph_);
+    // buffersrc_ctx_ and buffersink_ctx_ are owned by the graph, freed once by AVFilterGraphPtr,
+    // freeing them here as well would be a double free
 }
 
-void FFMPEGFilterGraph::Init(std::string filters_descr, AVCodecContext *dec_ctx) {
+void FFMPEGFilterGraph::Init(std::string filters_descr, AVCodecContext *dec_ctx, AVPixelFormat out_fmt) {
     char args[512];
     #if LIBAVFILTER_VERSION_INT < AV_VERSION_INT(7,14,100)
     avfilter_register_all();
@@ -36,7 +36,7 @@ void FFMPEGFilterGraph::Init(std::string filters_descr, AVCodecContext *dec_ctx)
     CHECK(buffersink) << "Error: no buffersink";
     AVFilterInOut *outputs = avfilter_inout_alloc();
 	AVFilterInOut *inputs  = avfilter_inout_alloc();
-	enum AVPixelFormat pix_fmts[] = { AV_PIX_FMT_RGB24 , AV_PIX_FMT_NONE };
+	enum AVPixelFormat pix_fmts[] = { out_fmt , AV_PIX_FMT_NONE };
 	// AVBufferSinkParams *buffersink_params;
 
 	filter_graph_.reset(avfilter_graph_alloc());
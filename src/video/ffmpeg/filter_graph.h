@@ -28,8 +28,10 @@ class FFMPEGFilterGraph {
          *
          * \param filter_desc String defining filter descriptions
          * \param dec_ctx Decoder context
+         * \param out_fmt Output pixel format of buffer sink
          */
-        FFMPEGFilterGraph(std::string filter_desc, AVCodecContext *dec_ctx);
+        FFMPEGFilterGraph(std::string filter_desc, AVCodecContext *dec_ctx,
+                          AVPixelFormat out_fmt = AV_PIX_FMT_RGB24);
         /**
          * \brief Push frame to be processed into filter graph
          *
@@ -55,8 +57,9 @@ class FFMPEGFilterGraph {
          *
          * \param filter_desc String defining filter descriptions
          * \param dec_ctx Decoder context
+         * \param out_fmt Output pixel format of buffer sink
          */
-        void Init(std::string filter_desc, AVCodecContext *dec_ctx);
+        void Init(std::string filter_desc, AVCodecContext *dec_ctx, AVPixelFormat out_fmt);
         /**
          * \brief Buffer sink context, the output side of graph
          *
@@ -11,19 +11,77 @@
 namespace decord {
 namespace ffmpeg {
 
-FFMPEGThreadedDecoder::FFMPEGThreadedDecoder() : frame_count_(0), draining_(false), run_(false), discard_pts_() {
+FFMPEGThreadedDecoder::FFMPEGThreadedDecoder() : frame_count_(0), draining_(false), run_(false),
+    passthrough_(false), graph_fmt_(AV_PIX_FMT_RGB24), tone_mapping_(false), transfer_(improc::kTransferPQ), discard_pts_(), error_count_(0) {
 }
 
-void FFMPEGThreadedDecoder::SetCodecContext(AVCodecContext *dec_ctx, int width, int height) {
+void FFMPEGThreadedDecoder::SetCodecContext(AVCodecContext *dec_ctx, int width, int height,
+                                            FrameOptions opts) {
     bool running = run_.load();
     Clear();
     dec_ctx_.reset(dec_ctx);
+    opts_ = opts;
+    CHECK(IsSupportedPixelFormat(opts_.pix_fmt)) << "Unsupported output pixel format: " << opts_.pix_fmt;
     // LOG(INFO) << dec_ctx->width << " x " << dec_ctx->height << " : " << dec_ctx->time_base.num << " , " << dec_ctx->time_base.den;
-    // std::string descr = "scale=320:240";
-    char descr[128];
-    std::snprintf(descr, sizeof(descr),
-            "scale=%d:%d", width, height);
-    filter_graph_ = FFMPEGFilterGraphPtr(new FFMPEGFilterGraph(descr, dec_ctx_.get()));
+    tone_mapping_ = false;
+    if (opts_.tone_mapping) {
+        CHECK(opts_.pix_fmt == AV_PIX_FMT_RGB24) << "Tone mapping requires RGB24 output.";
+        if (dec_ctx->color_trc == AVCOL_TRC_SMPTE2084) {
+            tone_mapping_ = true;
+            transfer_ = improc::kTransferPQ;
+        } else if (dec_ctx->color_trc == AVCOL_TRC_ARIB_STD_B67) {
+            tone_mapping_ = true;
+            transfer_ = improc::kTransferHLG;
+        }
+    }
+    // tone mapping keeps 16bit precision in filter graph and maps to 8bit afterwards
+    AVPixelFormat graph_fmt = tone_mapping_ ? AV_PIX_FMT_RGB48LE : opts_.pix_fmt;
+    // width and height are in display orientation, scale before rotation so transpose works on fewer pixels
+    bool transposed = opts_.rotation == 90 || opts_.rotation == 270;
+    int scale_width = transposed ? height : width;
+    int scale_height = transposed ? width : height;
+    std::string orientation = OrientationFilter(opts_.rotation, opts_.hflip);
+    const improc::CropRect& crop = opts_.crop;
+    if (opts_.deinterlace == kDeinterlaceBlend) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dec_ctx->pix_fmt);
+        bool planar8 = desc && (desc->flags & AV_PIX_FMT_FLAG_PLANAR) && !(desc->flags & AV_PIX_FMT_FLAG_RGB)
+            && desc->comp[0].depth == 8;
+        if (!planar8) {
+            LOG(WARNING) << "Linear blend deinterlacing requires 8bit planar YUV, use single field instead.";
+            opts_.deinterlace = kDeinterlaceField;
+        }
+    }
+    passthrough_ = graph_fmt == dec_ctx->pix_fmt && orientation.empty() && crop.Empty()
+        && opts_.deinterlace == kDeinterlaceNone
+        && width == dec_ctx->width && height == dec_ctx->height;
+    filter_graph_.reset();
+    field_graph_.reset();
+    filter_descr_.clear();
+    field_descr_.clear();
+    graph_fmt_ = graph_fmt;
+    if (!passthrough_) {
+        auto filters = [&](bool single_field) {
+            // std::string descr = "scale=320:240";
+            char descr[128];
+            std::string ret;
+            if (!crop.Empty()) {
+                // crop ahead of scaling, borders are never converted
+                std::snprintf(descr, sizeof(descr),
+                        "crop=%d:%d:%d:%d,", crop.width, crop.height, crop.x, crop.y);
+                ret += descr;
+            }
+            // field filter only changes line size, scaling then works on half the lines
+            if (single_field) ret += "field=type=top,";
+            std::snprintf(descr, sizeof(descr),
+                    "scale=%d:%d", scale_width, scale_height);
+            ret += descr;
+            if (!orientation.empty()) ret += "," + orientation;
+            return ret;
+        };
+        // graphs are built by the worker on first frame, field graph only if an interlaced frame shows up
+        filter_descr_ = filters(false);
+        if (opts_.deinterlace == kDeinterlaceField) field_descr_ = filters(true);
+    }
     if (running) {
         Start();
     }
@@ -31,6 +89,15 @@ void FFMPEGThreadedDecoder::SetCodecContext(AVCodecContext *dec_ctx, int width,
 
 void FFMPEGThreadedDecoder::Start() {
     if (!run_.load()) {
+        if (dec_ctx_ && !avcodec_is_open(dec_ctx_.get())) {
+            // opened on first use, frame threads and buffers of idle readers are never allocated
+            int open_ret = avcodec_open2(dec_ctx_.get(), dec_ctx_->codec, NULL);
+            if (open_ret < 0) {
+                char errstr[200];
+                av_strerror(open_ret, errstr, 200);
+                LOG(FATAL) << "ERROR open codec through avcodec_open2: " << errstr;
+            }
+        }
         pkt_queue_.reset(new PacketQueue());
         frame_queue_.reset(new FrameQueue());
         buffer_queue_.reset(new BufferQueue());
@@ -61,11 +128,13 @@ void FFMPEGThreadedDecoder::Stop() {
 
 void FFMPEGThreadedDecoder::Clear() {
     Stop();
-    if (dec_ctx_.get()) {
+    if (dec_ctx_.get() && avcodec_is_open(dec_ctx_.get())) {
         avcodec_flush_buffers(dec_ctx_.get());
     }
     frame_count_.store(0);
     draining_.store(false);
+    last_frame_ = NDArray();
+    last_hdr_frame_ = nullptr;
     {
       std::lock_guard<std::mutex> lock(pts_mutex_);
       discard_pts_.clear();
@@ -122,28 +191,50 @@ void FFMPEGThreadedDecoder::ProcessFrame(AVFramePtr frame, NDArray out_buf) {
         ++frame_count_;
         return;
     }
-    // filter image frame (format conversion, scaling...)
-    filter_graph_->Push(frame.get());
-    AVFramePtr out_frame = AVFramePool::Get()->Acquire();
-    AVFrame *out_frame_p = out_frame.get();
-    CHECK(filter_graph_->Pop(&out_frame_p)) << "Error fetch filtered frame.";
-
-    auto tmp = AsNDArray(out_frame);
+    NDArray tmp;
+    if (passthrough_) {
+        // decoded frame is reused by decoder, always copy
+        CHECK_EQ(frame->format, opts_.pix_fmt) << "Decoder output format changed, cannot pass through.";
+        tmp = CopyToNDArray(frame);
+    } else {
+        bool field = frame->interlaced_frame && opts_.deinterlace == kDeinterlaceField;
+        if (frame->interlaced_frame && opts_.deinterlace == kDeinterlaceBlend) {
+            frame = BlendFields(frame);
+        }
+        FFMPEGFilterGraphPtr& filter_graph = field ? field_graph_ : filter_graph_;
+        if (!filter_graph) {
+            filter_graph = FFMPEGFilterGraphPtr(new FFMPEGFilterGraph(
+                field ? field_descr_ : filter_descr_, dec_ctx_.get(), graph_fmt_));
+        }
+        // filter image frame (format conversion, scaling...)
+        filter_graph->Push(frame.get());
+        AVFramePtr out_frame = AVFramePool::Get()->Acquire();
+        AVFrame *out_frame_p = out_frame.get();
+        CHECK(filter_graph->Pop(&out_frame_p)) << "Error fetch filtered frame.";
+        if (tone_mapping_) {
+            last_hdr_frame_ = out_frame;
+            frame_queue_->Push(ToneMap(out_frame, out_buf));
+            ++frame_count_;
+            return;
+        }
+        tmp = AsNDArray(out_frame);
+    }
+    // holds the filtered AVFrame or decoder copy, no extra copy for concealment
+    last_frame_ = tmp;
     if (out_buf.defined()) {
         CHECK(out_buf.Size() == tmp.Size());
         out_buf.CopyFrom(tmp);
         frame_queue_->Push(out_buf);
-        ++frame_count_;
     } else {
         frame_queue_->Push(tmp);
-        ++frame_count_;
     }
+    ++frame_count_;
 }
 
 void FFMPEGThreadedDecoder::WorkerThread() {
     while (run_.load()) {
         // CHECK(filter_graph_) << "FilterGraph not initialized.";
-        if (!filter_graph_) return;
+        if (!dec_ctx_) return;
         AVPacketPtr pkt;
 
         int got_picture;
@@ -175,7 +266,12 @@ void FFMPEGThreadedDecoder::WorkerThread() {
             }
         } else {
             // normal mode, push in valid packets and retrieve frames
-            CHECK_GE(avcodec_send_packet(dec_ctx_.get(), pkt.get()), 0) << "Thread worker: Error sending packet.";
+            int send_ret = avcodec_send_packet(dec_ctx_.get(), pkt.get());
+            if (send_ret < 0 && send_ret != AVERROR(EAGAIN)) {
+                // corrupt packet, keep going instead of failing the whole video
+                if (!ConcealFrame()) return;
+                continue;
+            }
             got_picture = avcodec_receive_frame(dec_ctx_.get(), frame.get());
             if (got_picture == 0) {
                 NDArray out_buf;
@@ -186,7 +282,7 @@ void FFMPEGThreadedDecoder::WorkerThread() {
                 frame_queue_->Push(NDArray());
                 ++frame_count_;
             } else {
-                LOG(FATAL) << "Thread worker: Error decoding frame: " << got_picture;
+                if (!ConcealFrame()) return;
             }
         }
         // free raw memories allocated with ffmpeg
@@ -194,13 +290,36 @@ void FFMPEGThreadedDecoder::WorkerThread() {
     }
 }
 
+bool FFMPEGThreadedDecoder::ConcealFrame() {
+    ++error_count_;
+    if (!last_frame_.defined() && !last_hdr_frame_) {
+        // nothing decoded yet, same as a packet without picture
+        frame_queue_->Push(NDArray());
+        ++frame_count_;
+        return true;
+    }
+    // repeat previous frame so that frame positions stay aligned with packets
+    NDArray out_buf;
+    if (!buffer_queue_->Pop(&out_buf)) return false;
+    if (last_hdr_frame_) {
+        frame_queue_->Push(ToneMap(last_hdr_frame_, out_buf));
+    } else if (out_buf.defined()) {
+        out_buf.CopyFrom(last_frame_);
+        frame_queue_->Push(out_buf);
+    } else {
+        // the caller owns what it receives
+        frame_queue_->Push(last_frame_.CopyTo(last_frame_->ctx));
+    }
+    ++frame_count_;
+    return true;
+}
+
 NDArray FFMPEGThreadedDecoder::CopyToNDArray(AVFramePtr p) {
     CHECK(p) << "Error: converting empty AVFrame to DLTensor";
-    // int channel = p->linesize[0] / p->width;
-    CHECK(AVPixelFormat(p->format) == AV_PIX_FMT_RGB24 || AVPixelFormat(p->format) == AV_PIX_FMT_GRAY8)
-        << "Only support RGB24/GRAY8 image to NDArray conversion, given: "
-        << AVPixelFormat(p->format);
-    int channel = AVPixelFormat(p->format) == AV_PIX_FMT_RGB24 ? 3 : 1;
+    AVPixelFormat fmt = AVPixelFormat(p->format);
+    CHECK(IsSupportedPixelFormat(fmt))
+        << "Only support RGB24/RGB48/GRAY8/P010/YUV420P10 image to NDArray conversion, given: "
+        << fmt;
     // CHECK(p->linesize[0] % p->width == 0)
     //     << "AVFrame data is not a compact array. linesize: " << p->linesize[0]
     //     << " width: " << p->width;
@@ -208,20 +327,69 @@ NDArray FFMPEGThreadedDecoder::CopyToNDArray(AVFramePtr p) {
     DLContext ctx;
     CHECK(!p->hw_frames_ctx) << "Not supported hw_frames_ctx";
     ctx = kCPU;
-    NDArray arr = NDArray::Empty({p->height, p->width, channel}, kUInt8, ctx);
+    auto shape = FrameShape(fmt, p->height, p->width);
+    DLDataType dtype = FrameDType(fmt);
+    NDArray arr = NDArray::Empty(shape, dtype, ctx);
     auto device_api = runtime::DeviceAPI::Get(ctx);
     void *to_ptr = arr.data_->dl_tensor.data;
-    void *from_ptr = p->data[0];
-    int linesize = p->width * channel;
+    int bytes = dtype.bits / 8;
 
-    // arr.CopyFrom(&dlt);
-    for (int i = 0; i < p->height; ++i) {
-        // copy line by line
-        device_api->CopyDataFromTo(
-            from_ptr, i * p->linesize[0],
-            to_ptr, i * linesize,
-            linesize, ctx, ctx, kUInt8, nullptr);
+    // (plane, rows, bytes per row) in output order, planes are stacked compactly
+    std::vector<std::vector<int> > planes;
+    if (IsPackedPixelFormat(fmt)) {
+        planes.push_back({0, p->height, p->width * static_cast<int>(shape[2]) * bytes});
+    } else if (fmt == AV_PIX_FMT_P010LE) {
+        planes.push_back({0, p->height, p->width * bytes});
+        planes.push_back({1, p->height / 2, p->width * bytes});
+    } else {
+        planes.push_back({0, p->height, p->width * bytes});
+        planes.push_back({1, p->height / 2, p->width / 2 * bytes});
+        planes.push_back({2, p->height / 2, p->width / 2 * bytes});
     }
+    size_t to_offset = 0;
+    for (auto& plane : planes) {
+        void *from_ptr = p->data[plane[0]];
+        int linesize = plane[2];
+        for (int i = 0; i < plane[1]; ++i) {
+            // copy line by line
+            device_api->CopyDataFromTo(
+                from_ptr, i * p->linesize[plane[0]],
+                to_ptr, to_offset,
+                linesize, ctx, ctx, kUInt8, nullptr);
+            to_offset += linesize;
+        }
+    }
+    return arr;
+}
+
+AVFramePtr FFMPEGThreadedDecoder::BlendFields(AVFramePtr p) {
+    AVPixelFormat fmt = AVPixelFormat(p->format);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    CHECK(desc) << "Unknown pixel format: " << fmt;
+    AVFramePtr out = AVFramePool::Get()->Acquire();
+    out->format = p->format;
+    out->width = p->width;
+    out->height = p->height;
+    CHECK_GE(av_frame_get_buffer(out.get(), kCPUAlignment), 0) << "Error allocating deinterlacing buffer.";
+    CHECK_GE(av_frame_copy_props(out.get(), p.get()), 0) << "Error copying frame properties.";
+    int nb_planes = av_pix_fmt_count_planes(fmt);
+    for (int i = 0; i < nb_planes; ++i) {
+        bool chroma = i == 1 || i == 2;
+        int h = chroma ? AV_CEIL_RSHIFT(p->height, desc->log2_chroma_h) : p->height;
+        improc::LinearBlendPlane(p->data[i], p->linesize[i], out->data[i], out->linesize[i],
+                                 av_image_get_linesize(fmt, p->width, i), h);
+    }
+    out->interlaced_frame = 0;
+    return out;
+}
+
+NDArray FFMPEGThreadedDecoder::ToneMap(AVFramePtr p, NDArray out_buf) {
+    CHECK_EQ(p->format, AV_PIX_FMT_RGB48LE) << "Tone mapping expects RGB48 frames.";
+    NDArray arr = out_buf.defined() ? out_buf : NDArray::Empty({p->height, p->width, 3}, kUInt8, kCPU);
+    CHECK_EQ(arr.Size(), static_cast<int64_t>(p->height) * p->width * 3);
+    uint8_t *dst = static_cast<uint8_t*>(arr.data_->dl_tensor.data) + arr.data_->dl_tensor.byte_offset;
+    improc::ToneMapRGB48ToRGB24(reinterpret_cast<const uint16_t*>(p->data[0]), p->linesize[0],
+                                dst, p->width * 3, p->width, p->height, transfer_);
     return arr;
 }
 
@@ -231,7 +399,9 @@ static void AVFrameManagerDeleter(DLManagedTensor *manager) {
 }
 
 NDArray FFMPEGThreadedDecoder::AsNDArray(AVFramePtr p) {
-    if (p->linesize[0] % p->width != 0) {
+    AVPixelFormat fmt = AVPixelFormat(p->format);
+    if (!IsPackedPixelFormat(fmt) ||
+        p->linesize[0] != p->width * FrameShape(fmt, p->height, p->width)[2] * (FrameDType(fmt).bits / 8)) {
         // Fallback to copy since original AVFrame is not compact
         return CopyToNDArray(p);
     }
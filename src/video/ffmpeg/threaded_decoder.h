@@ -9,6 +9,8 @@
 
 #include "filter_graph.h"
 #include "../threaded_decoder_interface.h"
+#include "../../improc/tone_mapping.h"
+#include "../../improc/deinterlace.h"
 #include <decord/runtime/ndarray.h>
 
 #include <thread>
@@ -20,6 +22,12 @@
 namespace decord {
 namespace ffmpeg {
 
+/**
+ * \brief FFmpeg decoder running on a worker thread.
+ *
+ * Codec is opened and queues and worker thread are created on Start, filter graphs on first frame, so
+ * readers that are opened but never decoded stay small.
+ */
 class FFMPEGThreadedDecoder : public ThreadedDecoderInterface {
     using PacketQueue = dmlc::ConcurrentBlockingQueue<AVPacketPtr>;
     using PacketQueuePtr = std::unique_ptr<PacketQueue>;
@@ -31,7 +39,8 @@ class FFMPEGThreadedDecoder : public ThreadedDecoderInterface {
 
     public:
         FFMPEGThreadedDecoder();
-        void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1);
+        void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1,
+                             FrameOptions opts = FrameOptions());
         void Start();
         void Stop();
         void Clear();
@@ -40,12 +49,17 @@ class FFMPEGThreadedDecoder : public ThreadedDecoderInterface {
         // bool Pop(AVFramePtr *frame) {LOG(FATAL); return false; };
         bool Pop(runtime::NDArray *frame);
         void SuggestDiscardPTS(std::vector<int64_t> dts);
+        int64_t GetErrorCount() const { return error_count_.load(); }
         ~FFMPEGThreadedDecoder();
     private:
         void WorkerThread();
+        /*! \brief stand in for a frame lost to a decoding error, false if decoder is stopping */
+        bool ConcealFrame();
         void ProcessFrame(AVFramePtr p, NDArray out_buf);
         NDArray CopyToNDArray(AVFramePtr p);
         NDArray AsNDArray(AVFramePtr p);
+        NDArray ToneMap(AVFramePtr p, NDArray out_buf);
+        AVFramePtr BlendFields(AVFramePtr p);
         // void FetcherThread(std::condition_variable& cv, FrameQueuePtr frame_queue);
         PacketQueuePtr pkt_queue_;
         FrameQueuePtr frame_queue_;
@@ -57,9 +71,33 @@ class FFMPEGThreadedDecoder : public ThreadedDecoderInterface {
         // std::condition_variable cv_;
         std::atomic<bool> run_;
         FFMPEGFilterGraphPtr filter_graph_;
+        /*! \brief filter graph for interlaced frames in single field mode */
+        FFMPEGFilterGraphPtr field_graph_;
         AVCodecContextPtr dec_ctx_;
+        /*! \brief output conversion options */
+        FrameOptions opts_;
+        /*! \brief decoded frames already match output format and size, skip filter graph */
+        bool passthrough_;
+        /*! \brief descriptions of filter_graph_ and field_graph_, built lazily by worker */
+        std::string filter_descr_;
+        std::string field_descr_;
+        /*! \brief output pixel format of filter graphs */
+        AVPixelFormat graph_fmt_;
+        /*! \brief whether HDR source is tone mapped after filter graph */
+        bool tone_mapping_;
+        improc::HDRTransfer transfer_;
         std::unordered_set<int64_t> discard_pts_;
         std::mutex pts_mutex_;
+        /*! \brief packets that failed to decode, not reset by Clear */
+        std::atomic<int64_t> error_count_;
+        /**
+         * \brief last good frame, repeated in place of corrupt frames
+         *
+         * Owned by the decoder, never the caller's buffer it was copied to, which may be overwritten
+         * by then. With tone mapping, the RGB48 frame before mapping is kept in last_hdr_frame_ instead.
+         */
+        NDArray last_frame_;
+        AVFramePtr last_hdr_frame_;
 
     DISALLOW_COPY_AND_ASSIGN(FFMPEGThreadedDecoder);
 };
@@ -0,0 +1,294 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file image_sequence_reader.cc
+ * \brief Image sequence reader Impl
+ */
+
+#include "image_sequence_reader.h"
+#include "../runtime/parallel_util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <glob.h>
+#endif
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+using AVFramePtr = ffmpeg::AVFramePtr;
+using AVPacketPtr = ffmpeg::AVPacketPtr;
+using AVFramePool = ffmpeg::AVFramePool;
+using AVPacketPool = ffmpeg::AVPacketPool;
+
+namespace {
+
+/*! \brief image decoder by file extension, AV_CODEC_ID_NONE if not a supported image */
+AVCodecID ImageCodecID(const std::string& fn) {
+    std::size_t pos = fn.rfind('.');
+    if (pos == std::string::npos) return AV_CODEC_ID_NONE;
+    std::string ext = fn.substr(pos + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == "jpg" || ext == "jpeg") return AV_CODEC_ID_MJPEG;
+    if (ext == "png") return AV_CODEC_ID_PNG;
+    if (ext == "bmp") return AV_CODEC_ID_BMP;
+    if (ext == "tif" || ext == "tiff") return AV_CODEC_ID_TIFF;
+    if (ext == "webp") return AV_CODEC_ID_WEBP;
+    return AV_CODEC_ID_NONE;
+}
+
+/*! \brief natural order, runs of digits are compared by value */
+bool NaturalLess(const std::string& a, const std::string& b) {
+    std::size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (std::isdigit(static_cast<unsigned char>(a[i])) && std::isdigit(static_cast<unsigned char>(b[j]))) {
+            std::size_t ie = i, je = j;
+            while (ie < a.size() && std::isdigit(static_cast<unsigned char>(a[ie]))) ++ie;
+            while (je < b.size() && std::isdigit(static_cast<unsigned char>(b[je]))) ++je;
+            // ignore leading zeros
+            while (i + 1 < ie && a[i] == '0') ++i;
+            while (j + 1 < je && b[j] == '0') ++j;
+            if (ie - i != je - j) return ie - i < je - j;
+            int cmp = a.compare(i, ie - i, b, j, je - j);
+            if (cmp != 0) return cmp < 0;
+            i = ie;
+            j = je;
+        } else {
+            if (a[i] != b[j]) return a[i] < b[j];
+            ++i;
+            ++j;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+bool IsDirectory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+bool IsRegularFile(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+std::vector<std::string> ListImages(const std::string& pattern) {
+    std::vector<std::string> files;
+#if defined(_WIN32)
+    LOG(FATAL) << "Image sequence is not supported on Windows.";
+#else
+    std::string glob_pattern = IsDirectory(pattern) ? pattern + "/*" : pattern;
+    glob_t result;
+    if (glob(glob_pattern.c_str(), 0, NULL, &result) == 0) {
+        for (std::size_t i = 0; i < result.gl_pathc; ++i) {
+            std::string fn = result.gl_pathv[i];
+            if (ImageCodecID(fn) != AV_CODEC_ID_NONE) files.emplace_back(fn);
+        }
+    }
+    globfree(&result);
+    std::sort(files.begin(), files.end(), NaturalLess);
+#endif
+    return files;
+}
+
+/*! \brief read and decode a single image file */
+AVFramePtr DecodeFile(const std::string& fn) {
+    std::ifstream fin(fn, std::ios::binary | std::ios::ate);
+    CHECK(fin.good()) << "Error opening image: " << fn;
+    int64_t size = fin.tellg();
+    fin.seekg(0, std::ios::beg);
+    AVPacketPtr pkt = AVPacketPool::Get()->Acquire();
+    CHECK_GE(av_new_packet(pkt.get(), static_cast<int>(size)), 0) << "Error allocating packet for: " << fn;
+    CHECK(fin.read(reinterpret_cast<char*>(pkt->data), size)) << "Error reading image: " << fn;
+
+    AVCodec *codec = avcodec_find_decoder(ImageCodecID(fn));
+    CHECK(codec) << "No decoder available for image: " << fn;
+    ffmpeg::AVCodecContextPtr dec_ctx(avcodec_alloc_context3(codec));
+    // parallelism is across images
+    dec_ctx->thread_count = 1;
+    CHECK_GE(avcodec_open2(dec_ctx.get(), codec, NULL), 0) << "ERROR open codec for image: " << fn;
+    AVFramePtr frame = AVFramePool::Get()->Acquire();
+    CHECK_GE(avcodec_send_packet(dec_ctx.get(), pkt.get()), 0) << "Error sending image: " << fn;
+    int ret = avcodec_receive_frame(dec_ctx.get(), frame.get());
+    if (ret == AVERROR(EAGAIN)) {
+        // flush decoders holding the picture until end of stream
+        avcodec_send_packet(dec_ctx.get(), NULL);
+        ret = avcodec_receive_frame(dec_ctx.get(), frame.get());
+    }
+    CHECK_GE(ret, 0) << "Error decoding image: " << fn;
+    return frame;
+}
+
+}  // namespace
+
+ImageSequenceReader::ImageSequenceReader(std::string pattern, DLContext ctx, int width, int height,
+                                         FrameOptions opts, double fps)
+    : ctx_(ctx), files_(ListImages(pattern)), curr_frame_(0),
+    width_(width), height_(height), pix_fmt_(opts.pix_fmt), fps_(fps) {
+    CHECK(ctx_.device_type == kDLCPU)
+        << "ImageSequenceReader only supports CPU context, given: " << ctx_.device_type;
+    CHECK(ffmpeg::IsSupportedPixelFormat(pix_fmt_)) << "Unsupported output pixel format: " << pix_fmt_;
+    CHECK_GT(fps_, 0) << "Invalid fps: " << fps_;
+    CHECK_GT(files_.size(), 0) << "No image found in " << pattern;
+    if (width_ < 1 || height_ < 1) {
+        // output size follows first image
+        AVFramePtr frame = DecodeFile(files_[0]);
+        if (width_ < 1) width_ = frame->width;
+        if (height_ < 1) height_ = frame->height;
+    }
+}
+
+ImageSequenceReader::~ImageSequenceReader() {
+}
+
+bool ImageSequenceReader::IsImageSequence(const std::string& uri) {
+    // e.g. clip[1].mp4 is a video, not a pattern
+    if (IsRegularFile(uri)) return false;
+    if (uri.find_first_of("*?[") != std::string::npos) return true;
+    return IsDirectory(uri);
+}
+
+void ImageSequenceReader::SetVideoStream(int stream_nb) {
+    CHECK_LE(stream_nb, 0) << "Image sequence has only one stream, given: " << stream_nb;
+}
+
+unsigned int ImageSequenceReader::QueryStreams() const {
+    LOG(INFO) << "image sequence [0]: " << files_.size() << " images, first: " << files_.front()
+        << " Resolution: " << width_ << "x" << height_;
+    return 1;
+}
+
+int64_t ImageSequenceReader::GetFrameCount() const {
+    return static_cast<int64_t>(files_.size());
+}
+
+int64_t ImageSequenceReader::GetCurrentPosition() const {
+    return curr_frame_;
+}
+
+void ImageSequenceReader::DecodeImage(int64_t idx, uint8_t *dst) {
+    AVFramePtr frame = DecodeFile(files_[idx]);
+    AVFramePtr out_frame = frame;
+    if (frame->format != pix_fmt_ || frame->width != width_ || frame->height != height_) {
+        GraphPtr filter_graph = AcquireGraph(frame.get());
+        filter_graph->Push(frame.get());
+        out_frame = AVFramePool::Get()->Acquire();
+        AVFrame *out_frame_p = out_frame.get();
+        CHECK(filter_graph->Pop(&out_frame_p)) << "Error fetch filtered frame.";
+        ReleaseGraph(frame.get(), std::move(filter_graph));
+    }
+    int size = av_image_get_buffer_size(pix_fmt_, width_, height_, 1);
+    CHECK_GE(av_image_copy_to_buffer(dst, size, out_frame->data, out_frame->linesize,
+                                     pix_fmt_, width_, height_, 1), 0)
+        << "Error copying image: " << files_[idx];
+}
+
+ImageSequenceReader::GraphPtr ImageSequenceReader::AcquireGraph(const AVFrame *frame) {
+    GraphKey key(frame->format, frame->width, frame->height);
+    {
+        std::lock_guard<std::mutex> lock(graph_mutex_);
+        auto& idle = graphs_[key];
+        if (!idle.empty()) {
+            GraphPtr graph = std::move(idle.back());
+            idle.pop_back();
+            return graph;
+        }
+    }
+    // images may differ in size and format, graphs are reused for images of the same kind
+    ffmpeg::AVCodecContextPtr par(avcodec_alloc_context3(NULL));
+    par->width = frame->width;
+    par->height = frame->height;
+    par->pix_fmt = AVPixelFormat(frame->format);
+    par->time_base = {1, AV_TIME_BASE};
+    par->sample_aspect_ratio = frame->sample_aspect_ratio;
+    char descr[128];
+    std::snprintf(descr, sizeof(descr), "scale=%d:%d", width_, height_);
+    return GraphPtr(new ffmpeg::FFMPEGFilterGraph(descr, par.get(), pix_fmt_));
+}
+
+void ImageSequenceReader::ReleaseGraph(const AVFrame *frame, GraphPtr graph) {
+    std::lock_guard<std::mutex> lock(graph_mutex_);
+    graphs_[GraphKey(frame->format, frame->width, frame->height)].emplace_back(std::move(graph));
+}
+
+NDArray ImageSequenceReader::NextFrame() {
+    if (curr_frame_ >= GetFrameCount()) {
+        return NDArray::Empty({}, kUInt8, ctx_);
+    }
+    NDArray batch = GetBatch({curr_frame_}, NDArray());
+    return batch.CreateView(ffmpeg::FrameShape(pix_fmt_, height_, width_), ffmpeg::FrameDType(pix_fmt_));
+}
+
+NDArray ImageSequenceReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    std::vector<int64_t> frame_shape = ffmpeg::FrameShape(pix_fmt_, height_, width_);
+    DLDataType dtype = ffmpeg::FrameDType(pix_fmt_);
+    int64_t frame_elems = 1;
+    for (auto s : frame_shape) frame_elems *= s;
+    const int64_t frame_bytes = frame_elems * (dtype.bits / 8);
+    if (!buf.defined()) {
+        std::vector<int64_t> buf_shape = {bs};
+        buf_shape.insert(buf_shape.end(), frame_shape.begin(), frame_shape.end());
+        buf = NDArray::Empty(buf_shape, dtype, ctx_);
+    }
+    CHECK_EQ(buf.Size(), bs * frame_elems) << "Invalid output buffer size";
+    const int64_t frame_count = GetFrameCount();
+    // duplicated indices are decoded once
+    std::unordered_map<int64_t, int64_t> first_slot;
+    std::vector<int64_t> unique_slots;
+    for (int64_t i = 0; i < bs; ++i) {
+        CHECK_LT(indices[i], frame_count);
+        CHECK_GE(indices[i], 0);
+        if (first_slot.emplace(indices[i], i).second) unique_slots.emplace_back(i);
+    }
+    uint8_t *base = static_cast<uint8_t*>(buf->data) + buf->byte_offset;
+    runtime::ParallelFor(static_cast<int64_t>(unique_slots.size()), [&](int64_t i) {
+        int64_t slot = unique_slots[i];
+        DecodeImage(indices[slot], base + slot * frame_bytes);
+    });
+    for (int64_t i = 0; i < bs; ++i) {
+        int64_t slot = first_slot[indices[i]];
+        if (slot != i) std::memcpy(base + i * frame_bytes, base + slot * frame_bytes, frame_bytes);
+    }
+    if (bs > 0) curr_frame_ = indices.back() + 1;
+    return buf;
+}
+
+void ImageSequenceReader::SkipFrames(int64_t num) {
+    curr_frame_ = std::min(curr_frame_ + std::max(num, static_cast<int64_t>(0)), GetFrameCount());
+}
+
+bool ImageSequenceReader::Seek(int64_t pos) {
+    // every image is a keyframe
+    return SeekAccurate(pos);
+}
+
+bool ImageSequenceReader::SeekAccurate(int64_t pos) {
+    if (pos < 0 || pos >= GetFrameCount()) {
+        LOG(WARNING) << "Failed to seek image sequence to position: " << pos;
+        return false;
+    }
+    curr_frame_ = pos;
+    return true;
+}
+
+NDArray ImageSequenceReader::GetKeyIndices() {
+    std::vector<int64_t> keys(files_.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) keys[i] = static_cast<int64_t>(i);
+    std::vector<int64_t> shape = {static_cast<int64_t>(keys.size())};
+    NDArray ret = NDArray::Empty(shape, kInt64, kCPU);
+    ret.CopyFrom(keys, shape);
+    return ret;
+}
+
+double ImageSequenceReader::GetAverageFPS() const {
+    return fps_;
+}
+
+}  // namespace decord
@@ -0,0 +1,84 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file image_sequence_reader.h
+ * \brief Reader presenting a sequence of image files as video, implements VideoReaderInterface
+ */
+
+#ifndef DECORD_VIDEO_IMAGE_SEQUENCE_READER_H_
+#define DECORD_VIDEO_IMAGE_SEQUENCE_READER_H_
+
+#include "threaded_decoder_interface.h"
+#include "ffmpeg/filter_graph.h"
+#include <decord/video_interface.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/**
+ * \brief ImageSequenceReader reads a directory or glob of JPEG/PNG/BMP/TIFF/WebP images as frames.
+ *
+ * Files are ordered by natural sort order of path, e.g. img_2.jpg before img_10.jpg.
+ * Every frame is a keyframe, `GetBatch` decodes images independently on the runtime thread pool
+ * with libavcodec image decoders and the same scaling/format conversion as `VideoReader`.
+ */
+class ImageSequenceReader : public VideoReaderInterface {
+    using NDArray = runtime::NDArray;
+    public:
+        /**
+         * \brief Construct a new ImageSequenceReader object
+         *
+         * \param pattern Directory of images, or glob pattern of image files
+         * \param ctx Decoding context, only CPU is supported
+         * \param width Output width, -1 to follow the first image
+         * \param height Output height, -1 to follow the first image
+         * \param opts Output format, only pix_fmt is used
+         * \param fps Nominal frame rate reported for the sequence
+         */
+        ImageSequenceReader(std::string pattern, DLContext ctx, int width=-1, int height=-1,
+                            FrameOptions opts=FrameOptions(), double fps=25.);
+        ~ImageSequenceReader();
+        void SetVideoStream(int stream_nb = -1);
+        unsigned int QueryStreams() const;
+        int64_t GetFrameCount() const;
+        int64_t GetCurrentPosition() const;
+        NDArray NextFrame();
+        NDArray GetBatch(std::vector<int64_t> indices, NDArray buf);
+        void SkipFrames(int64_t num = 1);
+        bool Seek(int64_t pos);
+        bool SeekAccurate(int64_t pos);
+        NDArray GetKeyIndices();
+        double GetAverageFPS() const;
+        /*! \brief whether uri refers to an image sequence, i.e. a directory or glob pattern, existing files are not */
+        static bool IsImageSequence(const std::string& uri);
+
+    private:
+        /*! \brief source format, width and height of a filter graph */
+        using GraphKey = std::tuple<int, int, int>;
+        using GraphPtr = std::unique_ptr<ffmpeg::FFMPEGFilterGraph>;
+        /*! \brief decode image at idx and convert into compact frame at dst */
+        void DecodeImage(int64_t idx, uint8_t *dst);
+        /*! \brief idle graph converting frames like frame to output, built if none is left */
+        GraphPtr AcquireGraph(const AVFrame *frame);
+        void ReleaseGraph(const AVFrame *frame, GraphPtr graph);
+
+        DLContext ctx_;
+        std::vector<std::string> files_;
+        int64_t curr_frame_;
+        int width_;
+        int height_;
+        AVPixelFormat pix_fmt_;
+        double fps_;
+        /*! \brief idle filter graphs by source, one per image decoded at the same time */
+        std::map<GraphKey, std::vector<GraphPtr> > graphs_;
+        std::mutex graph_mutex_;
+};  // class ImageSequenceReader
+}  // namespace decord
+#endif  // DECORD_VIDEO_IMAGE_SEQUENCE_READER_H_
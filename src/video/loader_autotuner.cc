@@ -0,0 +1,207 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file loader_autotuner.cc
+ * \brief Online hill climbing of VideoLoader knobs
+ */
+
+#include "loader_autotuner.h"
+#include "../runtime/file_util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace decord {
+
+/*! \brief timed batches of each candidate, plus one warmup batch */
+static const int64_t kTuneWindow = 16;
+/*! \brief relative throughput gain required to move */
+static const double kTuneMinGain = 1.05;
+/*! \brief values tried for each knob, ascending cost, 0 decoder threads (auto) is the top rung */
+static const std::vector<int> kThreadLadder = {1, 2, 4, 8, 0};
+static const std::vector<int> kPrefetchLadder = {0, 1, 2, 4, 8};
+static const int kNumKnobs = 2;
+
+static const std::vector<int>& Ladder(int knob) {
+    return knob == 0 ? kThreadLadder : kPrefetchLadder;
+}
+
+static int& Knob(LoaderConfig* config, int knob) {
+    return knob == 0 ? config->decoder_threads : config->prefetch;
+}
+
+/*! \brief FNV-1a, stable across runs and platforms unlike std::hash */
+static uint64_t HashManifest(const std::string& manifest) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : manifest) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+LoaderAutotuner::LoaderAutotuner(const std::string& manifest, LoaderConfig initial, int64_t batch_bytes,
+                                 int64_t frame_bytes, int64_t num_videos, int64_t memory_cap, int64_t max_batches)
+    : batch_bytes_(batch_bytes), frame_bytes_(frame_bytes), num_videos_(num_videos),
+      memory_cap_(memory_cap), max_batches_(max_batches), batches_(0), done_(false),
+      trial_(initial), best_(initial), best_rate_(0), knob_(0), dir_(1), improved_(false),
+      window_(0), decoded_(0), returned_(0) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/autotune-%016llx.txt",
+                  static_cast<unsigned long long>(HashManifest(manifest)));
+    path_ = runtime::GetCacheDir() + name;
+}
+
+bool LoaderAutotuner::Load(LoaderConfig* config) {
+    std::ifstream fin(path_);
+    if (!fin) return false;
+    LoaderConfig loaded;
+    int found = 0;
+    std::string key;
+    int value;
+    while (fin >> key >> value) {
+        if (key == "decoder_threads") {
+            loaded.decoder_threads = value;
+            found |= 1;
+        } else if (key == "prefetch") {
+            loaded.prefetch = value;
+            found |= 2;
+        }
+    }
+    if (found != 3) return false;
+    if (memory_cap_ > 0 && EstimateMemory(loaded) > memory_cap_) {
+        LOG(INFO) << "VideoLoader autotune: saved configuration exceeds memory cap, tuning again";
+        return false;
+    }
+    LOG(INFO) << "VideoLoader autotune: reusing decoder_threads=" << loaded.decoder_threads
+              << " prefetch=" << loaded.prefetch << " from " << path_;
+    *config = loaded;
+    trial_ = best_ = loaded;
+    done_ = true;
+    return true;
+}
+
+int64_t LoaderAutotuner::EstimateMemory(const LoaderConfig& config) const {
+    int64_t threads = config.decoder_threads > 0 ? config.decoder_threads
+        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    // queued batches, the one being decoded and the one held by consumer
+    int64_t batches = config.prefetch > 0 ? config.prefetch + 2 : 1;
+    // frame threading keeps about one frame in flight per thread
+    return batch_bytes_ * batches + frame_bytes_ * (threads + 1) * num_videos_;
+}
+
+bool LoaderAutotuner::Step(const LoaderConfig& from, int knob, int dir, LoaderConfig* to) const {
+    const std::vector<int>& ladder = Ladder(knob);
+    LoaderConfig config = from;
+    int value = Knob(&config, knob);
+    auto it = std::find(ladder.begin(), ladder.end(), value);
+    int pos;
+    if (it != ladder.end()) {
+        pos = static_cast<int>(it - ladder.begin()) + dir;
+    } else {
+        // off ladder values move to the closest rung in given direction
+        it = std::find_if(ladder.begin(), ladder.end(), [value](int v) { return v == 0 || v > value; });
+        pos = static_cast<int>(it - ladder.begin()) - (dir > 0 ? 0 : 1);
+    }
+    if (pos < 0 || pos >= static_cast<int>(ladder.size())) return false;
+    Knob(&config, knob) = ladder[pos];
+    if (memory_cap_ > 0 && EstimateMemory(config) > memory_cap_) return false;
+    *to = config;
+    return true;
+}
+
+bool LoaderAutotuner::NextCandidate(LoaderConfig* next) {
+    while (knob_ < kNumKnobs) {
+        if (Step(best_, knob_, dir_, next)) return true;
+        AdvanceMove();
+    }
+    return false;
+}
+
+void LoaderAutotuner::AdvanceMove() {
+    // going down is pointless once going up improved
+    if (dir_ > 0 && !improved_) {
+        dir_ = -1;
+    } else {
+        ++knob_;
+        dir_ = 1;
+        improved_ = false;
+    }
+}
+
+bool LoaderAutotuner::Record(int64_t decoded, int64_t returned, LoaderConfig* next) {
+    if (done_) return false;
+    ++batches_;
+    decoded_ += decoded;
+    returned_ += returned;
+    auto now = std::chrono::steady_clock::now();
+    if (++window_ == 1) {
+        // warmup, reconfiguration and refilling prefetch queue are not timed
+        window_start_ = now;
+        return false;
+    }
+    bool budget_left = batches_ < max_batches_;
+    if (window_ <= kTuneWindow && budget_left) return false;
+
+    double seconds = std::chrono::duration<double>(now - window_start_).count();
+    double rate = (window_ - 1) / std::max(seconds, 1e-9);
+    window_ = 0;
+    if (best_rate_ <= 0) {
+        // baseline
+        best_rate_ = rate;
+    } else if (rate > best_rate_ * kTuneMinGain) {
+        best_ = trial_;
+        best_rate_ = rate;
+        improved_ = true;
+    } else {
+        AdvanceMove();
+    }
+
+    LoaderConfig candidate;
+    if (budget_left && NextCandidate(&candidate)) {
+        trial_ = candidate;
+        *next = candidate;
+        return true;
+    }
+    Finish();
+    bool changed = trial_.decoder_threads != best_.decoder_threads || trial_.prefetch != best_.prefetch;
+    trial_ = best_;
+    *next = best_;
+    return changed;
+}
+
+void LoaderAutotuner::Finish() {
+    done_ = true;
+    double amplification = returned_ > 0 ? static_cast<double>(decoded_) / returned_ : 0;
+    LOG(INFO) << "VideoLoader autotune: decoder_threads=" << best_.decoder_threads
+              << " prefetch=" << best_.prefetch << ", " << best_rate_ << " batches/s, decode amplification "
+              << amplification << ", estimated memory " << (EstimateMemory(best_) >> 20) << " MB";
+    Save();
+}
+
+void LoaderAutotuner::Save() const {
+    std::string dir = runtime::GetCacheDir();
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+    std::ofstream fout(path_);
+    if (!fout) {
+        LOG(WARNING) << "VideoLoader autotune: unable to save configuration to " << path_
+                     << ", set DECORD_CACHE_DIR to a writable directory";
+        return;
+    }
+    fout << "decoder_threads " << best_.decoder_threads << "\n"
+         << "prefetch " << best_.prefetch << "\n";
+}
+
+}  // namespace decord
@@ -0,0 +1,107 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file loader_autotuner.h
+ * \brief Online hill climbing of VideoLoader knobs
+ */
+
+#ifndef DECORD_VIDEO_LOADER_AUTOTUNER_H_
+#define DECORD_VIDEO_LOADER_AUTOTUNER_H_
+
+#include <chrono>
+#include <string>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/*! \brief tunable knobs of VideoLoader */
+struct LoaderConfig {
+    /*! \brief codec threads of each video, 0 lets FFmpeg decide */
+    int decoder_threads = 0;
+    /*! \brief batches decoded ahead in background, 0 decodes on demand */
+    int prefetch = 0;
+};  // struct LoaderConfig
+
+/**
+ * \brief LoaderAutotuner picks decoder threads and prefetch depth from measured throughput.
+ *
+ * The loader reports every batch. Each candidate configuration runs for a window of batches,
+ * the first batch of a window is not timed since it pays for the reconfiguration. Starting from the
+ * initial configuration, one knob at a time is moved one step up or down its ladder and kept if
+ * batches per second improve by a margin, candidates above the memory cap are never tried. The cap is
+ * checked against EstimateMemory, a formula from batch size, prefetch depth and decoder threads, not
+ * against actual usage; MemoryGovernor enforces a process wide budget on memory held at runtime.
+ * Tuning stops when no move improves or the batch budget is spent, the result is logged and saved
+ * under the cache directory, keyed by the manifest, to be reused by later runs.
+ */
+class LoaderAutotuner {
+    public:
+        /**
+         * \brief Construct a new LoaderAutotuner object
+         *
+         * \param manifest Identifies the dataset and loader settings, e.g. joined filenames and shape
+         * \param initial Configuration the loader starts with
+         * \param batch_bytes Size of one output batch
+         * \param frame_bytes Size of one decoded frame
+         * \param num_videos Number of open videos, each has its own decoder
+         * \param memory_cap Max memory in bytes as given by EstimateMemory, 0 for no limit
+         * \param max_batches Batch budget of tuning
+         */
+        LoaderAutotuner(const std::string& manifest, LoaderConfig initial, int64_t batch_bytes,
+                        int64_t frame_bytes, int64_t num_videos, int64_t memory_cap, int64_t max_batches = 300);
+        /*! \brief saved configuration of the manifest, tuning is finished if found */
+        bool Load(LoaderConfig* config);
+        /**
+         * \brief Record one batch
+         *
+         * \param decoded Packets decoded for the batch
+         * \param returned Frames returned by the batch
+         * \param next Configuration to apply, valid if true is returned
+         * \return true if the loader has to switch configuration
+         */
+        bool Record(int64_t decoded, int64_t returned, LoaderConfig* next);
+        bool Done() const { return done_; }
+        /**
+         * \brief estimated bytes of prefetched batches and decoder frame buffers
+         *
+         * (prefetch + 2) batches, or 1 without prefetch, plus (threads + 1) frames per video. Codec
+         * internals such as reference frames and FFmpeg allocations are not counted.
+         */
+        int64_t EstimateMemory(const LoaderConfig& config) const;
+
+    private:
+        /*! \brief move knob by dir steps on its ladder, false if out of ladder or above memory cap */
+        bool Step(const LoaderConfig& from, int knob, int dir, LoaderConfig* to) const;
+        /*! \brief next untried move from best configuration, false if none left */
+        bool NextCandidate(LoaderConfig* next);
+        /*! \brief after a failed move, try other direction or next knob */
+        void AdvanceMove();
+        void Finish();
+        void Save() const;
+
+        std::string path_;
+        int64_t batch_bytes_;
+        int64_t frame_bytes_;
+        int64_t num_videos_;
+        int64_t memory_cap_;
+        int64_t max_batches_;
+        int64_t batches_;
+        bool done_;
+        /*! \brief configuration being measured and best one so far */
+        LoaderConfig trial_;
+        LoaderConfig best_;
+        double best_rate_;
+        /*! \brief move being tried, knob index and direction */
+        int knob_;
+        int dir_;
+        /*! \brief current knob improved at least once in this direction */
+        bool improved_;
+        /*! \brief batches seen in current window, first one is warmup */
+        int64_t window_;
+        std::chrono::steady_clock::time_point window_start_;
+        int64_t decoded_;
+        int64_t returned_;
+};  // class LoaderAutotuner
+
+}  // namespace decord
+#endif  // DECORD_VIDEO_LOADER_AUTOTUNER_H_
@@ -0,0 +1,114 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file memory_governor.cc
+ * \brief Process wide memory budget over readers, pools, caches and prefetch queues
+ */
+
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+namespace decord {
+
+MemoryGovernor::MemoryGovernor() : budget_(0), tick_(0), enforcing_(false) {
+    for (int i = 0; i < kNumMemoryComponents; ++i) {
+        usage_[i] = 0;
+        released_[i] = 0;
+    }
+    // e.g. DECORD_MEMORY_BUDGET=4294967296 for 4 GB
+    const char* env = std::getenv("DECORD_MEMORY_BUDGET");
+    if (env) budget_ = std::max<int64_t>(0, std::strtoll(env, nullptr, 10));
+}
+
+MemoryGovernor* MemoryGovernor::Get() {
+    // never destroyed, consumers may unregister during static destruction
+    static MemoryGovernor* inst = new MemoryGovernor();
+    return inst;
+}
+
+void MemoryGovernor::Register(MemoryConsumer* consumer, MemoryComponent component) {
+    CHECK(consumer);
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumers_.push_back({consumer, component});
+}
+
+void MemoryGovernor::Unregister(MemoryConsumer* consumer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumers_.erase(std::remove_if(consumers_.begin(), consumers_.end(),
+                                    [consumer](const Registration& r) { return r.consumer == consumer; }),
+                     consumers_.end());
+}
+
+void MemoryGovernor::Charge(MemoryComponent component, int64_t delta) {
+    usage_[component] += delta;
+}
+
+int64_t MemoryGovernor::Total() const {
+    int64_t total = 0;
+    for (int i = 0; i < kNumMemoryComponents; ++i) total += usage_[i].load();
+    return total;
+}
+
+int64_t MemoryGovernor::Enforce() {
+    const int64_t budget = budget_.load();
+    if (budget <= 0 || Total() <= budget) return 0;
+    bool expected = false;
+    if (!enforcing_.compare_exchange_strong(expected, true)) return 0;
+    int64_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int c = 0; c < kNumMemoryComponents && Total() > budget; ++c) {
+            std::vector<std::pair<int64_t, MemoryConsumer*> > order;
+            for (const auto& r : consumers_) {
+                if (r.component == c) order.emplace_back(r.consumer->LastUse(), r.consumer);
+            }
+            std::stable_sort(order.begin(), order.end(),
+                             [](const std::pair<int64_t, MemoryConsumer*>& a,
+                                const std::pair<int64_t, MemoryConsumer*>& b) { return a.first < b.first; });
+            for (const auto& kv : order) {
+                const int64_t excess = Total() - budget;
+                if (excess <= 0) break;
+                int64_t bytes = kv.second->ReleaseMemory(excess);
+                released_[c] += bytes;
+                released += bytes;
+            }
+        }
+        if (Total() > budget) {
+            // everything left is in use, allocation is not refused
+            static bool warned = false;
+            if (!warned) {
+                LOG(WARNING) << "Memory budget of " << (budget >> 20) << " MB exceeded by memory in use, "
+                             << (Total() >> 20) << " MB held";
+                warned = true;
+            }
+        }
+    }
+    enforcing_ = false;
+    return released;
+}
+
+void MemoryGovernor::SetBudget(int64_t bytes) {
+    budget_ = std::max<int64_t>(0, bytes);
+    Enforce();
+}
+
+std::vector<int64_t> MemoryGovernor::GetUsage() const {
+    std::vector<int64_t> ret(kNumMemoryComponents);
+    for (int i = 0; i < kNumMemoryComponents; ++i) ret[i] = usage_[i].load();
+    return ret;
+}
+
+bool MemoryGovernor::Fits(int64_t bytes) const {
+    const int64_t budget = budget_.load();
+    return budget <= 0 || Total() + bytes <= budget;
+}
+
+std::vector<int64_t> MemoryGovernor::GetReleased() const {
+    std::vector<int64_t> ret(kNumMemoryComponents);
+    for (int i = 0; i < kNumMemoryComponents; ++i) ret[i] = released_[i].load();
+    return ret;
+}
+
+}  // namespace decord
@@ -0,0 +1,111 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file memory_governor.h
+ * \brief Process wide memory budget over readers, pools, caches and prefetch queues
+ */
+
+#ifndef DECORD_VIDEO_MEMORY_GOVERNOR_H_
+#define DECORD_VIDEO_MEMORY_GOVERNOR_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/*! \brief kind of memory holder, the governor shrinks kinds in this order */
+enum MemoryComponent {
+    /*! \brief frames decoded ahead of requests, cheapest to drop */
+    kMemoryCache = 0,
+    /*! \brief idle buffers kept for reuse */
+    kMemoryPool,
+    /*! \brief batches decoded ahead by loaders, dropped batches are decoded again */
+    kMemoryPrefetch,
+    /*! \brief open decoders, closed readers reopen on next use */
+    kMemoryReader,
+    kNumMemoryComponents,
+};  // enum MemoryComponent
+
+/**
+ * \brief Holder of memory governed by MemoryGovernor.
+ *
+ * Implementations report their usage with MemoryGovernor::Charge and must never call into the governor
+ * while holding a lock ReleaseMemory takes, since ReleaseMemory can be called from any thread.
+ */
+class MemoryConsumer {
+    public:
+        virtual ~MemoryConsumer() = default;
+        /**
+         * \brief Release memory, e.g. evict cached frames or close an idle decoder
+         *
+         * \param bytes Bytes wanted
+         * \return Bytes released, may be less or more than wanted, 0 if busy
+         */
+        virtual int64_t ReleaseMemory(int64_t bytes) = 0;
+        /*! \brief tick of last use from MemoryGovernor::Tick, least recently used are released first */
+        virtual int64_t LastUse() const { return 0; }
+};  // class MemoryConsumer
+
+/**
+ * \brief MemoryGovernor keeps registered memory under a process wide budget.
+ *
+ * Consumers register with their component and charge the bytes they hold. Accounting is a few atomic
+ * adds, enforcement only starts once the total exceeds the budget: components are asked to release
+ * memory in MemoryComponent order, least recently used consumers first within a component, until
+ * usage fits. Usage of FFmpeg internals is estimated from frame size and decoder threads.
+ * The budget is read from DECORD_MEMORY_BUDGET (bytes) at startup, no limit by default.
+ */
+class MemoryGovernor {
+    public:
+        /*! \brief the process wide governor */
+        static MemoryGovernor* Get();
+        void Register(MemoryConsumer* consumer, MemoryComponent component);
+        /*! \brief waits for a running ReleaseMemory of consumer, call before destroying it */
+        void Unregister(MemoryConsumer* consumer);
+        /*! \brief add delta bytes held by component, negative when released */
+        void Charge(MemoryComponent component, int64_t delta);
+        /**
+         * \brief Release memory until usage fits the budget, no-op if it already does
+         *
+         * Call after growing, without holding locks taken by any ReleaseMemory. Only one thread
+         * enforces at a time, others return immediately.
+         *
+         * \return Bytes released
+         */
+        int64_t Enforce();
+        /*! \brief budget in bytes, 0 for no limit, enforced right away */
+        void SetBudget(int64_t bytes);
+        int64_t GetBudget() const { return budget_.load(); }
+        /*! \brief bytes held by each component, indexed by MemoryComponent */
+        std::vector<int64_t> GetUsage() const;
+        /*! \brief whether bytes more would still fit the budget, always true without limit */
+        bool Fits(int64_t bytes) const;
+        /*! \brief bytes released from each component since start */
+        std::vector<int64_t> GetReleased() const;
+        /*! \brief monotonic counter for MemoryConsumer::LastUse */
+        int64_t Tick() { return ++tick_; }
+
+    private:
+        MemoryGovernor();
+        int64_t Total() const;
+        struct Registration {
+            MemoryConsumer* consumer;
+            MemoryComponent component;
+        };  // struct Registration
+
+        /*! \brief guards registrations, held while consumers release memory */
+        std::mutex mutex_;
+        std::vector<Registration> consumers_;
+        std::atomic<int64_t> budget_;
+        std::atomic<int64_t> usage_[kNumMemoryComponents];
+        std::atomic<int64_t> released_[kNumMemoryComponents];
+        std::atomic<int64_t> tick_;
+        std::atomic<bool> enforcing_;
+
+    DISALLOW_COPY_AND_ASSIGN(MemoryGovernor);
+};  // class MemoryGovernor
+
+}  // namespace decord
+#endif  // DECORD_VIDEO_MEMORY_GOVERNOR_H_
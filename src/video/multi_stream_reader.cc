@@ -0,0 +1,447 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file multi_stream_reader.cc
+ * \brief Multi stream video reader Impl
+ */
+
+#include "multi_stream_reader.h"
+#include "../runtime/parallel_util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+using AVFramePtr = ffmpeg::AVFramePtr;
+using AVPacketPtr = ffmpeg::AVPacketPtr;
+using AVFramePool = ffmpeg::AVFramePool;
+using AVPacketPool = ffmpeg::AVPacketPool;
+
+/*! \brief number of packets routed to decoders before running one parallel decode pass */
+static const int kDemuxChunkSize = 64;
+/*! \brief maximum number of backward seek retries when demuxer lands after wanted frames */
+static const int kMaxSeekRetries = 4;
+
+MultiStreamVideoReader::MultiStreamVideoReader(std::string fn, DLContext ctx, std::vector<int> stream_ids,
+                                               int width, int height)
+    : ctx_(ctx), streams_(), stream_map_(), ref_(0), curr_frame_(0),
+    width_(width), height_(height), eof_(true) {
+    CHECK(ctx_.device_type == kDLCPU)
+        << "MultiStreamVideoReader only supports CPU context, given: " << ctx_.device_type;
+    #if ( LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100) )
+    av_register_all();
+    #endif
+
+    AVFormatContext *fmt_ctx = nullptr;
+    int open_ret = avformat_open_input(&fmt_ctx, fn.c_str(), NULL, NULL);
+    if( open_ret != 0 ) {
+        char errstr[200];
+        av_strerror(open_ret, errstr, 200);
+        LOG(FATAL) << "ERROR opening file: " << fn.c_str() << ", " << errstr;
+        return;
+    }
+    fmt_ctx_.reset(fmt_ctx);
+    if (avformat_find_stream_info(fmt_ctx,  NULL) < 0) {
+        LOG(FATAL) << "ERROR getting stream info of file" << fn;
+    }
+
+    if (stream_ids.empty()) {
+        // activate all decodable video streams
+        for (uint32_t i = 0; i < fmt_ctx_->nb_streams; ++i) {
+            AVCodecParameters *par = fmt_ctx_->streams[i]->codecpar;
+            if (par->codec_type == AVMEDIA_TYPE_VIDEO && avcodec_find_decoder(par->codec_id)) {
+                stream_ids.emplace_back(static_cast<int>(i));
+            }
+        }
+    }
+    CHECK_GT(stream_ids.size(), 0) << "No video stream found in " << fn;
+
+    stream_map_.assign(fmt_ctx_->nb_streams, -1);
+    for (auto st_nb : stream_ids) {
+        CHECK(st_nb >= 0 && static_cast<unsigned int>(st_nb) < fmt_ctx_->nb_streams)
+            << "Invalid stream index: " << st_nb;
+        CHECK_LT(stream_map_[st_nb], 0) << "Duplicate stream index: " << st_nb;
+        AVStream *st = fmt_ctx_->streams[st_nb];
+        CHECK(st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) << "Stream " << st_nb << " is not a video stream";
+        AVCodec *dec = avcodec_find_decoder(st->codecpar->codec_id);
+        CHECK(dec) << "Codecs of " << st_nb << " is NULL";
+        auto dec_ctx = avcodec_alloc_context3(dec);
+        dec_ctx->thread_count = 0;
+        CHECK_GE(avcodec_parameters_to_context(dec_ctx, st->codecpar), 0)
+            << "ERROR copying codec parameters to context";
+        dec_ctx->time_base = st->time_base;
+        open_ret = avcodec_open2(dec_ctx, dec, NULL);
+        if (open_ret < 0 ) {
+            char errstr[200];
+            av_strerror(open_ret, errstr, 200);
+            avcodec_free_context(&dec_ctx);
+            LOG(FATAL) << "ERROR open codec through avcodec_open2: " << errstr;
+            return;
+        }
+        StreamContext stm;
+        stm.stream_index = st_nb;
+        stm.time_base = st->time_base;
+        stm.dec_ctx.reset(dec_ctx);
+        stm.last_decoded = -1;
+        stm.synced = false;
+        stream_map_[st_nb] = static_cast<int>(streams_.size());
+        streams_.emplace_back(std::move(stm));
+    }
+
+    // output size follows the first active stream unless specified
+    AVCodecParameters *ref_par = fmt_ctx_->streams[streams_[0].stream_index]->codecpar;
+    if (width_ < 1) {
+        width_ = ref_par->width;
+    }
+    if (height_ < 1) {
+        height_ = ref_par->height;
+    }
+    char descr[128];
+    std::snprintf(descr, sizeof(descr), "scale=%d:%d", width_, height_);
+    for (auto& stm : streams_) {
+        stm.filter_graph = FFMPEGFilterGraphPtr(new ffmpeg::FFMPEGFilterGraph(descr, stm.dec_ctx.get()));
+    }
+    IndexFrames();
+    SetVideoStream(-1);
+}
+
+MultiStreamVideoReader::~MultiStreamVideoReader() {
+}
+
+void MultiStreamVideoReader::SetVideoStream(int stream_nb) {
+    if (stream_nb < 0) {
+        ref_ = 0;
+        return;
+    }
+    CHECK(static_cast<unsigned int>(stream_nb) < stream_map_.size() && stream_map_[stream_nb] >= 0)
+        << "Stream " << stream_nb << " is not activated in this reader";
+    ref_ = static_cast<std::size_t>(stream_map_[stream_nb]);
+    CHECK_GT(GetFrameCount(), 0) << "Reference stream " << stream_nb << " has no frames";
+}
+
+unsigned int MultiStreamVideoReader::QueryStreams() const {
+    CHECK(fmt_ctx_ != NULL);
+    for (unsigned int i = 0; i < fmt_ctx_->nb_streams; ++i) {
+        AVStream *st = fmt_ctx_->streams[i];
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            bool active = stream_map_[i] >= 0;
+            LOG(INFO) << "video stream [" << i << "]:"
+                << (active ? " active" : " inactive")
+                << " Average FPS: "
+                << static_cast<float>(st->avg_frame_rate.num) / st->avg_frame_rate.den
+                << " Resolution: "
+                << st->codecpar->width << "x" << st->codecpar->height
+                << " Frame count: "
+                << (active ? streams_[stream_map_[i]].frame_pts.size() : st->nb_frames);
+        } else {
+            const char *codec_type = av_get_media_type_string(st->codecpar->codec_type);
+            codec_type = codec_type? codec_type : "unknown type";
+            LOG(INFO) << codec_type << " stream [" << i << "].";
+        }
+    }
+    return fmt_ctx_->nb_streams;
+}
+
+std::vector<int> MultiStreamVideoReader::GetActiveStreams() const {
+    std::vector<int> ret;
+    ret.reserve(streams_.size());
+    for (auto& stm : streams_) {
+        ret.emplace_back(stm.stream_index);
+    }
+    return ret;
+}
+
+void MultiStreamVideoReader::IndexFrames() {
+    // a single pass over the file collects timestamps and keyframes of all active streams
+    std::vector<std::vector<std::pair<int64_t, bool> > > records(streams_.size());
+    AVPacketPtr packet = AVPacketPool::Get()->Acquire();
+    int ret = -1;
+    while (true) {
+        ret = av_read_frame(fmt_ctx_.get(), packet.get());
+        if (ret < 0) {
+            if (ret != AVERROR_EOF) {
+                LOG(FATAL) << "Error: av_read_frame failed with " << AVERROR(ret);
+            }
+            break;
+        }
+        int pos = stream_map_[packet->stream_index];
+        if (pos >= 0) {
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            records[pos].emplace_back(pts, (packet->flags & AV_PKT_FLAG_KEY) != 0);
+        }
+        av_packet_unref(packet.get());
+    }
+    for (std::size_t i = 0; i < streams_.size(); ++i) {
+        auto& rec = records[i];
+        auto& stm = streams_[i];
+        std::sort(rec.begin(), rec.end());
+        stm.frame_pts.clear();
+        stm.key_indices.clear();
+        stm.frame_pts.reserve(rec.size());
+        for (std::size_t j = 0; j < rec.size(); ++j) {
+            stm.frame_pts.emplace_back(rec[j].first);
+            if (rec[j].second) {
+                stm.key_indices.emplace_back(static_cast<int64_t>(j));
+            }
+        }
+        if (stm.key_indices.empty() || stm.key_indices[0] != 0) {
+            stm.key_indices.insert(stm.key_indices.begin(), 0);
+        }
+        stm.synced = false;
+    }
+    // demuxer is at the end of file, force seeking on next read
+    eof_ = true;
+}
+
+int64_t MultiStreamVideoReader::PTSToFrame(const StreamContext& stm, int64_t pts) const {
+    auto& v = stm.frame_pts;
+    if (v.empty()) return 0;
+    auto it = std::lower_bound(v.begin(), v.end(), pts);
+    if (it == v.end()) return static_cast<int64_t>(v.size()) - 1;
+    if (it != v.begin() && (pts - *(it - 1)) < (*it - pts)) --it;
+    return it - v.begin();
+}
+
+int64_t MultiStreamVideoReader::LocateKeyframe(const StreamContext& stm, int64_t pos) const {
+    auto& keys = stm.key_indices;
+    if (keys.size() < 1) return 0;
+    if (pos <= keys[0]) return 0;
+    auto it = std::upper_bound(keys.begin(), keys.end(), pos) - 1;
+    return *it;
+}
+
+int64_t MultiStreamVideoReader::GetFrameCount() const {
+    return static_cast<int64_t>(streams_[ref_].frame_pts.size());
+}
+
+int64_t MultiStreamVideoReader::GetCurrentPosition() const {
+    return curr_frame_;
+}
+
+double MultiStreamVideoReader::GetAverageFPS() const {
+    AVStream *active_st = fmt_ctx_->streams[streams_[ref_].stream_index];
+    return static_cast<double>(active_st->avg_frame_rate.num) / active_st->avg_frame_rate.den;
+}
+
+NDArray MultiStreamVideoReader::GetKeyIndices() {
+    auto keys = streams_[ref_].key_indices;
+    std::vector<int64_t> shape = {static_cast<int64_t>(keys.size())};
+    NDArray ret = NDArray::Empty(shape, kInt64, kCPU);
+    ret.CopyFrom(keys, shape);
+    return ret;
+}
+
+bool MultiStreamVideoReader::Seek(int64_t pos) {
+    // demuxer is repositioned lazily by the next read
+    if (pos < 0 || pos >= GetFrameCount()) return false;
+    curr_frame_ = pos;
+    return true;
+}
+
+bool MultiStreamVideoReader::SeekAccurate(int64_t pos) {
+    return Seek(pos);
+}
+
+void MultiStreamVideoReader::SkipFrames(int64_t num) {
+    if (num < 1) return;
+    curr_frame_ = std::min(GetFrameCount(), curr_frame_ + num);
+}
+
+NDArray MultiStreamVideoReader::NextFrame() {
+    if (curr_frame_ >= GetFrameCount()) {
+        return NDArray::Empty({}, kUInt8, ctx_);
+    }
+    NDArray batch = GetBatch({curr_frame_}, NDArray());
+    return batch.CreateView({static_cast<int64_t>(streams_.size()), height_, width_, 3}, kUInt8);
+}
+
+bool MultiStreamVideoReader::HasPending() const {
+    for (auto& stm : streams_) {
+        if (!stm.pending.empty()) return true;
+    }
+    return false;
+}
+
+bool MultiStreamVideoReader::ShouldSeek() const {
+    if (eof_) return true;
+    bool all_forward = true;
+    bool any_pending = false;
+    for (auto& stm : streams_) {
+        if (stm.pending.empty()) continue;
+        any_pending = true;
+        if (!stm.synced) return true;
+        int64_t next = std::numeric_limits<int64_t>::max();
+        for (auto& kv : stm.pending) {
+            next = std::min(next, kv.first);
+        }
+        if (next <= stm.last_decoded) {
+            // wanted frame is behind current decoding position
+            return true;
+        }
+        // jumping forward is worth a seek only if every stream can skip at least one GOP
+        if (LocateKeyframe(stm, next) <= LocateKeyframe(stm, stm.last_decoded + 1)) {
+            all_forward = false;
+        }
+    }
+    return any_pending && all_forward;
+}
+
+void MultiStreamVideoReader::SeekStreams(int retries) {
+    AVRational time_base_q = {1, AV_TIME_BASE};
+    int64_t ts = std::numeric_limits<int64_t>::max();
+    for (auto& stm : streams_) {
+        if (stm.pending.empty()) continue;
+        int64_t next = std::numeric_limits<int64_t>::max();
+        for (auto& kv : stm.pending) {
+            next = std::min(next, kv.first);
+        }
+        int64_t key = LocateKeyframe(stm, next);
+        ts = std::min(ts, av_rescale_q(stm.frame_pts[key], stm.time_base, time_base_q));
+    }
+    CHECK(ts != std::numeric_limits<int64_t>::max()) << "Nothing to seek";
+    ts -= static_cast<int64_t>(retries) * AV_TIME_BASE;
+    if (fmt_ctx_->start_time != AV_NOPTS_VALUE) {
+        ts = std::max(ts, fmt_ctx_->start_time);
+    }
+    int ret = av_seek_frame(fmt_ctx_.get(), -1, ts, AVSEEK_FLAG_BACKWARD);
+    CHECK_GE(ret, 0) << "Failed to seek file to timestamp: " << ts;
+    for (auto& stm : streams_) {
+        avcodec_flush_buffers(stm.dec_ctx.get());
+        stm.packets.clear();
+        stm.synced = true;
+        int64_t start = PTSToFrame(stm, av_rescale_q(ts, time_base_q, stm.time_base));
+        stm.last_decoded = LocateKeyframe(stm, start) - 1;
+    }
+    eof_ = false;
+}
+
+bool MultiStreamVideoReader::DemuxChunk() {
+    int routed = 0;
+    AVPacketPtr packet = AVPacketPool::Get()->Acquire();
+    while (routed < kDemuxChunkSize) {
+        int ret = av_read_frame(fmt_ctx_.get(), packet.get());
+        if (ret < 0) {
+            if (ret == AVERROR_EOF) {
+                eof_ = true;
+                return true;
+            }
+            LOG(FATAL) << "Error: av_read_frame failed with " << AVERROR(ret);
+        }
+        int pos = stream_map_[packet->stream_index];
+        if (pos >= 0) {
+            auto& stm = streams_[pos];
+            if (!stm.pending.empty()) {
+                stm.packets.emplace_back(packet);
+                packet = AVPacketPool::Get()->Acquire();
+                ++routed;
+                continue;
+            }
+            // stream is idle, decoder state is no longer continuous
+            stm.synced = false;
+        }
+        av_packet_unref(packet.get());
+    }
+    return false;
+}
+
+void MultiStreamVideoReader::DecodeStream(StreamContext& stm, bool drain, uint8_t *dst) {
+    AVCodecContext *dec_ctx = stm.dec_ctx.get();
+    const uint64_t frame_bytes = static_cast<uint64_t>(height_) * width_ * 3;
+    AVFramePtr frame = AVFramePool::Get()->Acquire();
+    auto receive = [&]() {
+        while (true) {
+            int ret = avcodec_receive_frame(dec_ctx, frame.get());
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            CHECK_GE(ret, 0) << "Error decoding frame of stream " << stm.stream_index << ": " << ret;
+            int64_t idx = PTSToFrame(stm, frame->best_effort_timestamp);
+            stm.last_decoded = idx;
+            auto it = stm.pending.find(idx);
+            if (it == stm.pending.end()) continue;
+            // convert once into the first slot, duplicated slots are plain copies
+            stm.filter_graph->Push(frame.get());
+            AVFramePtr out_frame = AVFramePool::Get()->Acquire();
+            AVFrame *out_frame_p = out_frame.get();
+            CHECK(stm.filter_graph->Pop(&out_frame_p)) << "Error fetch filtered frame.";
+            const auto& slots = it->second;
+            uint8_t *first = dst + slots[0] * frame_bytes;
+            const int linesize = width_ * 3;
+            for (int h = 0; h < height_; ++h) {
+                std::memcpy(first + h * linesize, out_frame_p->data[0] + h * out_frame_p->linesize[0], linesize);
+            }
+            for (std::size_t k = 1; k < slots.size(); ++k) {
+                std::memcpy(dst + slots[k] * frame_bytes, first, frame_bytes);
+            }
+            stm.pending.erase(it);
+        }
+    };
+    for (auto& pkt : stm.packets) {
+        CHECK_GE(avcodec_send_packet(dec_ctx, pkt.get()), 0)
+            << "Error sending packet of stream " << stm.stream_index;
+        receive();
+    }
+    stm.packets.clear();
+    if (drain) {
+        CHECK_GE(avcodec_send_packet(dec_ctx, NULL), 0) << "Error entering draining mode.";
+        receive();
+        avcodec_flush_buffers(dec_ctx);
+    }
+}
+
+NDArray MultiStreamVideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    const int64_t num_streams = static_cast<int64_t>(streams_.size());
+    if (!buf.defined()) {
+        buf = NDArray::Empty({num_streams, bs, height_, width_, 3}, kUInt8, ctx_);
+    }
+    CHECK_EQ(buf.Size(), num_streams * bs * height_ * width_ * 3) << "Invalid output buffer size";
+    const int64_t frame_count = GetFrameCount();
+    const auto& ref = streams_[ref_];
+    for (auto& stm : streams_) stm.pending.clear();
+    for (int64_t i = 0; i < bs; ++i) {
+        int64_t pos = indices[i];
+        CHECK_LT(pos, frame_count);
+        CHECK_GE(pos, 0);
+        int64_t ref_pts = ref.frame_pts[pos];
+        for (int64_t s = 0; s < num_streams; ++s) {
+            auto& stm = streams_[s];
+            int64_t idx = (static_cast<std::size_t>(s) == ref_) ? pos :
+                PTSToFrame(stm, av_rescale_q(ref_pts, ref.time_base, stm.time_base));
+            stm.pending[idx].emplace_back(s * bs + i);
+        }
+    }
+
+    uint8_t *dst = static_cast<uint8_t*>(buf->data) + buf->byte_offset;
+    int retries = 0;
+    while (HasPending()) {
+        if (ShouldSeek()) {
+            // a stream still waits for frames it already passed, rewind further than last time
+            SeekStreams(retries);
+        }
+        bool eof = DemuxChunk();
+        runtime::ParallelFor(num_streams, [&](int64_t s) {
+            auto& stm = streams_[s];
+            if (stm.packets.empty() && !eof) return;
+            DecodeStream(stm, eof, dst);
+        });
+        if (!HasPending()) break;
+        bool missed = false;
+        for (auto& stm : streams_) {
+            for (auto& kv : stm.pending) {
+                if (kv.first <= stm.last_decoded) missed = true;
+            }
+        }
+        if (missed || eof) {
+            ++retries;
+            CHECK_LE(retries, kMaxSeekRetries) << "Error getting frames from streams, "
+                << "demuxer cannot reach wanted positions.";
+        }
+    }
+    if (bs > 0) {
+        curr_frame_ = indices.back() + 1;
+    }
+    return buf;
+}
+
+}  // namespace decord
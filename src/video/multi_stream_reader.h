@@ -0,0 +1,105 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file multi_stream_reader.h
+ * \brief Video reader decoding several video streams of one file with a single demuxer
+ */
+
+#ifndef DECORD_VIDEO_MULTI_STREAM_READER_H_
+#define DECORD_VIDEO_MULTI_STREAM_READER_H_
+
+#include "ffmpeg/filter_graph.h"
+#include <decord/video_interface.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/**
+ * \brief MultiStreamVideoReader activates a set of video streams (e.g. camera angles muxed in one file).
+ *
+ * Packets are demuxed once and routed to one decoder per stream, decoders run concurrently on the
+ * runtime thread pool. Frame indices refer to the reference stream (the first active stream by default),
+ * other streams return the frame closest in presentation time, so `GetBatch` returns time aligned frames
+ * in shape [num_streams, batch, H, W, 3].
+ */
+class MultiStreamVideoReader : public VideoReaderInterface {
+    using NDArray = runtime::NDArray;
+    using FFMPEGFilterGraphPtr = std::shared_ptr<ffmpeg::FFMPEGFilterGraph>;
+    public:
+        /**
+         * \brief Construct a new MultiStreamVideoReader object
+         *
+         * \param fn Video file name
+         * \param ctx Decoding context, only CPU is supported
+         * \param stream_ids Video stream indices to activate, empty means all video streams
+         * \param width Output width, -1 to follow the reference stream
+         * \param height Output height, -1 to follow the reference stream
+         */
+        MultiStreamVideoReader(std::string fn, DLContext ctx, std::vector<int> stream_ids,
+                               int width=-1, int height=-1);
+        ~MultiStreamVideoReader();
+        /*! \brief select reference stream among active streams, -1 means the first active stream */
+        void SetVideoStream(int stream_nb = -1);
+        unsigned int QueryStreams() const;
+        int64_t GetFrameCount() const;
+        int64_t GetCurrentPosition() const;
+        NDArray NextFrame();
+        NDArray GetBatch(std::vector<int64_t> indices, NDArray buf);
+        void SkipFrames(int64_t num = 1);
+        bool Seek(int64_t pos);
+        bool SeekAccurate(int64_t pos);
+        NDArray GetKeyIndices();
+        double GetAverageFPS() const;
+        /*! \brief get indices of active streams, in output order */
+        std::vector<int> GetActiveStreams() const;
+
+    private:
+        /*! \brief per stream decoding state */
+        struct StreamContext {
+            /*! \brief stream index in container */
+            int stream_index;
+            /*! \brief stream time base */
+            AVRational time_base;
+            ffmpeg::AVCodecContextPtr dec_ctx;
+            FFMPEGFilterGraphPtr filter_graph;
+            /*! \brief sorted presentation timestamps of all frames */
+            std::vector<int64_t> frame_pts;
+            /*! \brief keyframe indices */
+            std::vector<int64_t> key_indices;
+            /*! \brief packets routed to this stream in current demux chunk */
+            std::vector<ffmpeg::AVPacketPtr> packets;
+            /*! \brief pending frame index -> output slots */
+            std::unordered_map<int64_t, std::vector<int64_t> > pending;
+            /*! \brief index of last decoded frame since last seek, -1 if none */
+            int64_t last_decoded;
+            /*! \brief whether decoder state is continuous since last seek */
+            bool synced;
+        };
+
+        void IndexFrames();
+        int64_t PTSToFrame(const StreamContext& stm, int64_t pts) const;
+        int64_t LocateKeyframe(const StreamContext& stm, int64_t pos) const;
+        void SeekStreams(int retries);
+        bool ShouldSeek() const;
+        bool HasPending() const;
+        bool DemuxChunk();
+        void DecodeStream(StreamContext& stm, bool drain, uint8_t *dst);
+
+        DLContext ctx_;
+        ffmpeg::AVFormatContextPtr fmt_ctx_;
+        std::vector<StreamContext> streams_;
+        /*! \brief container stream index -> position in streams_, -1 if inactive */
+        std::vector<int> stream_map_;
+        /*! \brief position of reference stream in streams_ */
+        std::size_t ref_;
+        int64_t curr_frame_;
+        int width_;
+        int height_;
+        bool eof_;
+};  // class MultiStreamVideoReader
+}  // namespace decord
+#endif  // DECORD_VIDEO_MULTI_STREAM_READER_H_
@@ -90,8 +90,11 @@ void CUThreadedDecoder::InitBitStreamFilter(AVCodecParameters *codecpar) {
     bsf_ctx_.reset(bsf_ctx);
 }
 
-void CUThreadedDecoder::SetCodecContext(AVCodecContext *dec_ctx, int width, int height) {
+void CUThreadedDecoder::SetCodecContext(AVCodecContext *dec_ctx, int width, int height,
+                                        FrameOptions opts) {
     CHECK(dec_ctx);
+    CHECK(opts.pix_fmt == AV_PIX_FMT_RGB24 && !opts.tone_mapping)
+        << "CUDA decoder only supports RGB24 output without tone mapping.";
     width_ = width;
     height_ = height;
     bool running = run_.load();
@@ -116,7 +119,9 @@ void CUThreadedDecoder::Start() {
     buffer_queue_.reset(new BufferQueue());
     reorder_queue_.reset(new ReorderQueue());
     frame_order_.reset(new FrameOrderQueue());
-    avcodec_flush_buffers(dec_ctx_.get());
+    // packets are decoded by NVDEC through parser_, the codec context only carries parameters and
+    // is left unopened since readers start decoders lazily, nothing to flush then
+    if (avcodec_is_open(dec_ctx_.get())) avcodec_flush_buffers(dec_ctx_.get());
     // frame_in_use_.resize(kMaxOutputSurfaces, 0);
     CHECK(permits_.size() == 0);
     permits_.resize(kMaxOutputSurfaces);
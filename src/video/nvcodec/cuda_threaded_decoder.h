@@ -47,7 +47,8 @@ class CUThreadedDecoder : public ThreadedDecoderInterface {
 
     public:
         CUThreadedDecoder(int device_id, AVCodecParameters *codecpar);
-        void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1);
+        void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1,
+                             FrameOptions opts = FrameOptions());
         bool Initialized() const;
         void Start();
         void Stop();
@@ -0,0 +1,248 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file packet_reader.cc
+ * \brief Demux only reader returning compressed packets
+ */
+
+#include "packet_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+
+namespace decord {
+
+using AVPacketPtr = ffmpeg::AVPacketPtr;
+using AVPacketPool = ffmpeg::AVPacketPool;
+
+PacketReader::PacketReader(std::string fn, int stream_nb, std::string bsf_name)
+    : actv_stm_idx_(-1), bsf_name_(bsf_name) {
+    #if ( LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100) )
+    av_register_all();
+    #endif
+
+    AVFormatContext *fmt_ctx = nullptr;
+    int open_ret = avformat_open_input(&fmt_ctx, fn.c_str(), NULL, NULL);
+    if (open_ret != 0) {
+        char errstr[200];
+        av_strerror(open_ret, errstr, 200);
+        LOG(FATAL) << "ERROR opening file: " << fn.c_str() << ", " << errstr;
+        return;
+    }
+    fmt_ctx_.reset(fmt_ctx);
+    if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
+        LOG(FATAL) << "ERROR getting stream info of file" << fn;
+    }
+    // no decoder is opened, streams without available decoder are fine
+    actv_stm_idx_ = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, stream_nb, -1, NULL, 0);
+    CHECK_GE(actv_stm_idx_, 0) << "ERROR cannot find video stream with wanted index: " << stream_nb;
+
+    AVCodecParameters *codecpar = fmt_ctx_->streams[actv_stm_idx_]->codecpar;
+    if (bsf_name_ == "auto") {
+        // mp4 style containers store avcC/hvcC extradata starting with version 1, Annex B starts with a start code
+        bool length_prefixed = codecpar->extradata_size > 0 && codecpar->extradata[0] == 1;
+        if (AV_CODEC_ID_H264 == codecpar->codec_id && length_prefixed) {
+            bsf_name_ = "h264_mp4toannexb";
+        } else if (AV_CODEC_ID_HEVC == codecpar->codec_id && length_prefixed) {
+            bsf_name_ = "hevc_mp4toannexb";
+        } else {
+            bsf_name_.clear();
+        }
+    }
+    InitBitStreamFilter();
+    IndexPackets();
+}
+
+void PacketReader::InitBitStreamFilter() {
+    if (bsf_name_.empty()) return;
+    AVStream *st = fmt_ctx_->streams[actv_stm_idx_];
+    auto bsf = av_bsf_get_by_name(bsf_name_.c_str());
+    CHECK(bsf) << "Error finding bitstream filter: " << bsf_name_;
+    AVBSFContext* bsf_ctx = nullptr;
+    CHECK_GE(av_bsf_alloc(bsf, &bsf_ctx), 0) << "Error allocating bit stream filter context.";
+    bsf_ctx_.reset(bsf_ctx);
+    CHECK_GE(avcodec_parameters_copy(bsf_ctx->par_in, st->codecpar), 0) << "Error setting BSF parameters.";
+    bsf_ctx->time_base_in = st->time_base;
+    CHECK_GE(av_bsf_init(bsf_ctx), 0) << "Error init BSF";
+}
+
+void PacketReader::IndexPackets() {
+    packets_.clear();
+    AVPacketPtr packet = AVPacketPool::Get()->Acquire();
+    while (true) {
+        int ret = av_read_frame(fmt_ctx_.get(), packet.get());
+        if (ret == AVERROR_EOF) break;
+        CHECK_GE(ret, 0) << "Error: av_read_frame failed with " << AVERROR(ret);
+        if (packet->stream_index == actv_stm_idx_) {
+            PacketInfo info;
+            info.pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            info.dts = packet->dts;
+            info.key = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+            packets_.emplace_back(info);
+        }
+        av_packet_unref(packet.get());
+    }
+
+    // presentation order is pts order, then dts; packets without any timestamp go first in decode order
+    const int64_t n = static_cast<int64_t>(packets_.size());
+    decode_order_.resize(n);
+    std::iota(decode_order_.begin(), decode_order_.end(), 0);
+    std::stable_sort(decode_order_.begin(), decode_order_.end(), [this](int64_t a, int64_t b) {
+        const PacketInfo& pa = packets_[a];
+        const PacketInfo& pb = packets_[b];
+        return std::make_tuple(pa.pts != AV_NOPTS_VALUE, pa.pts, pa.dts)
+            < std::make_tuple(pb.pts != AV_NOPTS_VALUE, pb.pts, pb.dts);
+    });
+    present_order_.resize(n);
+    for (int64_t i = 0; i < n; ++i) present_order_[decode_order_[i]] = i;
+
+    key_packets_.clear();
+    key_frames_.clear();
+    key_to_packet_.clear();
+    pts_to_frame_.clear();
+    for (int64_t d = 0; d < n; ++d) {
+        const PacketInfo& info = packets_[d];
+        if (info.key) {
+            key_packets_.emplace_back(d);
+            key_frames_.emplace_back(present_order_[d]);
+        }
+        key_to_packet_.emplace(PacketKey(info.pts, info.dts), d);
+        if (info.pts != AV_NOPTS_VALUE) pts_to_frame_.emplace(info.pts, present_order_[d]);
+    }
+    std::sort(key_frames_.begin(), key_frames_.end());
+    if (key_packets_.empty() || key_packets_.front() != 0) {
+        // leading packets are only decodable from the very beginning
+        key_packets_.insert(key_packets_.begin(), 0);
+    }
+}
+
+double PacketReader::GetAverageFPS() const {
+    AVStream *st = fmt_ctx_->streams[actv_stm_idx_];
+    return static_cast<double>(st->avg_frame_rate.num) / st->avg_frame_rate.den;
+}
+
+std::string PacketReader::GetCodecName() const {
+    return std::string(avcodec_get_name(fmt_ctx_->streams[actv_stm_idx_]->codecpar->codec_id));
+}
+
+AVRational PacketReader::GetTimeBase() const {
+    return bsf_ctx_ ? bsf_ctx_->time_base_out : fmt_ctx_->streams[actv_stm_idx_]->time_base;
+}
+
+runtime::NDArray PacketReader::GetExtradata() const {
+    const AVCodecParameters *par = bsf_ctx_ ? bsf_ctx_->par_out : fmt_ctx_->streams[actv_stm_idx_]->codecpar;
+    int64_t size = std::max(par->extradata_size, 0);
+    NDArray ret = NDArray::Empty({size}, kUInt8, kCPU);
+    if (size > 0) std::memcpy(ret->data, par->extradata, size);
+    return ret;
+}
+
+void PacketReader::ReadRange(int64_t start, int64_t end) {
+    const int64_t n = GetFrameCount();
+    CHECK(start >= 0 && start < end && end <= n)
+        << "Invalid frame range [" << start << ", " << end << "), frame count: " << n;
+    // decode order span of the requested frames, starting at the preceding keyframe
+    int64_t first = n, last = -1;
+    for (int64_t i = start; i < end; ++i) {
+        first = std::min(first, decode_order_[i]);
+        last = std::max(last, decode_order_[i]);
+    }
+    first = *(std::upper_bound(key_packets_.begin(), key_packets_.end(), first) - 1);
+
+    data_.clear();
+    offsets_.assign(1, 0);
+    pts_.clear();
+    dts_.clear();
+    flags_.clear();
+    frame_indices_.clear();
+    // filter state must not leak from previous range, e.g. parameter sets already emitted
+    InitBitStreamFilter();
+
+    AVStream *st = fmt_ctx_->streams[actv_stm_idx_];
+    auto rewind = [this, st]() {
+        CHECK_GE(avformat_seek_file(fmt_ctx_.get(), actv_stm_idx_, INT64_MIN, st->start_time, st->start_time, 0), 0)
+            << "Error rewinding to the beginning";
+    };
+    const PacketInfo& first_info = packets_[first];
+    int64_t ts = PacketKey(first_info.pts, first_info.dts);
+    bool rewound = first == 0 || ts == AV_NOPTS_VALUE
+        || av_seek_frame(fmt_ctx_.get(), actv_stm_idx_, ts, AVSEEK_FLAG_BACKWARD) < 0;
+    if (rewound) rewind();
+
+    AVPacketPtr packet = AVPacketPool::Get()->Acquire();
+    // packets before the keyframe are skipped, seek may land earlier than asked
+    int64_t curr = -1;
+    bool reached = false;
+    while (curr < last) {
+        int ret = av_read_frame(fmt_ctx_.get(), packet.get());
+        if (ret == AVERROR_EOF) break;
+        CHECK_GE(ret, 0) << "Error: av_read_frame failed with " << AVERROR(ret);
+        if (packet->stream_index != actv_stm_idx_) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        auto it = key_to_packet_.find(PacketKey(pts, packet->dts));
+        curr = it != key_to_packet_.end() ? it->second : curr + 1;
+        if (!reached && curr > first && !rewound) {
+            // seek landed past the keyframe, count packets from the beginning instead
+            av_packet_unref(packet.get());
+            rewind();
+            rewound = true;
+            curr = -1;
+            continue;
+        }
+        // from the beginning packets are counted, an unknown timestamp may step over the keyframe
+        reached = reached || curr == first || (rewound && curr > first);
+        if (!reached) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        if (!bsf_ctx_) {
+            AppendPacket(packet.get());
+            av_packet_unref(packet.get());
+            continue;
+        }
+        // takes ownership of packet reference
+        CHECK_GE(av_bsf_send_packet(bsf_ctx_.get(), packet.get()), 0) << "Error sending packet to BSF";
+        while (av_bsf_receive_packet(bsf_ctx_.get(), packet.get()) == 0) {
+            AppendPacket(packet.get());
+            av_packet_unref(packet.get());
+        }
+    }
+    if (bsf_ctx_) {
+        // drain
+        CHECK_GE(av_bsf_send_packet(bsf_ctx_.get(), NULL), 0) << "Error flushing BSF";
+        while (av_bsf_receive_packet(bsf_ctx_.get(), packet.get()) == 0) {
+            AppendPacket(packet.get());
+            av_packet_unref(packet.get());
+        }
+    }
+    CHECK(!pts_.empty()) << "No packet read for frame range [" << start << ", " << end << ")";
+}
+
+void PacketReader::AppendPacket(const AVPacket *packet) {
+    data_.insert(data_.end(), packet->data, packet->data + packet->size);
+    offsets_.emplace_back(static_cast<int64_t>(data_.size()));
+    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    pts_.emplace_back(pts);
+    dts_.emplace_back(packet->dts);
+    flags_.emplace_back(packet->flags);
+    auto it = pts_to_frame_.find(pts);
+    frame_indices_.emplace_back(it != pts_to_frame_.end() ? it->second : -1);
+}
+
+runtime::NDArray PacketReader::Data() const {
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(data_.size())}, kUInt8, kCPU);
+    if (!data_.empty()) std::memcpy(ret->data, data_.data(), data_.size());
+    return ret;
+}
+
+runtime::NDArray PacketReader::ToNDArray(const std::vector<int64_t>& vec) {
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(vec.size())}, kInt64, kCPU);
+    if (!vec.empty()) std::memcpy(ret->data, vec.data(), vec.size() * sizeof(int64_t));
+    return ret;
+}
+
+}  // namespace decord
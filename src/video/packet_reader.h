@@ -0,0 +1,115 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file packet_reader.h
+ * \brief Demux only reader returning compressed packets
+ */
+
+#ifndef DECORD_VIDEO_PACKET_READER_H_
+#define DECORD_VIDEO_PACKET_READER_H_
+
+#include "ffmpeg/ffmpeg_common.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <decord/base.h>
+#include <decord/runtime/ndarray.h>
+
+namespace decord {
+
+/**
+ * \brief PacketReader returns raw compressed packets of a frame range without decoding.
+ *
+ * Packets of the video stream are indexed once, frame i is the i-th packet in presentation order.
+ * A range is extended backward to the closest preceding keyframe and returned in decode order,
+ * so it can be fed to any decoder as is. Packets are optionally passed through a bitstream filter,
+ * e.g. h264_mp4toannexb for hardware decoders expecting Annex B streams.
+ */
+class PacketReader {
+    using NDArray = runtime::NDArray;
+    public:
+        /**
+         * \brief Construct a new PacketReader object
+         *
+         * \param fn Video file path
+         * \param stream_nb Video stream index, -1 for best stream
+         * \param bsf_name Bitstream filter, "auto" for mp4toannexb of H.264/HEVC in mp4 style containers, empty for none
+         */
+        PacketReader(std::string fn, int stream_nb = -1, std::string bsf_name = "");
+        /*! \brief number of frames, exact since every packet is counted */
+        int64_t GetFrameCount() const { return static_cast<int64_t>(decode_order_.size()); }
+        /*! \brief presentation indices of keyframes, ascending */
+        std::vector<int64_t> GetKeyIndices() const { return key_frames_; }
+        /*! \brief average fps of stream */
+        double GetAverageFPS() const;
+        /*! \brief codec name, e.g. h264 */
+        std::string GetCodecName() const;
+        /*! \brief stream time base of pts and dts */
+        AVRational GetTimeBase() const;
+        /*! \brief codec extradata after bitstream filter, uint8 */
+        NDArray GetExtradata() const;
+        /**
+         * \brief Read packets of frames [start, end), extended to the preceding keyframe.
+         *
+         * Results are available through Data, Offsets, PTS, DTS, Flags and FrameIndices until next read.
+         *
+         * \param start First frame, presentation order
+         * \param end One past last frame, presentation order
+         */
+        void ReadRange(int64_t start, int64_t end);
+        /*! \brief packet bytes of last range, contiguous uint8 */
+        NDArray Data() const;
+        /*! \brief int64 byte offsets of packets in Data, num_packets + 1 entries */
+        NDArray Offsets() const { return ToNDArray(offsets_); }
+        /*! \brief int64 pts of packets */
+        NDArray PTS() const { return ToNDArray(pts_); }
+        /*! \brief int64 dts of packets */
+        NDArray DTS() const { return ToNDArray(dts_); }
+        /*! \brief int64 AV_PKT_FLAG_* of packets, bit 0 is keyframe */
+        NDArray Flags() const { return ToNDArray(flags_); }
+        /*! \brief int64 presentation frame index of packets, -1 if unknown */
+        NDArray FrameIndices() const { return ToNDArray(frame_indices_); }
+
+    private:
+        /*! \brief packet entry of the index */
+        struct PacketInfo {
+            int64_t pts;
+            int64_t dts;
+            bool key;
+        };  // struct PacketInfo
+        void IndexPackets();
+        void InitBitStreamFilter();
+        void AppendPacket(const AVPacket *packet);
+        /*! \brief dts if available else pts, identifies packets after seeking */
+        static int64_t PacketKey(int64_t pts, int64_t dts) { return dts != AV_NOPTS_VALUE ? dts : pts; }
+        static NDArray ToNDArray(const std::vector<int64_t>& vec);
+
+        ffmpeg::AVFormatContextPtr fmt_ctx_;
+        int actv_stm_idx_;
+        std::string bsf_name_;
+        ffmpeg::AVBSFContextPtr bsf_ctx_;
+        /*! \brief packets in decode order */
+        std::vector<PacketInfo> packets_;
+        /*! \brief presentation index to decode index */
+        std::vector<int64_t> decode_order_;
+        /*! \brief decode index to presentation index */
+        std::vector<int64_t> present_order_;
+        /*! \brief decode indices of keyframes, ascending */
+        std::vector<int64_t> key_packets_;
+        std::vector<int64_t> key_frames_;
+        /*! \brief PacketKey to decode index */
+        std::unordered_map<int64_t, int64_t> key_to_packet_;
+        /*! \brief pts to presentation index, for packets coming out of bitstream filter */
+        std::unordered_map<int64_t, int64_t> pts_to_frame_;
+        std::vector<uint8_t> data_;
+        std::vector<int64_t> offsets_;
+        std::vector<int64_t> pts_;
+        std::vector<int64_t> dts_;
+        std::vector<int64_t> flags_;
+        std::vector<int64_t> frame_indices_;
+};  // class PacketReader
+
+}  // namespace decord
+
+#endif  // DECORD_VIDEO_PACKET_READER_H_
@@ -0,0 +1,294 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file speculative_reader.cc
+ * \brief Video reader decoding predicted frames ahead
+ */
+
+#include "speculative_reader.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+
+void AccessPredictor::Record(int64_t pos) {
+    history_.push_back(pos);
+    // two cycles of the longest period need one more position than differences
+    while (history_.size() > static_cast<std::size_t>(2 * kMaxPeriod + 1)) history_.pop_front();
+}
+
+std::vector<int64_t> AccessPredictor::Predict(int num, int64_t frame_count) const {
+    std::vector<int64_t> ret;
+    const int n = static_cast<int>(history_.size()) - 1;
+    if (n < 2 || num < 1) return ret;
+    std::vector<int64_t> diffs(n);
+    for (int i = 0; i < n; ++i) diffs[i] = history_[i + 1] - history_[i];
+    // shortest cycle seen twice in a row
+    int period = 0;
+    for (int p = 1; p <= kMaxPeriod && 2 * p <= n; ++p) {
+        if (std::equal(diffs.end() - p, diffs.end(), diffs.end() - 2 * p)) {
+            period = p;
+            break;
+        }
+    }
+    if (period == 0) return ret;
+    if (std::all_of(diffs.end() - period, diffs.end(), [](int64_t d) { return d == 0; })) {
+        // same frame over and over, nothing to decode ahead
+        return ret;
+    }
+    int64_t pos = history_.back();
+    for (int i = 0; static_cast<int>(ret.size()) < num && i < num * period; ++i) {
+        pos += diffs[n - period + i % period];
+        if (pos < 0 || pos >= frame_count) break;
+        // windows revisit positions, each is decoded once
+        if (pos == history_.back() || std::find(ret.begin(), ret.end(), pos) != ret.end()) continue;
+        ret.emplace_back(pos);
+    }
+    return ret;
+}
+
+SpeculativeVideoReader::SpeculativeVideoReader(ReaderPtr reader, int depth)
+    : reader_(std::move(reader)), depth_(std::max(1, depth)), pos_(0), generation_(0), stop_(false),
+      capacity_(static_cast<std::size_t>(depth_) * 2), cache_bytes_(0), last_use_(0) {
+    CHECK(reader_ != nullptr);
+    frame_count_ = reader_->GetFrameCount();
+    pos_ = reader_->GetCurrentPosition();
+    spec_ = reader_->Clone();
+    MemoryGovernor::Get()->Register(this, kMemoryCache);
+    thread_ = std::thread(&SpeculativeVideoReader::SpeculateLoop, this);
+}
+
+SpeculativeVideoReader::~SpeculativeVideoReader() {
+    MemoryGovernor::Get()->Unregister(this);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    MemoryGovernor::Get()->Charge(kMemoryCache, -cache_bytes_);
+}
+
+void SpeculativeVideoReader::SpeculateLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        std::vector<int64_t> plan;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            plan = plan_;
+            generation = seen = generation_;
+        }
+        for (int64_t pos : plan) {
+            {
+                // cancellation point, a wrong guess costs at most the frame in flight
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_ || generation_ != generation) break;
+                if (cache_.count(pos)) continue;
+            }
+            NDArray frame;
+            try {
+                frame = spec_->GetBatch({pos}, NDArray());
+            } catch (const dmlc::Error&) {
+                // foreground reports the error if the frame is ever requested
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                Insert(pos, frame);
+                ++stats_.decoded;
+            }
+            MemoryGovernor::Get()->Enforce();
+        }
+    }
+}
+
+void SpeculativeVideoReader::Insert(int64_t pos, NDArray frame) {
+    if (cache_.count(pos)) return;
+    cache_[pos] = {frame, false};
+    order_.push_back(pos);
+    const int64_t bytes = static_cast<int64_t>(runtime::GetDataSize(*frame.operator->()));
+    cache_bytes_ += bytes;
+    MemoryGovernor::Get()->Charge(kMemoryCache, bytes);
+    while (cache_.size() > capacity_ && !order_.empty()) EvictOldest();
+}
+
+int64_t SpeculativeVideoReader::EvictOldest() {
+    auto it = cache_.find(order_.front());
+    order_.pop_front();
+    if (it == cache_.end()) return 0;
+    if (!it->second.used) ++stats_.wasted;
+    const int64_t bytes = static_cast<int64_t>(runtime::GetDataSize(*it->second.frame.operator->()));
+    cache_.erase(it);
+    cache_bytes_ -= bytes;
+    MemoryGovernor::Get()->Charge(kMemoryCache, -bytes);
+    return bytes;
+}
+
+int64_t SpeculativeVideoReader::ReleaseMemory(int64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t released = 0;
+    while (released < bytes && !order_.empty()) released += EvictOldest();
+    if (released > 0) {
+        // speculation keeps going with fewer frames ahead
+        capacity_ = std::max<std::size_t>(1, cache_.size());
+    }
+    return released;
+}
+
+NDArray SpeculativeVideoReader::Lookup(int64_t pos) {
+    last_use_ = MemoryGovernor::Get()->Tick();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.requests;
+    auto it = cache_.find(pos);
+    if (it == cache_.end()) return NDArray();
+    // kept for repeated windows, evicted by age
+    it->second.used = true;
+    ++stats_.hits;
+    return it->second.frame;
+}
+
+void SpeculativeVideoReader::Schedule() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // never plan more than the cache holds, frames would be evicted before use
+        const int num = static_cast<int>(std::min<std::size_t>(depth_, capacity_));
+        std::vector<int64_t> predicted = predictor_.Predict(num, frame_count_);
+        std::vector<int64_t> plan;
+        for (int64_t pos : predicted) {
+            if (!cache_.count(pos)) plan.emplace_back(pos);
+        }
+        if (plan == plan_) return;
+        // pending frames that are no longer predicted at all
+        for (int64_t pos : plan_) {
+            if (!cache_.count(pos) && std::find(plan.begin(), plan.end(), pos) == plan.end()) {
+                ++stats_.cancelled;
+                break;
+            }
+        }
+        plan_.swap(plan);
+        ++generation_;
+    }
+    cv_.notify_all();
+}
+
+NDArray SpeculativeVideoReader::NextFrame() {
+    predictor_.Record(pos_);
+    NDArray cached = Lookup(pos_);
+    NDArray frame;
+    if (cached.defined()) {
+        // copy, caller may modify the frame while it stays cached
+        std::vector<int64_t> shape(cached->shape + 1, cached->shape + cached->ndim);
+        frame = NDArray::Empty(shape, cached->dtype, cached->ctx);
+        uint64_t offset = 0;
+        cached.CreateOffsetView(shape, cached->dtype, &offset).CopyTo(frame);
+    } else {
+        if (reader_->GetCurrentPosition() != pos_) reader_->SeekAccurate(pos_);
+        frame = reader_->NextFrame();
+    }
+    // end of video returns an empty array and keeps position
+    if (frame->ndim > 0) ++pos_;
+    Schedule();
+    return frame;
+}
+
+NDArray SpeculativeVideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    if (bs == 0) return reader_->GetBatch(indices, buf);
+    std::vector<NDArray> hits(bs);
+    // frames not decoded ahead are decoded together by the wrapped reader, once each
+    std::vector<int64_t> misses;
+    std::unordered_map<int64_t, int64_t> miss_row;
+    for (int64_t i = 0; i < bs; ++i) {
+        predictor_.Record(indices[i]);
+        hits[i] = Lookup(indices[i]);
+        if (!hits[i].defined() && !miss_row.count(indices[i])) {
+            miss_row[indices[i]] = static_cast<int64_t>(misses.size());
+            misses.emplace_back(indices[i]);
+        }
+    }
+    if (misses.size() == static_cast<std::size_t>(bs)) {
+        NDArray ret = reader_->GetBatch(indices, buf);
+        pos_ = reader_->GetCurrentPosition();
+        Schedule();
+        return ret;
+    }
+    NDArray decoded;
+    if (!misses.empty()) decoded = reader_->GetBatch(misses, NDArray());
+    NDArray sample = decoded.defined() ? decoded : *std::find_if(hits.begin(), hits.end(),
+                                                                [](const NDArray& a) { return a.defined(); });
+    std::vector<int64_t> frame_shape(sample->shape, sample->shape + sample->ndim);
+    frame_shape[0] = 1;
+    const uint64_t frame_bytes = sample.Size() / sample->shape[0] * ((sample->dtype.bits * sample->dtype.lanes + 7) / 8);
+    if (!buf.defined()) {
+        std::vector<int64_t> shape = frame_shape;
+        shape[0] = bs;
+        buf = NDArray::Empty(shape, sample->dtype, sample->ctx);
+    }
+    for (int64_t i = 0; i < bs; ++i) {
+        uint64_t dst_offset = i * frame_bytes;
+        NDArray dst = buf.CreateOffsetView(frame_shape, sample->dtype, &dst_offset);
+        if (hits[i].defined()) {
+            hits[i].CopyTo(dst);
+        } else {
+            uint64_t src_offset = miss_row[indices[i]] * frame_bytes;
+            decoded.CreateOffsetView(frame_shape, sample->dtype, &src_offset).CopyTo(dst);
+        }
+    }
+    pos_ = indices.back() + 1;
+    Schedule();
+    return buf;
+}
+
+void SpeculativeVideoReader::SkipFrames(int64_t num) {
+    pos_ = std::min(pos_ + std::max<int64_t>(num, 0), frame_count_);
+}
+
+bool SpeculativeVideoReader::Seek(int64_t pos) {
+    bool ret = reader_->Seek(pos);
+    pos_ = reader_->GetCurrentPosition();
+    return ret;
+}
+
+bool SpeculativeVideoReader::SeekAccurate(int64_t pos) {
+    // lazy, the frame may already be decoded ahead
+    if (pos < 0 || pos >= frame_count_) return false;
+    pos_ = pos;
+    return true;
+}
+
+int64_t SpeculativeVideoReader::GetCurrentPosition() const {
+    return pos_;
+}
+
+void SpeculativeVideoReader::SetVideoStream(int stream_nb) {
+    // clone decodes the same stream, switching would invalidate cached frames
+    CHECK(stream_nb < 0) << "SpeculativeVideoReader can not switch video stream after construction";
+}
+
+unsigned int SpeculativeVideoReader::QueryStreams() const {
+    return reader_->QueryStreams();
+}
+
+int64_t SpeculativeVideoReader::GetFrameCount() const {
+    return frame_count_;
+}
+
+NDArray SpeculativeVideoReader::GetKeyIndices() {
+    return reader_->GetKeyIndices();
+}
+
+double SpeculativeVideoReader::GetAverageFPS() const {
+    return reader_->GetAverageFPS();
+}
+
+SpeculationStats SpeculativeVideoReader::GetSpeculationStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace decord
@@ -0,0 +1,144 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file speculative_reader.h
+ * \brief Video reader decoding predicted frames ahead, implements VideoReaderInterface
+ */
+
+#ifndef DECORD_VIDEO_SPECULATIVE_READER_H_
+#define DECORD_VIDEO_SPECULATIVE_READER_H_
+
+#include "video_reader.h"
+#include "memory_governor.h"
+#include <decord/video_interface.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/**
+ * \brief AccessPredictor guesses next frame requests from recent ones.
+ *
+ * Differences of consecutive requests are matched against a repeating cycle of 1 to kMaxPeriod
+ * steps, the shortest cycle seen twice in a row wins. This covers sequential reading (cycle {1}),
+ * constant strides ({s}), and repeated windows or alternating jumps (e.g. {1, 1, 1, -3}).
+ */
+class AccessPredictor {
+    public:
+        /*! \brief longest cycle of differences detected */
+        static const int kMaxPeriod = 16;
+        void Record(int64_t pos);
+        /*! \brief up to num next distinct positions in [0, frame_count), empty if no pattern */
+        std::vector<int64_t> Predict(int num, int64_t frame_count) const;
+
+    private:
+        std::deque<int64_t> history_;
+};  // class AccessPredictor
+
+/*! \brief counters of speculative decoding, see SpeculativeVideoReader */
+struct SpeculationStats {
+    /*! \brief frames requested */
+    int64_t requests = 0;
+    /*! \brief requests served by frames decoded ahead */
+    int64_t hits = 0;
+    /*! \brief frames decoded ahead */
+    int64_t decoded = 0;
+    /*! \brief frames decoded ahead and evicted before use */
+    int64_t wasted = 0;
+    /*! \brief predictions dropped before completion since requests changed pattern */
+    int64_t cancelled = 0;
+};  // struct SpeculationStats
+
+/**
+ * \brief SpeculativeVideoReader anticipates patterned access (e.g. vr[i] in a strided loop).
+ *
+ * Requests go to the wrapped reader, and are recorded by an AccessPredictor. When a pattern is
+ * found, the predicted frames are decoded on a background thread by a clone of the reader, so
+ * the foreground decoder position is never disturbed, and kept in a small frame cache consulted
+ * before decoding. A new prediction replaces the pending one, the background thread checks for it
+ * between frames, so a wrong guess costs at most one frame. Seeks are lazy, the wrapped reader only
+ * moves when a frame has to be decoded in the foreground. The cache is charged to the memory governor,
+ * which may evict frames and shrink it.
+ */
+class SpeculativeVideoReader : public VideoReaderInterface, public MemoryConsumer {
+    using NDArray = runtime::NDArray;
+    using ReaderPtr = std::unique_ptr<VideoReader>;
+    public:
+        /**
+         * \brief Construct a new SpeculativeVideoReader object
+         *
+         * \param reader Reader serving foreground requests, owned
+         * \param depth Number of predicted frames decoded ahead, cache keeps twice as many
+         */
+        SpeculativeVideoReader(ReaderPtr reader, int depth);
+        ~SpeculativeVideoReader();
+        /*! \brief stream is fixed at construction, only the current stream is accepted */
+        void SetVideoStream(int stream_nb = -1);
+        unsigned int QueryStreams() const;
+        int64_t GetFrameCount() const;
+        int64_t GetCurrentPosition() const;
+        NDArray NextFrame();
+        NDArray GetBatch(std::vector<int64_t> indices, NDArray buf);
+        void SkipFrames(int64_t num = 1);
+        bool Seek(int64_t pos);
+        bool SeekAccurate(int64_t pos);
+        NDArray GetKeyIndices();
+        double GetAverageFPS() const;
+        SpeculationStats GetSpeculationStats() const;
+        /*! \brief wrapped reader serving foreground requests */
+        VideoReader* GetReader() const { return reader_.get(); }
+        /*! \brief evict oldest cached frames, cache capacity is lowered to what is left */
+        int64_t ReleaseMemory(int64_t bytes);
+        int64_t LastUse() const { return last_use_.load(); }
+
+    private:
+        /*! \brief frame decoded ahead, [1, H, W, C] */
+        struct CachedFrame {
+            NDArray frame;
+            bool used;
+        };  // struct CachedFrame
+        /*! \brief cached frame at pos, undefined if not decoded ahead */
+        NDArray Lookup(int64_t pos);
+        /*! \brief predict from history and replace pending prediction if it changed */
+        void Schedule();
+        void SpeculateLoop();
+        /*! \brief add to cache and evict oldest frames beyond capacity, call with mutex_ held */
+        void Insert(int64_t pos, NDArray frame);
+        /*! \brief evict oldest frame, call with mutex_ held, returns bytes freed */
+        int64_t EvictOldest();
+
+        ReaderPtr reader_;
+        /*! \brief background cursor, clone of reader_ */
+        ReaderPtr spec_;
+        int depth_;
+        int64_t frame_count_;
+        /*! \brief logical position, reader_ catches up lazily */
+        int64_t pos_;
+        AccessPredictor predictor_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+        /*! \brief pending prediction and its generation, bumped on every change */
+        std::vector<int64_t> plan_;
+        uint64_t generation_;
+        bool stop_;
+        std::map<int64_t, CachedFrame> cache_;
+        /*! \brief cached positions in insertion order */
+        std::deque<int64_t> order_;
+        /*! \brief max cached frames, twice the depth unless shrunk by the memory governor */
+        std::size_t capacity_;
+        /*! \brief bytes of cached frames, charged to the memory governor */
+        int64_t cache_bytes_;
+        std::atomic<int64_t> last_use_;
+        SpeculationStats stats_;
+};  // class SpeculativeVideoReader
+}  // namespace decord
+#endif  // DECORD_VIDEO_SPECULATIVE_READER_H_
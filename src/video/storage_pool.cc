@@ -6,57 +6,111 @@
 
 #include "storage_pool.h"
 
+#include <algorithm>
+
 namespace decord {
 
-NDArrayPool::NDArrayPool() : init_(false) {
+NDArrayPool::NDArrayPool() : init_(false), state_(std::make_shared<State>()) {
 
 }
 
 NDArrayPool::NDArrayPool(std::size_t sz, std::vector<int64_t> shape, DLDataType dtype, DLContext ctx)
-    : size_(sz), shape_(shape), dtype_(dtype), ctx_(ctx), init_(true) {
+    : init_(false), state_(std::make_shared<State>()) {
+    Init(sz, shape, dtype, ctx);
+}
+
+void NDArrayPool::Init(std::size_t sz, std::vector<int64_t> shape, DLDataType dtype, DLContext ctx) {
+    bool registered;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        // queued and outstanding arrays may have another shape
+        Trim(0);
+        ++state_->generation;
+        state_->size = sz;
+        shape_ = shape;
+        dtype_ = dtype;
+        ctx_ = ctx;
+        state_->bytes = (dtype.bits * dtype.lanes + 7) / 8;
+        for (auto dim : shape) state_->bytes *= dim;
+        registered = init_;
+        init_ = true;
+    }
+    if (!registered) MemoryGovernor::Get()->Register(this, kMemoryPool);
 }
 
 NDArrayPool::~NDArrayPool() {
-    while (queue_.size() > 0) {
-        auto arr = queue_.front();
-        queue_.pop();
+    if (init_) MemoryGovernor::Get()->Unregister(this);
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    // outstanding arrays are freed by Deleter from now on
+    state_->alive = false;
+    Trim(0);
+}
+
+int64_t NDArrayPool::Trim(std::size_t num) {
+    int64_t freed = 0;
+    while (state_->queue.size() > num) {
+        auto arr = state_->queue.front();
+        state_->queue.pop();
+        // freed by the default path of Deleter once arr goes out of scope
+        delete static_cast<Handle*>(arr.data_->manager_ctx);
         arr.data_->manager_ctx = nullptr;
+        freed += state_->bytes;
     }
+    if (freed > 0) MemoryGovernor::Get()->Charge(kMemoryPool, -freed);
+    return freed;
+}
+
+int64_t NDArrayPool::ReleaseMemory(int64_t bytes) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    const int64_t array_bytes = state_->bytes;
+    if (array_bytes <= 0) return 0;
+    std::size_t num = static_cast<std::size_t>((bytes + array_bytes - 1) / array_bytes);
+    std::size_t keep = state_->queue.size() > num ? state_->queue.size() - num : 0;
+    // arrays returned later are freed instead of queued
+    state_->size = std::min(state_->size, keep);
+    return Trim(keep);
 }
 
 runtime::NDArray NDArrayPool::Acquire() {
     CHECK(init_) << "NDArrayPool not initialized with shape and ctx";
-    if (queue_.size() > 0) {
-        auto arr = queue_.front();
-        queue_.pop();
-        return arr;
-    } else {
-        // Allocate
-        auto arr = NDArray::Empty(shape_, dtype_, ctx_);
-        arr.data_->manager_ctx = this;
-        arr.data_->deleter = &NDArrayPool::Deleter;
-        return arr;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->queue.size() > 0) {
+            auto arr = state_->queue.front();
+            state_->queue.pop();
+            MemoryGovernor::Get()->Charge(kMemoryPool, -state_->bytes);
+            return arr;
+        }
+        generation = state_->generation;
     }
+    // Allocate
+    auto arr = NDArray::Empty(shape_, dtype_, ctx_);
+    arr.data_->manager_ctx = new Handle{state_, generation};
+    arr.data_->deleter = &NDArrayPool::Deleter;
+    return arr;
 }
 
 void NDArrayPool::Deleter(NDArray::Container* ptr) {
     if (!ptr) return;
-    if (ptr->manager_ctx != nullptr) {
-        auto pool = static_cast<NDArrayPool*>(ptr->manager_ctx);
-        if (pool->size_ <= pool->queue_.size()) {
-            decord::runtime::DeviceAPI::Get(ptr->dl_tensor.ctx)->FreeDataSpace(
-          ptr->dl_tensor.ctx, ptr->dl_tensor.data);
-            delete ptr;
-            ptr = nullptr;
-        } else {
-            static_cast<NDArrayPool*>(ptr->manager_ctx)->queue_.push(NDArray(ptr));
+    auto handle = static_cast<Handle*>(ptr->manager_ctx);
+    if (handle != nullptr) {
+        State* state = handle->state.get();
+        // no Enforce here, arrays are released under arbitrary locks
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->alive && handle->generation == state->generation && state->queue.size() < state->size) {
+            state->queue.push(NDArray(ptr));
+            MemoryGovernor::Get()->Charge(kMemoryPool, state->bytes);
+            return;
         }
-    } else if (ptr->dl_tensor.data != nullptr) {
+    }
+    // may drop the last reference to a destroyed pool's state, so only after unlock
+    delete handle;
+    if (ptr->dl_tensor.data != nullptr) {
         decord::runtime::DeviceAPI::Get(ptr->dl_tensor.ctx)->FreeDataSpace(
           ptr->dl_tensor.ctx, ptr->dl_tensor.data);
-        delete ptr;
-        ptr = nullptr;
     }
+    delete ptr;
 }
 
 }  // namespace decord
@@ -7,6 +7,10 @@
 #ifndef DECORD_VIDEO_STORAGE_POOL_H_
 #define DECORD_VIDEO_STORAGE_POOL_H_
 
+#include "memory_governor.h"
+
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <vector>
 
@@ -100,23 +104,55 @@ class AutoReleasePool {
     DISALLOW_COPY_AND_ASSIGN(AutoReleasePool);
 };
 
-class NDArrayPool {
+/**
+ * \brief Pool of same shaped arrays, released arrays are queued for reuse up to pool size.
+ *
+ * Queued arrays are charged to the memory governor, which may free them and shrink the pool.
+ * Arrays may outlive the pool (e.g. frames handed to users), they share its state and are
+ * simply freed once the pool is gone or re-initialized with another shape.
+ */
+class NDArrayPool : public MemoryConsumer {
     using NDArray = runtime::NDArray;
     public:
         NDArrayPool();
         NDArrayPool(std::size_t sz, std::vector<int64_t> shape, DLDataType dtype, DLContext ctx);
+        /*! \brief set size, shape and context, queued arrays are freed */
+        void Init(std::size_t sz, std::vector<int64_t> shape, DLDataType dtype, DLContext ctx);
         NDArray Acquire();
         ~NDArrayPool();
         static void Deleter(NDArray::Container* ptr);
         // static void DefaultDeleter(NDArray::Container* ptr);
+        /*! \brief free queued arrays, pool size is lowered to what is left */
+        int64_t ReleaseMemory(int64_t bytes);
 
     private:
-        std::size_t size_;
+        /*! \brief queue and size, shared with allocated arrays */
+        struct State {
+            /*! \brief guards all fields, arrays are returned from any thread */
+            std::mutex mutex;
+            std::queue<runtime::NDArray> queue;
+            std::size_t size = 0;
+            /*! \brief bytes of one array */
+            int64_t bytes = 0;
+            /*! \brief bumped by Init, arrays of older generations are not queued */
+            uint64_t generation = 0;
+            /*! \brief false once the pool is destroyed */
+            bool alive = true;
+        };  // struct State
+        /*! \brief manager_ctx of allocated arrays */
+        struct Handle {
+            std::shared_ptr<State> state;
+            uint64_t generation;
+        };  // struct Handle
+        /*! \brief free queued arrays beyond num, call with state mutex held, returns bytes freed */
+        int64_t Trim(std::size_t num);
         std::vector<int64_t> shape_;
         DLDataType dtype_;
         DLContext ctx_;
-        std::queue<runtime::NDArray> queue_;
         bool init_;
+        std::shared_ptr<State> state_;
+
+    DISALLOW_COPY_AND_ASSIGN(NDArrayPool);
 };  // NDArrayPool
 
 }  // namespace decord
@@ -0,0 +1,185 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file thread_safe_reader.cc
+ * \brief Video reader safe for concurrent use
+ */
+
+#include "thread_safe_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+
+ThreadSafeVideoReader::ThreadSafeVideoReader(std::string fn, DLContext ctx, int width, int height,
+                                             FrameOptions opts, int max_cursors, bool park)
+    : proto_(nullptr), max_cursors_(max_cursors), park_(park), num_cursors_(1), use_clock_(0) {
+    if (max_cursors_ < 1) {
+        max_cursors_ = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    CursorPtr first(new VideoReader(fn, ctx, width, height, opts));
+    proto_ = first.get();
+    frame_count_ = first->GetFrameCount();
+    first->GetKeyIndices().CopyTo(key_indices_);
+    avg_fps_ = first->GetAverageFPS();
+    idle_.push_back({std::move(first), 0});
+    stats_.opened = 1;
+}
+
+ThreadSafeVideoReader::~ThreadSafeVideoReader() {
+    // clones do not refer to the prototype, cursors can go in any order
+}
+
+int64_t ThreadSafeVideoReader::ForwardDistance(int64_t curr, int64_t pos) const {
+    if (curr > pos) return -1;
+    // VideoReader seeks whenever a keyframe lies between current position and target
+    auto it = std::upper_bound(key_indices_.begin(), key_indices_.end(), pos);
+    int64_t key = it == key_indices_.begin() ? 0 : *(it - 1);
+    return key <= curr ? pos - curr : -1;
+}
+
+ThreadSafeVideoReader::CursorPtr ThreadSafeVideoReader::Acquire(int64_t pos) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++stats_.requests;
+    while (true) {
+        // cheapest reachable idle cursor, and the least recently used one as fallback
+        int best = -1, lru = -1;
+        int64_t best_dist = -1;
+        for (std::size_t i = 0; i < idle_.size(); ++i) {
+            int64_t dist = ForwardDistance(idle_[i].reader->GetCurrentPosition(), pos);
+            if (dist >= 0 && (best < 0 || dist < best_dist)) {
+                best = static_cast<int>(i);
+                best_dist = dist;
+            }
+            if (lru < 0 || idle_[i].last_use < idle_[lru].last_use) lru = static_cast<int>(i);
+        }
+        bool can_open = num_cursors_ < max_cursors_;
+        // a cursor that never served a request is not parked anywhere yet
+        bool unused = lru >= 0 && idle_[lru].last_use == 0;
+        if (best < 0 && lru >= 0 && (unused || !(park_ && can_open))) {
+            best = lru;
+            ++stats_.seeks;
+            if (park_ && !unused) ++stats_.recycled;
+        } else if (best >= 0) {
+            ++stats_.hits;
+        }
+        if (best >= 0) {
+            CursorPtr cursor = std::move(idle_[best].reader);
+            idle_.erase(idle_.begin() + best);
+            return cursor;
+        }
+        if (can_open) {
+            ++num_cursors_;
+            ++stats_.opened;
+            // new cursor starts at frame 0
+            if (ForwardDistance(0, pos) >= 0) {
+                ++stats_.hits;
+            } else {
+                ++stats_.seeks;
+            }
+            lock.unlock();
+            // opening the file is slow, other threads may acquire and release meanwhile
+            try {
+                return proto_->Clone();
+            } catch (...) {
+                std::lock_guard<std::mutex> relock(mutex_);
+                --num_cursors_;
+                cv_.notify_one();
+                throw;
+            }
+        }
+        cv_.wait(lock);
+    }
+}
+
+void ThreadSafeVideoReader::Release(CursorPtr cursor) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back({std::move(cursor), ++use_clock_});
+    }
+    cv_.notify_one();
+}
+
+VideoReader* ThreadSafeVideoReader::SequentialCursor() {
+    // not taken from the pool, sequential access never starves GetBatch
+    if (!seq_cursor_) seq_cursor_ = proto_->Clone();
+    return seq_cursor_.get();
+}
+
+int ThreadSafeVideoReader::NumCursors() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_cursors_;
+}
+
+CursorStats ThreadSafeVideoReader::GetCursorStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+NDArray ThreadSafeVideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    // frames are decoded in given order, the first one decides the seek
+    int64_t pos = indices.empty() ? 0 : indices[0];
+    CursorPtr cursor = Acquire(pos);
+    NDArray ret;
+    try {
+        ret = cursor->GetBatch(indices, buf);
+    } catch (...) {
+        Release(std::move(cursor));
+        throw;
+    }
+    Release(std::move(cursor));
+    return ret;
+}
+
+void ThreadSafeVideoReader::SetVideoStream(int stream_nb) {
+    // cursors share the index of one stream, switching would require reindexing all of them
+    CHECK(stream_nb < 0) << "ThreadSafeVideoReader can not switch video stream after construction";
+}
+
+unsigned int ThreadSafeVideoReader::QueryStreams() const {
+    return proto_->QueryStreams();
+}
+
+int64_t ThreadSafeVideoReader::GetFrameCount() const {
+    return frame_count_;
+}
+
+NDArray ThreadSafeVideoReader::GetKeyIndices() {
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(key_indices_.size())}, kInt64, kCPU);
+    if (!key_indices_.empty()) std::memcpy(ret->data, key_indices_.data(), key_indices_.size() * sizeof(int64_t));
+    return ret;
+}
+
+double ThreadSafeVideoReader::GetAverageFPS() const {
+    return avg_fps_;
+}
+
+int64_t ThreadSafeVideoReader::GetCurrentPosition() const {
+    std::lock_guard<std::mutex> lock(seq_mutex_);
+    return seq_cursor_ ? seq_cursor_->GetCurrentPosition() : 0;
+}
+
+NDArray ThreadSafeVideoReader::NextFrame() {
+    std::lock_guard<std::mutex> lock(seq_mutex_);
+    return SequentialCursor()->NextFrame();
+}
+
+void ThreadSafeVideoReader::SkipFrames(int64_t num) {
+    std::lock_guard<std::mutex> lock(seq_mutex_);
+    SequentialCursor()->SkipFrames(num);
+}
+
+bool ThreadSafeVideoReader::Seek(int64_t pos) {
+    std::lock_guard<std::mutex> lock(seq_mutex_);
+    return SequentialCursor()->Seek(pos);
+}
+
+bool ThreadSafeVideoReader::SeekAccurate(int64_t pos) {
+    std::lock_guard<std::mutex> lock(seq_mutex_);
+    return SequentialCursor()->SeekAccurate(pos);
+}
+
+}  // namespace decord
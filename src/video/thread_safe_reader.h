@@ -0,0 +1,116 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file thread_safe_reader.h
+ * \brief Video reader safe for concurrent use, implements VideoReaderInterface
+ */
+
+#ifndef DECORD_VIDEO_THREAD_SAFE_READER_H_
+#define DECORD_VIDEO_THREAD_SAFE_READER_H_
+
+#include "video_reader.h"
+#include <decord/video_interface.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <decord/base.h>
+
+namespace decord {
+
+/*! \brief counters of cursor routing, see ThreadSafeVideoReader */
+struct CursorStats {
+    /*! \brief number of GetBatch calls */
+    int64_t requests = 0;
+    /*! \brief requests served by decoding forward within the GOP of a cursor, no seek */
+    int64_t hits = 0;
+    /*! \brief requests that needed a seek */
+    int64_t seeks = 0;
+    /*! \brief cursors opened, including the first one */
+    int64_t opened = 0;
+    /*! \brief parked cursors moved to another region, least recently used first */
+    int64_t recycled = 0;
+};  // struct CursorStats
+
+/**
+ * \brief ThreadSafeVideoReader serves concurrent GetBatch calls on one file.
+ *
+ * The file is opened and indexed once, frame count, keyframes and fps are cached. Every GetBatch
+ * borrows a cursor (a VideoReader with its own demuxer and decoder) from a small pool, cursors are
+ * cloned from the first one on demand without scanning the file again. Sequential access
+ * (NextFrame, Seek, ...) uses one dedicated cursor outside the pool, guarded by its own lock.
+ *
+ * Requests are routed to the idle cursor reaching the first frame most cheaply, i.e. decoding forward
+ * within its GOP, otherwise the least recently used cursor seeks. With parking enabled, cursors are
+ * cloned up to the limit before any is recycled, so they stay parked in the regions the workload
+ * alternates between (e.g. several annotated events of a long video).
+ */
+class ThreadSafeVideoReader : public VideoReaderInterface {
+    using NDArray = runtime::NDArray;
+    using CursorPtr = std::unique_ptr<VideoReader>;
+    public:
+        /**
+         * \brief Construct a new ThreadSafeVideoReader object
+         *
+         * \param fn Video file path
+         * \param ctx Decoding context
+         * \param width Output width, -1 for original
+         * \param height Output height, -1 for original
+         * \param opts Frame conversion options
+         * \param max_cursors Max number of cursors, i.e. concurrent GetBatch calls, 0 for hardware concurrency
+         * \param park Open a new cursor rather than moving a parked one while below max_cursors
+         */
+        ThreadSafeVideoReader(std::string fn, DLContext ctx, int width=-1, int height=-1,
+                              FrameOptions opts=FrameOptions(), int max_cursors=4, bool park=false);
+        ~ThreadSafeVideoReader();
+        /*! \brief stream is fixed at construction, only the current stream is accepted */
+        void SetVideoStream(int stream_nb = -1);
+        unsigned int QueryStreams() const;
+        int64_t GetFrameCount() const;
+        int64_t GetCurrentPosition() const;
+        NDArray NextFrame();
+        NDArray GetBatch(std::vector<int64_t> indices, NDArray buf);
+        void SkipFrames(int64_t num = 1);
+        bool Seek(int64_t pos);
+        bool SeekAccurate(int64_t pos);
+        NDArray GetKeyIndices();
+        double GetAverageFPS() const;
+        /*! \brief number of cursors created so far */
+        int NumCursors() const;
+        /*! \brief routing counters */
+        CursorStats GetCursorStats() const;
+
+    private:
+        /*! \brief pooled cursor with access clock for LRU */
+        struct Cursor {
+            CursorPtr reader;
+            uint64_t last_use;
+        };  // struct Cursor
+        /*! \brief frames to decode from position curr to reach pos, negative if a seek is needed */
+        int64_t ForwardDistance(int64_t curr, int64_t pos) const;
+        /*! \brief cheapest idle cursor, a new clone, the LRU idle cursor, or wait for a release */
+        CursorPtr Acquire(int64_t pos);
+        void Release(CursorPtr cursor);
+        /*! \brief lazily created cursor of sequential access, call with seq_mutex_ held */
+        VideoReader* SequentialCursor();
+
+        /*! \brief prototype of clones, first cursor, settings are never modified */
+        const VideoReader *proto_;
+        int max_cursors_;
+        bool park_;
+        int64_t frame_count_;
+        std::vector<int64_t> key_indices_;
+        double avg_fps_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<Cursor> idle_;
+        int num_cursors_;
+        uint64_t use_clock_;
+        CursorStats stats_;
+        mutable std::mutex seq_mutex_;
+        CursorPtr seq_cursor_;
+};  // class ThreadSafeVideoReader
+}  // namespace decord
+#endif  // DECORD_VIDEO_THREAD_SAFE_READER_H_
@@ -8,13 +8,46 @@
 #define DECORD_VIDEO_THREADED_DECODER_INTERFACE_H_
 
 #include "ffmpeg/ffmpeg_common.h"
+#include "../improc/crop_detect.h"
 #include <vector>
 #include <decord/runtime/ndarray.h>
 
 namespace decord {
+/*! \brief Deinterlacing applied to frames flagged as interlaced */
+enum DeinterlaceMode {
+    kDeinterlaceNone = 0,  // keep frames untouched
+    kDeinterlaceField,     // keep top field only, halves vertical conversion work
+    kDeinterlaceBlend,     // linear blend of neighbouring lines
+};  // enum DeinterlaceMode
+
+/*! \brief Conversion options applied to decoded frames */
+struct FrameOptions {
+    /*! \brief output pixel format, see ffmpeg::IsSupportedPixelFormat */
+    AVPixelFormat pix_fmt;
+    /*! \brief map HDR10(PQ)/HLG sources to SDR, requires RGB24 output */
+    bool tone_mapping;
+    /*! \brief apply stream display matrix, resolved into rotation and hflip by reader */
+    bool autorotate;
+    /*! \brief clockwise rotation in degrees, output width/height are in rotated orientation */
+    int rotation;
+    /*! \brief mirror horizontally before rotation */
+    bool hflip;
+    /*! \brief detect black borders once per video, resolved into crop by reader */
+    bool crop_detect;
+    /*! \brief area of decoded frame to keep before scaling, empty means full frame */
+    improc::CropRect crop;
+    /*! \brief deinterlacing mode, progressive frames are not affected */
+    DeinterlaceMode deinterlace;
+
+    FrameOptions() : pix_fmt(AV_PIX_FMT_RGB24), tone_mapping(false), autorotate(true),
+                     rotation(0), hflip(false), crop_detect(false), crop(),
+                     deinterlace(kDeinterlaceNone) {}
+};  // struct FrameOptions
+
 class ThreadedDecoderInterface {
     public:
-        virtual void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1) = 0;
+        virtual void SetCodecContext(AVCodecContext *dec_ctx, int width = -1, int height = -1,
+                                     FrameOptions opts = FrameOptions()) = 0;
         virtual void Start() = 0;
         virtual void Stop() = 0;
         virtual void Clear() = 0;
@@ -24,6 +57,8 @@ class ThreadedDecoderInterface {
         virtual bool Pop(runtime::NDArray *frame) = 0;
         // virtual bool Pop(ffmpeg::AVFramePtr *frame) = 0;
         virtual void SuggestDiscardPTS(std::vector<int64_t> dts) = 0;
+        /*! \brief number of packets that failed to decode and were concealed */
+        virtual int64_t GetErrorCount() const { return 0; }
         virtual ~ThreadedDecoderInterface() = default;
 };  // class ThreadedDecoderInterface
 
@@ -6,6 +6,18 @@
 
 #include "video_reader.h"
 #include "video_loader.h"
+#include "multi_stream_reader.h"
+#include "image_sequence_reader.h"
+#include "concat_reader.h"
+#include "clip_dataset.h"
+#include "video_writer.h"
+#include "packet_reader.h"
+#include "thread_safe_reader.h"
+#include "speculative_reader.h"
+#include "memory_governor.h"
+#include "../improc/optical_flow.h"
+#include "../improc/frame_diff.h"
+#include "../runtime/parallel_util.h"
 #include "../runtime/str_util.h"
 
 #include <decord/video_interface.h>
@@ -13,8 +25,18 @@
 
 
 #include <dlpack/dlpack.h>
+#include <dmlc/concurrency.h>
 #include <dmlc/logging.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
 namespace decord {
 
 VideoReaderPtr GetVideoReader(std::string fn, DLContext ctx) {
@@ -23,6 +45,371 @@ VideoReaderPtr GetVideoReader(std::string fn, DLContext ctx) {
     return ptr;
 }
 
+/*! \brief VideoReader behind handle, unwrapping speculation, nullptr for other readers */
+static VideoReader* AsVideoReader(VideoReaderInterface *reader) {
+    if (auto spec = dynamic_cast<SpeculativeVideoReader*>(reader)) return spec->GetReader();
+    return dynamic_cast<VideoReader*>(reader);
+}
+
+/**
+ * \brief Dense flow from frames[i] to frame indices[i] + stride (clamped to last frame).
+ *
+ * Partner frames already in the batch are reused, the rest are decoded in one GetBatch.
+ * Luma planes and flow pairs are processed in parallel on the runtime thread pool.
+ *
+ * \return Quantized flow, [N, H / downscale, W / downscale, 2] uint8
+ */
+runtime::NDArray GetBatchFlow(VideoReaderInterface *reader, const std::vector<int64_t>& indices,
+                              runtime::NDArray frames, int stride, int downscale, float bound) {
+    using NDArray = runtime::NDArray;
+    CHECK_GT(stride, 0) << "Invalid flow stride: " << stride;
+    CHECK_GT(downscale, 0) << "Invalid flow downscale: " << downscale;
+    CHECK_GT(bound, 0) << "Invalid flow bound: " << bound;
+    CHECK(frames->ctx.device_type == kDLCPU) << "Optical flow requires frames in CPU memory";
+    CHECK(frames->ndim == 4 && frames->shape[3] == 3 && frames->dtype.code == kDLUInt && frames->dtype.bits == 8)
+        << "Optical flow requires rgb24 frames";
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    CHECK_EQ(frames->shape[0], bs) << "Frames and indices size mismatch";
+    const int height = static_cast<int>(frames->shape[1]);
+    const int width = static_cast<int>(frames->shape[2]);
+    const int fh = height / downscale, fw = width / downscale;
+    CHECK(fh > 0 && fw > 0) << "Downscale " << downscale << " too large for " << width << "x" << height;
+
+    // luma planes: batch frames first, then partners not in batch
+    std::unordered_map<int64_t, int64_t> plane_of;
+    for (int64_t i = 0; i < bs; ++i) plane_of.emplace(indices[i], i);
+    const int64_t last = reader->GetFrameCount() - 1;
+    std::vector<int64_t> partners(bs), missing;
+    for (int64_t i = 0; i < bs; ++i) {
+        partners[i] = std::min(indices[i] + stride, last);
+        if (plane_of.emplace(partners[i], bs + static_cast<int64_t>(missing.size())).second) {
+            missing.emplace_back(partners[i]);
+        }
+    }
+    NDArray extra;
+    if (!missing.empty()) extra = reader->GetBatch(missing, NDArray());
+    const int64_t frame_bytes = static_cast<int64_t>(height) * width * 3;
+    const int64_t plane_size = static_cast<int64_t>(fh) * fw;
+    const int64_t num_planes = bs + static_cast<int64_t>(missing.size());
+    std::vector<float> luma(num_planes * plane_size);
+    runtime::ParallelFor(num_planes, [&](int64_t p) {
+        const uint8_t *src = p < bs
+            ? static_cast<const uint8_t*>(frames->data) + frames->byte_offset + p * frame_bytes
+            : static_cast<const uint8_t*>(extra->data) + extra->byte_offset + (p - bs) * frame_bytes;
+        improc::RGBToLuma(src, width * 3, width, height, downscale, luma.data() + p * plane_size);
+    });
+
+    NDArray flow = NDArray::Empty({bs, fh, fw, 2}, kUInt8, kCPU);
+    uint8_t *out = static_cast<uint8_t*>(flow->data) + flow->byte_offset;
+    runtime::ParallelFor(bs, [&](int64_t i) {
+        std::vector<float> pair_flow(plane_size * 2);
+        improc::DenseFlow(luma.data() + plane_of.at(indices[i]) * plane_size,
+                          luma.data() + plane_of.at(partners[i]) * plane_size, fw, fh, pair_flow.data());
+        improc::QuantizeFlow(pair_flow.data(), plane_size * 2, bound, out + i * plane_size * 2);
+    });
+    return flow;
+}
+
+/**
+ * \brief Differences against previous frames, f(i - j) - f(i - j - 1) for j in [0, num_diff).
+ *
+ * Indices are visited in ascending order with a ring of the last num_diff + 1 decoded frames,
+ * each difference is computed right after its frames are decoded while they are still in cache.
+ * Frames before the first frame are clamped to frame 0.
+ *
+ * \return [N, num_diff, H, W, 3] differences of the given type
+ */
+runtime::NDArray GetBatchDiff(VideoReaderInterface *reader, const std::vector<int64_t>& indices,
+                              int num_diff, improc::DiffType type) {
+    using NDArray = runtime::NDArray;
+    CHECK_GT(num_diff, 0) << "Invalid number of differences: " << num_diff;
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    CHECK_GT(bs, 0) << "Empty indices";
+    const int64_t ring_size = num_diff + 1;
+    std::vector<int64_t> order(bs);
+    for (int64_t i = 0; i < bs; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) { return indices[a] < indices[b]; });
+
+    NDArray ring, out;
+    std::vector<int64_t> ring_frame(ring_size, -1);
+    std::vector<int64_t> frame_shape;
+    int64_t frame_bytes = 0;
+    DLDataType out_dtype = type == improc::kDiffInt16 ? kInt16 : (type == improc::kDiffInt8 ? kInt8 : kFloat32);
+    for (int64_t pos : order) {
+        const int64_t idx = indices[pos];
+        for (int64_t f = std::max(idx - num_diff, static_cast<int64_t>(0)); f <= idx; ++f) {
+            const int64_t slot = f % ring_size;
+            if (ring_frame[slot] == f) continue;
+            if (!ring.defined()) {
+                NDArray first = reader->GetBatch({f}, NDArray());
+                CHECK(first->ctx.device_type == kDLCPU) << "Frame difference requires CPU decoding";
+                CHECK(first->dtype.code == kDLUInt && first->dtype.bits == 8) << "Frame difference requires 8bit frames";
+                frame_shape.assign(first->shape + 1, first->shape + first->ndim);
+                frame_bytes = first.Size();
+                std::vector<int64_t> ring_shape = {ring_size};
+                ring_shape.insert(ring_shape.end(), frame_shape.begin(), frame_shape.end());
+                ring = NDArray::Empty(ring_shape, first->dtype, kCPU);
+                std::vector<int64_t> out_shape = {bs, num_diff};
+                out_shape.insert(out_shape.end(), frame_shape.begin(), frame_shape.end());
+                out = NDArray::Empty(out_shape, out_dtype, kCPU);
+                uint64_t offset = slot * frame_bytes;
+                first.CopyTo(ring.CreateOffsetView(frame_shape, first->dtype, &offset));
+            } else {
+                // ascending visit order, the reader mostly moves forward
+                uint64_t offset = slot * frame_bytes;
+                reader->GetBatch({f}, ring.CreateOffsetView(frame_shape, ring->dtype, &offset));
+            }
+            ring_frame[slot] = f;
+        }
+        const uint8_t *base = static_cast<const uint8_t*>(ring->data) + ring->byte_offset;
+        uint8_t *dst = static_cast<uint8_t*>(out->data) + out->byte_offset;
+        for (int j = 0; j < num_diff; ++j) {
+            const int64_t later = std::max(idx - j, static_cast<int64_t>(0));
+            const int64_t earlier = std::max(idx - j - 1, static_cast<int64_t>(0));
+            improc::FrameDiff(base + (later % ring_size) * frame_bytes, base + (earlier % ring_size) * frame_bytes,
+                              frame_bytes, type, dst + (pos * num_diff + j) * frame_bytes * (out_dtype.bits / 8));
+        }
+    }
+    return out;
+}
+
+/**
+ * \brief GetBatch of several readers at once, concatenated along the batch axis.
+ *
+ * Readers are decoded concurrently on the runtime thread pool, entries sharing a reader are
+ * decoded in order by the same task. Readers parallelizing their own GetBatch, i.e.
+ * ImageSequenceReader and MultiStreamVideoReader, run it serially inside their task.
+ * With a preallocated buffer every reader decodes straight into its slice of it, otherwise
+ * per reader batches are stacked after decoding.
+ *
+ * \return [sum of len(indices[i]), H, W, C] frames
+ */
+runtime::NDArray GetBatchMulti(const std::vector<VideoReaderInterface*>& readers,
+                               const std::vector<std::vector<int64_t> >& indices, runtime::NDArray buf) {
+    using NDArray = runtime::NDArray;
+    CHECK_EQ(readers.size(), indices.size());
+    const std::size_t num = readers.size();
+    int64_t total = 0;
+    for (const auto& idx : indices) total += static_cast<int64_t>(idx.size());
+    CHECK_GT(total, 0) << "Empty indices";
+    // group entries by reader, a reader must not be used by two tasks at the same time
+    std::vector<std::vector<std::size_t> > groups;
+    std::unordered_map<VideoReaderInterface*, std::size_t> group_of;
+    for (std::size_t i = 0; i < num; ++i) {
+        CHECK(readers[i]) << "Invalid reader handle at " << i;
+        if (indices[i].empty()) continue;
+        auto it = group_of.find(readers[i]);
+        if (it == group_of.end()) {
+            it = group_of.emplace(readers[i], groups.size()).first;
+            groups.emplace_back();
+        }
+        groups[it->second].emplace_back(i);
+    }
+
+    std::vector<NDArray> outs(num);
+    if (buf.defined()) {
+        CHECK_EQ(buf->shape[0], total) << "Output buffer holds " << buf->shape[0] << " frames, " << total << " requested";
+        std::vector<int64_t> frame_shape(buf->shape + 1, buf->shape + buf->ndim);
+        uint64_t offset = 0;
+        for (std::size_t i = 0; i < num; ++i) {
+            if (indices[i].empty()) continue;
+            std::vector<int64_t> shape = {static_cast<int64_t>(indices[i].size())};
+            shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+            outs[i] = buf.CreateOffsetView(shape, buf->dtype, &offset);
+        }
+    }
+    runtime::ParallelFor(static_cast<int64_t>(groups.size()), [&](int64_t g) {
+        for (std::size_t i : groups[g]) {
+            outs[i] = readers[i]->GetBatch(indices[i], outs[i]);
+        }
+    });
+    if (buf.defined()) return buf;
+
+    NDArray first;
+    for (std::size_t i = 0; i < num && !first.defined(); ++i) first = outs[i];
+    std::vector<int64_t> frame_shape(first->shape + 1, first->shape + first->ndim);
+    std::vector<int64_t> shape = {total};
+    shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+    buf = NDArray::Empty(shape, first->dtype, first->ctx);
+    uint64_t offset = 0;
+    for (std::size_t i = 0; i < num; ++i) {
+        if (!outs[i].defined()) continue;
+        std::vector<int64_t> out_shape(outs[i]->shape, outs[i]->shape + outs[i]->ndim);
+        CHECK(out_shape.size() == shape.size() && std::equal(frame_shape.begin(), frame_shape.end(), out_shape.begin() + 1))
+            << "Reader " << i << " returns frames of a different shape, can not be stacked";
+        CHECK(outs[i]->dtype.code == first->dtype.code && outs[i]->dtype.bits == first->dtype.bits)
+            << "Reader " << i << " returns frames of a different dtype, can not be stacked";
+        outs[i].CopyTo(buf.CreateOffsetView(out_shape, first->dtype, &offset));
+    }
+    return buf;
+}
+
+/**
+ * \brief GetBatch that stops decoding once the time budget is spent.
+ *
+ * Distinct frames are decoded in ascending order, the deadline is checked before each of them,
+ * so the reader is always left between frames and stays consistent. The first frame is always
+ * decoded to know the output shape. Missed slots are filled with the nearest decoded frame, or
+ * zeros if fill_nearest is false.
+ *
+ * \param mask Output, uint8 [N], 1 for slots holding the requested frame
+ * \return [N, H, W, C] frames
+ */
+runtime::NDArray GetBatchDeadline(VideoReaderInterface *reader, const std::vector<int64_t>& indices,
+                                  double timeout_ms, bool fill_nearest, runtime::NDArray mask) {
+    using NDArray = runtime::NDArray;
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + std::chrono::microseconds(static_cast<int64_t>(timeout_ms * 1000));
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    CHECK_GT(bs, 0) << "Empty indices";
+    CHECK(mask.defined() && mask->ndim == 1 && mask->shape[0] == bs
+          && mask->dtype.code == kDLUInt && mask->dtype.bits == 8) << "Mask must be uint8 of batch size";
+    // first slot asking for each frame, visited in ascending frame order
+    std::map<int64_t, int64_t> first_slot;
+    for (int64_t i = bs - 1; i >= 0; --i) first_slot[indices[i]] = i;
+
+    NDArray frames;
+    std::vector<int64_t> frame_shape;
+    uint64_t frame_bytes = 0;
+    // slot of batch holding each decoded frame
+    std::map<int64_t, int64_t> decoded;
+    for (const auto& kv : first_slot) {
+        if (!decoded.empty() && Clock::now() >= deadline) break;
+        // duplicates are copied afterwards
+        const int64_t idx = kv.first, slot = kv.second;
+        if (!frames.defined()) {
+            NDArray first = reader->GetBatch({idx}, NDArray());
+            frame_shape.assign(first->shape + 1, first->shape + first->ndim);
+            std::vector<int64_t> shape = {bs};
+            shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+            frames = NDArray::Empty(shape, first->dtype, first->ctx);
+            // offsets are in bytes, Size() counts elements
+            frame_bytes = first.Size() * ((first->dtype.bits * first->dtype.lanes + 7) / 8);
+            uint64_t offset = slot * frame_bytes;
+            first.CopyTo(frames.CreateOffsetView(
+                std::vector<int64_t>(first->shape, first->shape + first->ndim), first->dtype, &offset));
+        } else {
+            std::vector<int64_t> shape = {1};
+            shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+            uint64_t offset = slot * frame_bytes;
+            reader->GetBatch({idx}, frames.CreateOffsetView(shape, frames->dtype, &offset));
+        }
+        decoded[idx] = slot;
+    }
+
+    uint8_t *valid = static_cast<uint8_t*>(mask->data) + mask->byte_offset;
+    std::vector<int64_t> shape = {1};
+    shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+    NDArray zeros;
+    for (int64_t i = 0; i < bs; ++i) {
+        auto it = decoded.lower_bound(indices[i]);
+        valid[i] = it != decoded.end() && it->first == indices[i];
+        int64_t src = -1;
+        if (valid[i]) {
+            src = it->second;
+        } else if (fill_nearest) {
+            // closer of the neighbours, ties go to the earlier frame
+            auto prev = it == decoded.begin() ? decoded.end() : std::prev(it);
+            if (it == decoded.end() || (prev != decoded.end() && indices[i] - prev->first <= it->first - indices[i])) {
+                it = prev;
+            }
+            src = it->second;
+        }
+        if (src == i) continue;
+        uint64_t dst_offset = i * frame_bytes;
+        NDArray dst = frames.CreateOffsetView(shape, frames->dtype, &dst_offset);
+        if (src >= 0) {
+            uint64_t src_offset = src * frame_bytes;
+            frames.CreateOffsetView(shape, frames->dtype, &src_offset).CopyTo(dst);
+        } else {
+            if (!zeros.defined()) {
+                zeros = NDArray::Empty(shape, frames->dtype, kCPU);
+                std::memset(zeros->data, 0, frame_bytes);
+            }
+            zeros.CopyTo(dst);
+        }
+    }
+    return frames;
+}
+
+/*! \brief chunks decoded ahead of the one being consumed by the callback */
+static const int kStreamDepth = 2;
+
+/*! \brief frames of one streamed chunk and their request positions */
+struct StreamChunk {
+    runtime::NDArray frames;
+    runtime::NDArray positions;
+};  // struct StreamChunk
+
+/**
+ * \brief Deliver frames to a callback chunk by chunk as soon as they are decoded.
+ *
+ * Request positions are visited in ascending frame order and split into chunks of chunk_size.
+ * A background thread decodes up to kStreamDepth chunks ahead while the calling thread runs
+ * callback(frames, positions), frames is a DLTensor valid during the call only, positions are the
+ * int64 request positions of the frames. Returning 0 (e.g. False) from the callback stops early.
+ * Memory is bounded by the chunks in flight, not the request size.
+ */
+void GetBatchStream(VideoReaderInterface *reader, const std::vector<int64_t>& indices, int chunk_size,
+                    runtime::PackedFunc callback) {
+    using NDArray = runtime::NDArray;
+    CHECK_GT(chunk_size, 0) << "Invalid chunk size: " << chunk_size;
+    const int64_t bs = static_cast<int64_t>(indices.size());
+    std::vector<int64_t> order(bs);
+    for (int64_t i = 0; i < bs; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) { return indices[a] < indices[b]; });
+
+    using Chunk = StreamChunk;
+    dmlc::ConcurrentBlockingQueue<Chunk> ready;
+    dmlc::ConcurrentBlockingQueue<int> slots;
+    for (int i = 0; i < kStreamDepth; ++i) slots.Push(i);
+    std::exception_ptr error;
+    std::thread producer([&]() {
+        try {
+            for (int64_t begin = 0; begin < bs; begin += chunk_size) {
+                int slot;
+                if (!slots.Pop(&slot)) return;
+                const int64_t end = std::min(bs, begin + chunk_size);
+                std::vector<int64_t> frame_indices(end - begin);
+                Chunk chunk;
+                chunk.positions = NDArray::Empty({end - begin}, kInt64, kCPU);
+                int64_t *pos = static_cast<int64_t*>(chunk.positions->data);
+                for (int64_t i = begin; i < end; ++i) {
+                    pos[i - begin] = order[i];
+                    frame_indices[i - begin] = indices[order[i]];
+                }
+                // duplicates within a chunk are copied by GetBatch
+                chunk.frames = reader->GetBatch(frame_indices, NDArray());
+                ready.Push(chunk);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // end of stream
+        ready.Push(Chunk());
+    });
+
+    try {
+        Chunk chunk;
+        while (ready.Pop(&chunk) && chunk.frames.defined()) {
+            runtime::DECORDRetValue ret = callback(const_cast<DLTensor*>(chunk.frames.operator->()),
+                                                   chunk.positions);
+            // release before the slot is reused, keeps memory bounded
+            chunk = Chunk();
+            if (ret.type_code() == kDLInt && static_cast<int64_t>(ret) == 0) break;
+            slots.Push(0);
+        }
+    } catch (...) {
+        slots.SignalForKill();
+        producer.join();
+        throw;
+    }
+    // stops the producer if the callback asked to, no-op after end of stream
+    slots.SignalForKill();
+    producer.join();
+    if (error) std::rethrow_exception(error);
+}
+
 namespace runtime {
 DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetVideoReader")
 .set_body([] (DECORDArgs args, DECORDRetValue* rv) {
@@ -31,13 +418,217 @@ DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetVideoReader")
     int device_id = args[2];
     int width = args[3];
     int height = args[4];
+    std::string output_format = args[5];
+    int tone_mapping = args[6];
+    int autorotate = args[7];
+    int crop_detect = args[8];
+    std::string deinterlace = args[9];
+    int speculate = args[10];
+    int stream = args[11];
+    DLContext ctx;
+    ctx.device_type = static_cast<DLDeviceType>(device_type);
+    ctx.device_id = device_id;
+    FrameOptions opts;
+    // names without endianness suffix resolve to native endian, e.g. rgb48 -> rgb48le
+    opts.pix_fmt = av_get_pix_fmt(output_format.c_str());
+    CHECK(ffmpeg::IsSupportedPixelFormat(opts.pix_fmt))
+        << "Unsupported output format: " << output_format
+        << ", expect one of rgb24, gray, rgb48, p010, yuv420p10";
+    opts.tone_mapping = tone_mapping != 0;
+    opts.autorotate = autorotate != 0;
+    opts.crop_detect = crop_detect != 0;
+    if (deinterlace == "none") {
+        opts.deinterlace = kDeinterlaceNone;
+    } else if (deinterlace == "field") {
+        opts.deinterlace = kDeinterlaceField;
+    } else if (deinterlace == "blend") {
+        opts.deinterlace = kDeinterlaceBlend;
+    } else {
+        LOG(FATAL) << "Unknown deinterlace mode: " << deinterlace << ", expect one of none, field, blend";
+    }
+    std::unique_ptr<VideoReader> reader(new VideoReader(fn, ctx, width, height, opts, stream));
+    VideoReaderInterface *p = reader.get();
+    if (speculate > 0) {
+        p = new SpeculativeVideoReader(std::move(reader), speculate);
+    } else {
+        reader.release();
+    }
+    *rv = static_cast<VideoReaderInterfaceHandle>(p);
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetImageSequenceReader")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    std::string pattern = args[0];
+    int device_type = args[1];
+    int device_id = args[2];
+    int width = args[3];
+    int height = args[4];
+    std::string output_format = args[5];
+    double fps = args[6];
+    DLContext ctx;
+    ctx.device_type = static_cast<DLDeviceType>(device_type);
+    ctx.device_id = device_id;
+    FrameOptions opts;
+    opts.pix_fmt = av_get_pix_fmt(output_format.c_str());
+    CHECK(ffmpeg::IsSupportedPixelFormat(opts.pix_fmt))
+        << "Unsupported output format: " << output_format
+        << ", expect one of rgb24, gray, rgb48, p010, yuv420p10";
+    VideoReaderInterfaceHandle handle = static_cast<VideoReaderInterfaceHandle>(
+        new ImageSequenceReader(pattern, ctx, width, height, opts, fps));
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetThreadSafeReader")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    std::string fn = args[0];
+    int device_type = args[1];
+    int device_id = args[2];
+    int width = args[3];
+    int height = args[4];
+    std::string output_format = args[5];
+    int max_cursors = args[6];
+    int park = args[7];
+    DLContext ctx;
+    ctx.device_type = static_cast<DLDeviceType>(device_type);
+    ctx.device_id = device_id;
+    FrameOptions opts;
+    opts.pix_fmt = av_get_pix_fmt(output_format.c_str());
+    CHECK(ffmpeg::IsSupportedPixelFormat(opts.pix_fmt))
+        << "Unsupported output format: " << output_format
+        << ", expect one of rgb24, gray, rgb48, p010, yuv420p10";
+    VideoReaderInterfaceHandle handle = static_cast<VideoReaderInterfaceHandle>(
+        new ThreadSafeVideoReader(fn, ctx, width, height, opts, max_cursors, park != 0));
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetNumCursors")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<ThreadSafeVideoReader*>(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Not a ThreadSafeVideoReader";
+    *rv = p->NumCursors();
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetCursorStats")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<ThreadSafeVideoReader*>(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Not a ThreadSafeVideoReader";
+    CursorStats stats = p->GetCursorStats();
+    // requests, hits, seeks, opened, recycled
+    std::vector<int64_t> values = {stats.requests, stats.hits, stats.seeks, stats.opened, stats.recycled};
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(values.size())}, kInt64, kCPU);
+    std::memcpy(ret->data, values.data(), values.size() * sizeof(int64_t));
+    *rv = ret;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetErrorCounts")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = AsVideoReader(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Error counts are only tracked by VideoReader";
+    // decode, demux
+    std::vector<int64_t> values = {p->GetDecodeErrorCount(), p->GetDemuxErrorCount()};
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(values.size())}, kInt64, kCPU);
+    std::memcpy(ret->data, values.data(), values.size() * sizeof(int64_t));
+    *rv = ret;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetVideoStream")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = AsVideoReader(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Not a VideoReader";
+    *rv = p->GetVideoStream();
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetSpeculationStats")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<SpeculativeVideoReader*>(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Speculation is not enabled, see VideoReader(speculate=...)";
+    SpeculationStats stats = p->GetSpeculationStats();
+    // requests, hits, decoded, wasted, cancelled
+    std::vector<int64_t> values = {stats.requests, stats.hits, stats.decoded, stats.wasted, stats.cancelled};
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(values.size())}, kInt64, kCPU);
+    std::memcpy(ret->data, values.data(), values.size() * sizeof(int64_t));
+    *rv = ret;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetConcatReader")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    std::string uris = args[0];
+    int device_type = args[1];
+    int device_id = args[2];
+    int width = args[3];
+    int height = args[4];
+    std::string output_format = args[5];
+    DLContext ctx;
+    ctx.device_type = static_cast<DLDeviceType>(device_type);
+    ctx.device_id = device_id;
+    FrameOptions opts;
+    opts.pix_fmt = av_get_pix_fmt(output_format.c_str());
+    CHECK(ffmpeg::IsSupportedPixelFormat(opts.pix_fmt))
+        << "Unsupported output format: " << output_format
+        << ", expect one of rgb24, gray, rgb48, p010, yuv420p10";
+    // newline separated segments, or a single playlist file
+    std::vector<std::string> segments = SplitString(uris, '\n');
+    if (segments.size() == 1) {
+        std::string ext = segments[0].substr(segments[0].find_last_of('.') + 1);
+        if (ext == "m3u8" || ext == "m3u" || ext == "ffconcat" || ext == "txt") {
+            segments = ConcatVideoReader::ParsePlaylist(segments[0]);
+        }
+    }
+    VideoReaderInterfaceHandle handle = static_cast<VideoReaderInterfaceHandle>(
+        new ConcatVideoReader(segments, ctx, width, height, opts));
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetFrameTimestamp")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    int64_t pos = args[1];
+    auto p = dynamic_cast<ConcatVideoReader*>(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Not a concatenated video reader";
+    *rv = p->GetFrameTimestamp(pos);
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetMultiStreamReader")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    std::string fn = args[0];
+    int device_type = args[1];
+    int device_id = args[2];
+    int width = args[3];
+    int height = args[4];
+    NDArray streams = args[5];
     DLContext ctx;
     ctx.device_type = static_cast<DLDeviceType>(device_type);
     ctx.device_id = device_id;
-    VideoReaderInterfaceHandle handle = static_cast<VideoReaderInterfaceHandle>(new VideoReader(fn, ctx, width, height));
+    std::vector<int64_t> int_streams;
+    streams.CopyTo(int_streams);
+    // negative stream index stands for all video streams
+    std::vector<int> stream_ids;
+    for (auto st : int_streams) {
+        if (st >= 0) stream_ids.emplace_back(static_cast<int>(st));
+    }
+    VideoReaderInterfaceHandle handle = static_cast<VideoReaderInterfaceHandle>(
+        new MultiStreamVideoReader(fn, ctx, stream_ids, width, height));
     *rv = handle;
   });
 
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetActiveStreams")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<MultiStreamVideoReader*>(static_cast<VideoReaderInterface*>(handle));
+    CHECK(p) << "Not a multi stream video reader";
+    auto streams = p->GetActiveStreams();
+    std::vector<int64_t> ret(streams.begin(), streams.end());
+    std::vector<int64_t> shape = {static_cast<int64_t>(ret.size())};
+    NDArray arr = NDArray::Empty(shape, kInt64, kCPU);
+    arr.CopyFrom(ret, shape);
+    *rv = arr;
+  });
+
 DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderNextFrame")
 .set_body([] (DECORDArgs args, DECORDRetValue* rv) {
     VideoReaderInterfaceHandle handle = args[0];
@@ -76,6 +667,82 @@ DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatch")
     *rv = ret;
   });
 
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatchMulti")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    // args: output buffer or None, then (handle, indices) pairs
+    CHECK(args.size() % 2 == 1) << "Expect output buffer followed by (reader, indices) pairs";
+    NDArray buf = args[0];
+    std::vector<VideoReaderInterface*> readers;
+    std::vector<std::vector<int64_t> > indices;
+    for (int i = 1; i < args.size(); i += 2) {
+        VideoReaderInterfaceHandle handle = args[i];
+        NDArray arr = args[i + 1];
+        readers.emplace_back(static_cast<VideoReaderInterface*>(handle));
+        indices.emplace_back();
+        arr.CopyTo(indices.back());
+    }
+    *rv = GetBatchMulti(readers, indices, buf);
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatchFlow")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    NDArray indices = args[1];
+    NDArray frames = args[2];
+    int stride = args[3];
+    int downscale = args[4];
+    double bound = args[5];
+    std::vector<int64_t> int_indices;
+    indices.CopyTo(int_indices);
+    *rv = GetBatchFlow(static_cast<VideoReaderInterface*>(handle), int_indices, frames,
+                       stride, downscale, static_cast<float>(bound));
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatchDeadline")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    NDArray indices = args[1];
+    double timeout_ms = args[2];
+    int fill_nearest = args[3];
+    NDArray mask = args[4];
+    std::vector<int64_t> int_indices;
+    indices.CopyTo(int_indices);
+    *rv = GetBatchDeadline(static_cast<VideoReaderInterface*>(handle), int_indices, timeout_ms,
+                           fill_nearest != 0, mask);
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatchStream")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    NDArray indices = args[1];
+    int chunk_size = args[2];
+    PackedFunc callback = args[3];
+    std::vector<int64_t> int_indices;
+    indices.CopyTo(int_indices);
+    GetBatchStream(static_cast<VideoReaderInterface*>(handle), int_indices, chunk_size, callback);
+  });
+
+DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderGetBatchDiff")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoReaderInterfaceHandle handle = args[0];
+    NDArray indices = args[1];
+    int num_diff = args[2];
+    std::string dtype = args[3];
+    improc::DiffType type;
+    if (dtype == "int16") {
+        type = improc::kDiffInt16;
+    } else if (dtype == "int8") {
+        type = improc::kDiffInt8;
+    } else if (dtype == "float32") {
+        type = improc::kDiffFloat32;
+    } else {
+        LOG(FATAL) << "Invalid difference dtype: " << dtype << ", expect int16, int8 or float32";
+    }
+    std::vector<int64_t> int_indices;
+    indices.CopyTo(int_indices);
+    *rv = GetBatchDiff(static_cast<VideoReaderInterface*>(handle), int_indices, num_diff, type);
+  });
+
 DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderSeek")
 .set_body([] (DECORDArgs args, DECORDRetValue* rv) {
     VideoReaderInterfaceHandle handle = args[0];
@@ -116,7 +783,7 @@ DECORD_REGISTER_GLOBAL("video_reader._CAPI_VideoReaderFree")
 // VideoLoader
 DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderGetVideoLoader")
 .set_body([] (DECORDArgs args, DECORDRetValue* rv) {
-    CHECK_EQ(args.size(), 11);
+    CHECK_EQ(args.size(), 19);
     // for convenience, pass in comma separated filenames
     int idx = 0;
     std::string filenames = args[idx++];
@@ -130,6 +797,17 @@ DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderGetVideoLoader")
     int skip = args[idx++];
     int shuffle = args[idx++];
     int prefetch = args[idx++];
+    bool skip_bad = args[idx++];
+    bool autotune = args[idx++];
+    int64_t memory_cap = args[idx++];
+    NDArray weights = args[idx++];
+    sampler::WeightedSamplerOptions weighted;
+    weighted.replacement = args[idx++];
+    weighted.num_shards = args[idx++];
+    weighted.shard_id = args[idx++];
+    weighted.seed = static_cast<uint64_t>(static_cast<int64_t>(args[idx++]));
+    // empty for uniform weights
+    if (weights.Size() > 0) weights.CopyTo(weighted.weights);
     auto fns = SplitString(filenames, ',');
     std::vector<int> shape({bs, height, width, channel});
     // list of context
@@ -147,7 +825,8 @@ DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderGetVideoLoader")
       ctx.device_id = static_cast<int>(dev_ids[i]);
       ctxs.emplace_back(ctx);
     }
-    VideoLoaderInterfaceHandle handle = static_cast<VideoLoaderInterfaceHandle>(new VideoLoader(fns, ctxs, shape, intvl, skip, shuffle, prefetch));
+    VideoLoaderInterfaceHandle handle = static_cast<VideoLoaderInterfaceHandle>(new VideoLoader(
+        fns, ctxs, shape, intvl, skip, shuffle, prefetch, skip_bad, autotune, memory_cap, weighted));
     *rv = handle;
   });
 
@@ -191,11 +870,300 @@ DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderNextIndices")
     *rv = ret;
   });
 
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderGetQuarantined")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<VideoLoader*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoLoader";
+    // newline separated, filenames may contain commas
+    std::string ret;
+    for (const auto& fn : p->GetQuarantined()) {
+        if (!ret.empty()) ret += '\n';
+        ret += fn;
+    }
+    *rv = ret;
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderSetWeights")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    NDArray weights = args[1];
+    auto p = dynamic_cast<VideoLoader*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoLoader";
+    std::vector<double> values;
+    weights.CopyTo(values);
+    p->SetWeights(values);
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderGetConfig")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<VideoLoader*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoLoader";
+    LoaderConfig config = p->GetConfig();
+    // decoder threads, prefetch, tuning
+    std::vector<int64_t> values = {config.decoder_threads, config.prefetch, p->IsTuning() ? 1 : 0};
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(values.size())}, kInt64, kCPU);
+    std::memcpy(ret->data, values.data(), values.size() * sizeof(int64_t));
+    *rv = ret;
+  });
+
 DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoLoaderFree")
 .set_body([] (DECORDArgs args, DECORDRetValue* rv) {
     VideoLoaderInterfaceHandle handle = args[0];
     auto p = static_cast<VideoLoaderInterface*>(handle);
     if (p) delete p;
   });
+
+// VideoClipDataset, iterated with the VideoLoader APIs above
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetGetVideoClipDataset")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    CHECK_EQ(args.size(), 10);
+    int idx = 0;
+    std::string annotation = args[idx++];
+    std::string root = args[idx++];
+    int device_type = args[idx++];
+    int device_id = args[idx++];
+    int bs = args[idx++];
+    int num_frames = args[idx++];
+    int width = args[idx++];
+    int height = args[idx++];
+    int shuffle = args[idx++];
+    int max_open_readers = args[idx++];
+    DLContext ctx;
+    ctx.device_type = static_cast<DLDeviceType>(device_type);
+    ctx.device_id = device_id;
+    VideoLoaderInterface *p = new VideoClipDataset(annotation, root, ctx, bs, num_frames, width, height,
+                                                   shuffle != 0, max_open_readers);
+    VideoLoaderInterfaceHandle handle = static_cast<VideoLoaderInterfaceHandle>(p);
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetNumClips")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<VideoClipDataset*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoClipDataset";
+    *rv = p->NumClips();
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetGetClip")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    int64_t idx = args[1];
+    auto p = dynamic_cast<VideoClipDataset*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoClipDataset";
+    *rv = p->GetClip(idx);
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetGetLabel")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    int64_t idx = args[1];
+    auto p = dynamic_cast<VideoClipDataset*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoClipDataset";
+    *rv = p->GetLabel(idx);
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetNextLabels")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<VideoClipDataset*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoClipDataset";
+    *rv = p->NextLabels();
+  });
+
+DECORD_REGISTER_GLOBAL("video_loader._CAPI_VideoClipDatasetGetClassNames")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoLoaderInterfaceHandle handle = args[0];
+    auto p = dynamic_cast<VideoClipDataset*>(static_cast<VideoLoaderInterface*>(handle));
+    CHECK(p) << "Not a VideoClipDataset";
+    // newline separated, class names may contain commas
+    std::string names;
+    for (auto& name : p->GetClassNames()) {
+        if (!names.empty()) names += '\n';
+        names += name;
+    }
+    *rv = names;
+  });
+
+// VideoWriter
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterGetVideoWriter")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    CHECK_EQ(args.size(), 11);
+    int idx = 0;
+    std::string fn = args[idx++];
+    double fps = args[idx++];
+    int width = args[idx++];
+    int height = args[idx++];
+    std::string codec = args[idx++];
+    std::string pix_fmt = args[idx++];
+    int64_t bit_rate = args[idx++];
+    std::string thread_type = args[idx++];
+    int thread_count = args[idx++];
+    std::string options = args[idx++];
+    int queue_size = args[idx++];
+    EncoderOptions opts;
+    opts.codec = codec;
+    if (!pix_fmt.empty()) {
+        opts.pix_fmt = av_get_pix_fmt(pix_fmt.c_str());
+        CHECK_NE(opts.pix_fmt, AV_PIX_FMT_NONE) << "Unknown pixel format: " << pix_fmt;
+    }
+    opts.bit_rate = bit_rate;
+    if (thread_type == "frame") {
+        opts.thread_type = FF_THREAD_FRAME;
+    } else if (thread_type == "slice") {
+        opts.thread_type = FF_THREAD_SLICE;
+    } else {
+        LOG(FATAL) << "Invalid thread type: " << thread_type << ", expect frame or slice";
+    }
+    opts.thread_count = thread_count;
+    opts.options = options;
+    opts.queue_size = queue_size;
+    VideoWriterInterface *p = new VideoWriter(fn, fps, width, height, opts);
+    VideoWriterInterfaceHandle handle = static_cast<VideoWriterInterfaceHandle>(p);
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterWrite")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoWriterInterfaceHandle handle = args[0];
+    NDArray frames = args[1];
+    static_cast<VideoWriterInterface*>(handle)->Write(frames);
+  });
+
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterFlush")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoWriterInterfaceHandle handle = args[0];
+    static_cast<VideoWriterInterface*>(handle)->Flush();
+  });
+
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterClose")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoWriterInterfaceHandle handle = args[0];
+    static_cast<VideoWriterInterface*>(handle)->Close();
+  });
+
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterGetFrameCount")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoWriterInterfaceHandle handle = args[0];
+    *rv = static_cast<VideoWriterInterface*>(handle)->GetFrameCount();
+  });
+
+DECORD_REGISTER_GLOBAL("video_writer._CAPI_VideoWriterFree")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    VideoWriterInterfaceHandle handle = args[0];
+    auto p = static_cast<VideoWriterInterface*>(handle);
+    if (p) delete p;
+  });
+// PacketReader
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetPacketReader")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    std::string fn = args[0];
+    int stream_nb = args[1];
+    std::string bsf_name = args[2];
+    PacketReader *p = new PacketReader(fn, stream_nb, bsf_name);
+    void *handle = static_cast<void*>(p);
+    *rv = handle;
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetFrameCount")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    *rv = static_cast<PacketReader*>(handle)->GetFrameCount();
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetKeyIndices")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    std::vector<int64_t> keys = static_cast<PacketReader*>(handle)->GetKeyIndices();
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(keys.size())}, kInt64, kCPU);
+    if (!keys.empty()) std::memcpy(ret->data, keys.data(), keys.size() * sizeof(int64_t));
+    *rv = ret;
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetAverageFPS")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    *rv = static_cast<PacketReader*>(handle)->GetAverageFPS();
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetCodecName")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    *rv = static_cast<PacketReader*>(handle)->GetCodecName();
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetTimeBase")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    AVRational tb = static_cast<PacketReader*>(handle)->GetTimeBase();
+    *rv = std::to_string(tb.num) + "/" + std::to_string(tb.den);
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetExtradata")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    *rv = static_cast<PacketReader*>(handle)->GetExtradata();
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderReadRange")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    int64_t start = args[1];
+    int64_t end = args[2];
+    static_cast<PacketReader*>(handle)->ReadRange(start, end);
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderGetRangeField")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    std::string field = args[1];
+    auto p = static_cast<PacketReader*>(handle);
+    if (field == "data") {
+        *rv = p->Data();
+    } else if (field == "offsets") {
+        *rv = p->Offsets();
+    } else if (field == "pts") {
+        *rv = p->PTS();
+    } else if (field == "dts") {
+        *rv = p->DTS();
+    } else if (field == "flags") {
+        *rv = p->Flags();
+    } else if (field == "frame_indices") {
+        *rv = p->FrameIndices();
+    } else {
+        LOG(FATAL) << "Unknown packet range field: " << field;
+    }
+  });
+
+DECORD_REGISTER_GLOBAL("packet_reader._CAPI_PacketReaderFree")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    void *handle = args[0];
+    auto p = static_cast<PacketReader*>(handle);
+    if (p) delete p;
+  });
+
+DECORD_REGISTER_GLOBAL("memory._CAPI_MemorySetBudget")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    int64_t budget = args[0];
+    MemoryGovernor::Get()->SetBudget(budget);
+  });
+
+DECORD_REGISTER_GLOBAL("memory._CAPI_MemoryGetBudget")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    *rv = MemoryGovernor::Get()->GetBudget();
+  });
+
+DECORD_REGISTER_GLOBAL("memory._CAPI_MemoryGetUsage")
+.set_body([] (DECORDArgs args, DECORDRetValue* rv) {
+    // bytes held by each component, then bytes released from each, in MemoryComponent order
+    std::vector<int64_t> values = MemoryGovernor::Get()->GetUsage();
+    std::vector<int64_t> released = MemoryGovernor::Get()->GetReleased();
+    values.insert(values.end(), released.begin(), released.end());
+    NDArray ret = NDArray::Empty({static_cast<int64_t>(values.size())}, kInt64, kCPU);
+    std::memcpy(ret->data, values.data(), values.size() * sizeof(int64_t));
+    *rv = ret;
+  });
 }  // namespace runtime
 }  // namespace decord
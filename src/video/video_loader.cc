@@ -8,24 +8,36 @@
 #include "../sampler/sequential_sampler.h"
 #include "../sampler/random_file_order_sampler.h"
 #include "../sampler/random_sampler.h"
+#include "../sampler/weighted_sampler.h"
 
 #include <sstream>
 #include <algorithm>
+#include <cstdlib>
 
 namespace decord {
 
+/*! \brief replacement clips tried before giving up on a batch */
+static const int kMaxReplacements = 16;
+
+static int64_t BatchBytes(const runtime::NDArray& data) {
+    return data.defined() ? static_cast<int64_t>(runtime::GetDataSize(*data.operator->())) : 0;
+}
+
 VideoLoader::VideoLoader(std::vector<std::string> filenames, std::vector<DLContext> ctxs,
                          std::vector<int> shape, int interval,
-                         int skip, int shuffle, int prefetch)
-    : readers_(), shape_(shape), intvl_(interval), skip_(skip), shuffle_(shuffle),
-    prefetch_(prefetch), next_ready_(0), next_data_(), next_indices_(),
+                         int skip, int shuffle, int prefetch, bool skip_bad,
+                         bool autotune, int64_t memory_cap, sampler::WeightedSamplerOptions weighted)
+    : readers_(), skip_bad_(skip_bad), rng_(std::random_device{}()), shape_(shape), intvl_(interval), skip_(skip), shuffle_(shuffle),
+    prefetch_(prefetch), prefetch_limit_(0), next_ready_(0), next_data_(), next_indices_(),
     //visit_order_(), visit_bounds_(), visit_buffer_(), curr_(0),
-    ctxs_(ctxs), ndarray_pool_() {
+    ctxs_(ctxs), ndarray_pool_(), decoder_threads_(0), consumed_(0),
+    prefetched_bytes_(0), next_seq_(0), prefetch_stop_(false), prefetch_done_(false) {
     // Validate parameters
     intvl_ = std::max(0, intvl_);
     skip_ = std::max(0, skip_);
     shuffle_ = std::max(0, shuffle_);
     prefetch_ = std::max(0, prefetch_);
+    prefetch_limit_ = prefetch_;
 
     if (shape.size() != 4) {
         std::stringstream ss("(");
@@ -47,18 +59,36 @@ VideoLoader::VideoLoader(std::vector<std::string> filenames, std::vector<DLConte
     lengths.reserve(filenames.size());
     ranges.reserve(filenames.size() * 2);
     for (std::string filename : filenames) {
-        ReaderPtr ptr = std::make_shared<VideoReader>(filename, ctxs[0], shape_[2], shape_[1]);
-        auto key_indices = ptr->GetKeyIndicesVector();
-        CHECK_GT(key_indices.size(), 0) << "Error getting key frame info from " << filename;
-        auto frame_count = ptr->GetFrameCount();
-        CHECK_GT(frame_count, 0) << "Error getting total frame from " << filename;
-        readers_.emplace_back(Entry(ptr, key_indices, frame_count));
+        ReaderPtr ptr;
+        std::vector<int64_t> key_indices;
+        int64_t frame_count = 0;
+        try {
+            if (ImageSequenceReader::IsImageSequence(filename)) {
+                // frame folders are served by the same loader
+                ptr = std::make_shared<ImageSequenceReader>(filename, ctxs[0], shape_[2], shape_[1]);
+            } else {
+                ptr = std::make_shared<VideoReader>(filename, ctxs[0], shape_[2], shape_[1]);
+            }
+            ptr->GetKeyIndices().CopyTo(key_indices);
+            CHECK_GT(key_indices.size(), 0) << "Error getting key frame info from " << filename;
+            frame_count = ptr->GetFrameCount();
+            CHECK_GT(frame_count, 0) << "Error getting total frame from " << filename;
+        } catch (const dmlc::Error& e) {
+            if (!skip_bad_) throw;
+            readers_.emplace_back(Entry(nullptr, {}, 0, filename));
+            Quarantine(readers_.size() - 1, e.what());
+            continue;
+        }
+        readers_.emplace_back(Entry(ptr, key_indices, frame_count, filename));
+        sampled_entries_.emplace_back(readers_.size() - 1);
         lengths.emplace_back(frame_count);
         // range is fixed, reserve it for more flexible usage later
         ranges.emplace_back(0);
         ranges.emplace_back(frame_count - 1);
     }
 
+    CHECK_GT(lengths.size(), 0) << "None of the videos can be read";
+
     // init sampler
     if (shuffle == kNoShuffle) {
         sampler_ = std::unique_ptr<sampler::SamplerInterface>(new sampler::SequentialSampler(lengths, ranges, shape[0], intvl_, skip_));
@@ -66,11 +96,22 @@ VideoLoader::VideoLoader(std::vector<std::string> filenames, std::vector<DLConte
         sampler_ = std::unique_ptr<sampler::SamplerInterface>(new sampler::RandomFileOrderSampler(lengths, ranges, shape[0], intvl_, skip_));
     } else if (shuffle == kRandomShuffle) {
         sampler_ = std::unique_ptr<sampler::SamplerInterface>(new sampler::RandomSampler(lengths, ranges, shape[0], intvl_, skip_));
+    } else if (shuffle == kWeightedShuffle) {
+        if (!weighted.weights.empty()) {
+            CHECK_EQ(weighted.weights.size(), filenames.size())
+                << "Expected " << filenames.size() << " weights, given " << weighted.weights.size();
+            // sampler only knows readable files
+            std::vector<double> weights;
+            for (auto entry : sampled_entries_) weights.emplace_back(weighted.weights[entry]);
+            weighted.weights.swap(weights);
+        }
+        sampler_ = std::unique_ptr<sampler::SamplerInterface>(new sampler::WeightedSampler(lengths, ranges, shape[0], intvl_, skip_, weighted));
     } else {
         LOG(FATAL) << "Invalid shuffle mode: " << shuffle << " Available: "
             << "\n\t{No shuffle: " << kNoShuffle << "}"
             << "\n\t{Random File Order: " << kRandomFileOrderShuffle << "}"
-            << "\n\t{Random access: " << kRandomShuffle << "}";
+            << "\n\t{Random access: " << kRandomShuffle << "}"
+            << "\n\t{Weighted random access: " << kWeightedShuffle << "}";
     }
 
     // // initialize visiting order for frames
@@ -97,12 +138,41 @@ VideoLoader::VideoLoader(std::vector<std::string> filenames, std::vector<DLConte
     //         start = bound;
     //     }
     // }
+    if (autotune) {
+        // same files and batch layout share the tuned configuration
+        std::stringstream manifest;
+        for (const auto& fn : filenames) manifest << fn << "\n";
+        for (auto dim : shape_) manifest << dim << ",";
+        manifest << intvl_ << "," << skip_ << "," << shuffle_ << "," << ctxs_[0].device_type;
+        int64_t frame_bytes = static_cast<int64_t>(std::max(shape_[1], 1)) * std::max(shape_[2], 1) * std::max(shape_[3], 1);
+        // e.g. DECORD_AUTOTUNE_BATCHES=64 for a shorter search
+        const char* env = std::getenv("DECORD_AUTOTUNE_BATCHES");
+        int64_t max_batches = env ? std::max(1LL, std::atoll(env)) : 300;
+        tuner_.reset(new LoaderAutotuner(manifest.str(), GetConfig(), frame_bytes * shape_[0], frame_bytes,
+                                         static_cast<int64_t>(sampled_entries_.size()), memory_cap, max_batches));
+        LoaderConfig saved;
+        if (tuner_->Load(&saved)) ApplyConfig(saved);
+    }
+    MemoryGovernor::Get()->Register(this, kMemoryPrefetch);
     Reset();
 }
 
 void VideoLoader::Reset() {
     CHECK(sampler_ != nullptr);
+    StopPrefetch();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefetched_.clear();
+        MemoryGovernor::Get()->Charge(kMemoryPrefetch, -prefetched_bytes_);
+        prefetched_bytes_ = 0;
+        requeued_.clear();
+        next_seq_ = 0;
+        prefetch_error_ = nullptr;
+        prefetch_done_ = false;
+    }
     sampler_->Reset();
+    consumed_ = 0;
+    StartPrefetch();
     // curr_ = 0;
 
     // // basic case: no shuffle at all, sequentially read frames in filename order
@@ -145,12 +215,141 @@ void VideoLoader::Reset() {
 }
 
 VideoLoader::~VideoLoader() {
+    MemoryGovernor::Get()->Unregister(this);
+    StopPrefetch();
+    MemoryGovernor::Get()->Charge(kMemoryPrefetch, -prefetched_bytes_);
+}
+
+void VideoLoader::StartPrefetch() {
+    {
+        // depth may be lowered by the memory governor from another thread
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (prefetch_ < 1) return;
+    }
+    if (prefetch_thread_.joinable()) return;
+    prefetch_stop_ = false;
+    prefetch_done_ = false;
+    prefetch_thread_ = std::thread(&VideoLoader::PrefetchLoop, this);
+}
+
+void VideoLoader::StopPrefetch() {
+    if (!prefetch_thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefetch_stop_ = true;
+    }
+    cv_.notify_all();
+    prefetch_thread_.join();
+}
+
+void VideoLoader::PrefetchLoop() {
+    // sampler and readers are only touched by this thread while it runs
+    while (true) {
+        bool requeued;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] {
+                return prefetch_stop_ || static_cast<int>(prefetched_.size()) < std::min(prefetch_, prefetch_limit_);
+            });
+            if (prefetch_stop_) return;
+            requeued = !requeued_.empty();
+        }
+        if (!requeued && !sampler_->HasNext()) break;
+        try {
+            Batch batch = ProduceBatch();
+            const int64_t bytes = BatchBytes(batch.data);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!requeued_.empty() && requeued_.begin()->first < batch.seq) {
+                    // earlier batches were dropped while this one was decoded, keep epoch order
+                    requeued_[batch.seq] = std::move(batch.samples);
+                } else {
+                    prefetched_bytes_ += bytes;
+                    MemoryGovernor::Get()->Charge(kMemoryPrefetch, bytes);
+                    prefetched_.emplace_back(std::move(batch));
+                    // regain depth lost to ReleaseMemory while another batch fits the budget
+                    if (prefetch_limit_ < prefetch_ && MemoryGovernor::Get()->Fits(bytes)) ++prefetch_limit_;
+                }
+            }
+            MemoryGovernor::Get()->Enforce();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            prefetch_error_ = std::current_exception();
+            break;
+        }
+        cv_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefetch_done_ = true;
+    }
+    cv_.notify_all();
+}
+
+void VideoLoader::ApplyConfig(const LoaderConfig& config) {
+    StopPrefetch();
+    if (config.decoder_threads != decoder_threads_) {
+        decoder_threads_ = config.decoder_threads;
+        for (auto& e : readers_) {
+            // image sequences decode single pictures, nothing to tune
+            auto reader = dynamic_cast<VideoReader*>(e.ptr.get());
+            if (reader) reader->SetDecoderThreads(decoder_threads_);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prefetch_ = std::max(0, config.prefetch);
+        prefetch_limit_ = prefetch_;
+    }
+    StartPrefetch();
+}
 
+LoaderConfig VideoLoader::GetConfig() const {
+    LoaderConfig config;
+    config.decoder_threads = decoder_threads_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    config.prefetch = prefetch_;
+    return config;
+}
+
+int64_t VideoLoader::ReleaseMemory(int64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t released = 0;
+    // the next batch stays, dropping it as well would decode it over and over
+    while (released < bytes && prefetched_.size() > 1) {
+        Batch& batch = prefetched_.back();
+        released += BatchBytes(batch.data);
+        requeued_[batch.seq] = std::move(batch.samples);
+        prefetched_.pop_back();
+    }
+    if (released == 0) return 0;
+    prefetched_bytes_ -= released;
+    MemoryGovernor::Get()->Charge(kMemoryPrefetch, -released);
+    // producer would refill the queue right away
+    prefetch_limit_ = std::max(1, static_cast<int>(prefetched_.size()));
+    return released;
+}
+
+std::vector<std::string> VideoLoader::GetQuarantined() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return quarantined_;
+}
+
+void VideoLoader::SetWeights(std::vector<double> weights) {
+    auto weighted = dynamic_cast<sampler::WeightedSampler*>(sampler_.get());
+    CHECK(weighted) << "Weights require shuffle mode " << kWeightedShuffle << ", current: " << shuffle_;
+    CHECK_EQ(weights.size(), readers_.size())
+        << "Expected " << readers_.size() << " weights, given " << weights.size();
+    std::vector<double> sampled;
+    for (auto entry : sampled_entries_) sampled.emplace_back(weights[entry]);
+    // pending until Reset, the producer thread never reads it
+    weighted->SetWeights(sampled);
 }
 
 bool VideoLoader::HasNext() const {
     CHECK(sampler_ != nullptr);
-    return sampler_->HasNext();
+    // sampler runs ahead while prefetching
+    return consumed_ < Length();
     // return (curr_ < visit_order_.size());
 }
 
@@ -165,34 +364,131 @@ void VideoLoader::Next() {
         next_ready_ = 3;
         return;
     };
+    Batch batch;
+    bool ready = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (prefetch_thread_.joinable()) {
+            cv_.wait(lock, [this] { return !prefetched_.empty() || prefetch_done_; });
+        }
+        // leftovers are served first after prefetch is turned off
+        if (!prefetched_.empty()) {
+            batch = std::move(prefetched_.front());
+            prefetched_.pop_front();
+            const int64_t bytes = BatchBytes(batch.data);
+            prefetched_bytes_ -= bytes;
+            MemoryGovernor::Get()->Charge(kMemoryPrefetch, -bytes);
+            ready = true;
+        } else if (prefetch_error_) {
+            std::exception_ptr error = prefetch_error_;
+            prefetch_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+    cv_.notify_all();
+    if (!ready) batch = ProduceBatch();
+    ++consumed_;
+    next_data_ = batch.data;
+    next_indices_ = std::move(batch.indices);
+    next_ready_ = 3;
+
+    if (IsTuning()) {
+        LoaderConfig config;
+        if (tuner_->Record(batch.decoded, shape_[0], &config)) ApplyConfig(config);
+    }
+}
+
+VideoLoader::Batch VideoLoader::ProduceBatch() {
     // CHECK(curr_ < visit_order_.size());
     // auto pair = visit_order_[curr_];
     std::vector<int64_t> indices;
     indices.reserve(shape_[0]);
-    auto samples = sampler_->Next();
+    sampler::Samples samples;
+    int64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!requeued_.empty()) {
+            // dropped batches first, in epoch order
+            seq = requeued_.begin()->first;
+            samples = std::move(requeued_.begin()->second);
+            requeued_.erase(requeued_.begin());
+        } else {
+            seq = next_seq_++;
+        }
+    }
+    if (samples.empty()) samples = sampler_->Next();
     CHECK_EQ(samples.size(), static_cast<size_t>(shape_[0]));
     for (size_t i = 0; i < samples.size(); ++i) {
         indices.emplace_back(samples[i].second);
     }
-    size_t reader_idx = samples[0].first;
+    size_t reader_idx = sampled_entries_[samples[0].first];
     // std::size_t reader_idx = pair.first;
     // int64_t frame_idx = pair.second;
     // for (auto i = 0; i < shape_[0]; ++i) {
     //     indices.emplace_back(frame_idx);
     //     frame_idx += intvl_ + 1;
     // }
-    auto batch = readers_[reader_idx].ptr->GetBatch(indices, NDArray());
+    int64_t decoded = 0;
+    NDArray batch;
+    if (!readers_[reader_idx].quarantined) batch = TryGetBatch(reader_idx, indices, &decoded);
+    for (int attempt = 0; !batch.defined(); ++attempt) {
+        CHECK_LT(attempt, kMaxReplacements) << "Too many unreadable videos in a row";
+        // same batch layout from a random healthy video, epoch length is unchanged
+        std::vector<std::size_t> healthy;
+        for (std::size_t i : sampled_entries_) {
+            if (!readers_[i].quarantined) healthy.emplace_back(i);
+        }
+        CHECK(!healthy.empty()) << "All videos are quarantined";
+        reader_idx = healthy[std::uniform_int_distribution<std::size_t>(0, healthy.size() - 1)(rng_)];
+        const int64_t frame_count = readers_[reader_idx].frame_count;
+        const int64_t span = static_cast<int64_t>(shape_[0] - 1) * (intvl_ + 1) + 1;
+        int64_t start = std::uniform_int_distribution<int64_t>(0, std::max<int64_t>(frame_count - span, 0))(rng_);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = std::min(start + static_cast<int64_t>(i) * (intvl_ + 1), frame_count - 1);
+        }
+        batch = TryGetBatch(reader_idx, indices, &decoded);
+    }
     // ++curr_;
-    next_data_ = batch;
-    next_indices_.clear();
-    next_indices_.reserve(indices.size() * 2);
+    Batch ret;
+    ret.data = batch;
+    ret.decoded = decoded;
+    ret.seq = seq;
+    ret.samples = samples;
+    ret.indices.reserve(indices.size() * 2);
     for (auto idx : indices) {
         // video index first
-        next_indices_.emplace_back(static_cast<int64_t>(reader_idx));
+        ret.indices.emplace_back(static_cast<int64_t>(reader_idx));
         // frame index second
-        next_indices_.emplace_back(idx);
+        ret.indices.emplace_back(idx);
     }
-    next_ready_ = 3;
+    return ret;
+}
+
+runtime::NDArray VideoLoader::TryGetBatch(std::size_t entry, const std::vector<int64_t>& indices,
+                                          int64_t* decoded) {
+    auto reader = dynamic_cast<VideoReader*>(readers_[entry].ptr.get());
+    // image sequences decode exactly the requested pictures
+    int64_t before = reader ? reader->GetDecodedPacketCount() : 0;
+    NDArray ret;
+    try {
+        ret = readers_[entry].ptr->GetBatch(indices, NDArray());
+    } catch (const dmlc::Error& e) {
+        if (!skip_bad_) throw;
+        Quarantine(entry, e.what());
+        return NDArray();
+    }
+    *decoded += reader ? reader->GetDecodedPacketCount() - before : static_cast<int64_t>(indices.size());
+    return ret;
+}
+
+void VideoLoader::Quarantine(std::size_t entry, const std::string& reason) {
+    Entry& e = readers_[entry];
+    LOG(WARNING) << "VideoLoader: quarantined unreadable video " << e.filename << ": " << reason;
+    e.quarantined = true;
+    // free decoder and file handle
+    e.ptr.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    quarantined_.emplace_back(e.filename);
 }
 
 runtime::NDArray VideoLoader::NextData() {
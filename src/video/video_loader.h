@@ -8,8 +8,21 @@
 #define DECORD_VIDEO_VIDEO_LOADER_H_
 
 #include "video_reader.h"
+#include "image_sequence_reader.h"
+#include "loader_autotuner.h"
+#include "memory_governor.h"
 #include "../sampler/sampler_interface.h"
+#include "../sampler/weighted_sampler.h"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <decord/video_interface.h>
@@ -22,14 +35,17 @@ enum ShuffleTypes {
     kRandomShuffle,
     kRandomInFileShuffle,
     kSmartRandomShuffle,
+    kWeightedShuffle,
 };  // enum ShuffleTypes
 
-class VideoLoader : public VideoLoaderInterface {
+class VideoLoader : public VideoLoaderInterface, public MemoryConsumer {
 public:
         VideoLoader(std::vector<std::string> filenames, std::vector<DLContext> ctxs,
                           std::vector<int> shape, int interval,
                           int skip, int shuffle,
-                          int prefetch);
+                          int prefetch, bool skip_bad = false,
+                          bool autotune = false, int64_t memory_cap = 0,
+                          sampler::WeightedSamplerOptions weighted = sampler::WeightedSamplerOptions());
         ~VideoLoader();
         void Reset();
         bool HasNext() const;
@@ -37,23 +53,70 @@ public:
         void Next();
         NDArray NextData();
         NDArray NextIndices();
+        /*! \brief files that failed to open or decode, skipped for the rest of the loader's life */
+        std::vector<std::string> GetQuarantined() const;
+        /*! \brief decoder threads and prefetch depth in use */
+        LoaderConfig GetConfig() const;
+        /*! \brief weight of each file for kWeightedShuffle, used from next Reset */
+        void SetWeights(std::vector<double> weights);
+        /*! \brief true while autotuning is measuring candidates */
+        bool IsTuning() const { return tuner_ && !tuner_->Done(); }
+        /**
+         * \brief Drop newest prefetched batches but the next one, limit prefetch depth to what is left.
+         *
+         * Samples of dropped batches are decoded again in order, so batches and epoch are unchanged.
+         * The configured depth is kept, each batch produced while another fits the budget restores one.
+         */
+        int64_t ReleaseMemory(int64_t bytes);
 
     private:
-        using ReaderPtr = std::shared_ptr<VideoReader>;
+        using ReaderPtr = VideoReaderPtr;
         struct Entry {
             ReaderPtr ptr;
             std::vector<int64_t> key_indices;
             int64_t frame_count;
+            std::string filename;
+            bool quarantined;
 
-            Entry(ReaderPtr p, std::vector<int64_t> keys, int64_t frames)
-                : ptr(p), key_indices(keys), frame_count(frames) {}
+            Entry(ReaderPtr p, std::vector<int64_t> keys, int64_t frames, std::string fn)
+                : ptr(p), key_indices(keys), frame_count(frames), filename(fn), quarantined(false) {}
         };
+        /*! \brief decoded batch with video and frame index of each frame */
+        struct Batch {
+            NDArray data;
+            std::vector<int64_t> indices;
+            /*! \brief packets decoded to produce it, measures decode amplification */
+            int64_t decoded;
+            /*! \brief position in epoch and sampler output, to decode it again if dropped */
+            int64_t seq;
+            sampler::Samples samples;
+        };  // struct Batch
+        /*! \brief sample and decode next batch, sampler must have next */
+        Batch ProduceBatch();
+        /*! \brief background producer filling prefetched_ up to prefetch_ batches */
+        void PrefetchLoop();
+        void StartPrefetch();
+        /*! \brief join producer, prefetched batches are kept */
+        void StopPrefetch();
+        /*! \brief switch decoder threads and prefetch depth, batches already sampled are kept */
+        void ApplyConfig(const LoaderConfig& config);
+        /*! \brief GetBatch of entry, undefined and quarantined on failure if skip_bad_, adds packets decoded */
+        NDArray TryGetBatch(std::size_t entry, const std::vector<int64_t>& indices, int64_t* decoded);
+        void Quarantine(std::size_t entry, const std::string& reason);
         std::vector<Entry> readers_;
+        /*! \brief entry of each video known by sampler, unreadable files are not sampled */
+        std::vector<std::size_t> sampled_entries_;
+        bool skip_bad_;
+        std::vector<std::string> quarantined_;
+        std::mt19937 rng_;
         std::vector<int> shape_;
         int intvl_;
         int skip_;
         int shuffle_;
+        /*! \brief configured prefetch depth, reported by GetConfig */
         int prefetch_;
+        /*! \brief depth allowed by memory governor, at most prefetch_ */
+        int prefetch_limit_;
         char next_ready_;  // ready flag, use with 0xFE for data, 0xFD for label
         NDArray next_data_;
         std::vector<int64_t> next_indices_;
@@ -64,6 +127,24 @@ public:
         // std::size_t curr_;
         std::vector<DLContext> ctxs_;
         NDArrayPool ndarray_pool_;
+        int decoder_threads_;
+        /*! \brief batches returned in current epoch */
+        int64_t consumed_;
+        /*! \brief guards prefetched_, producer state and quarantined_ */
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread prefetch_thread_;
+        std::deque<Batch> prefetched_;
+        /*! \brief bytes of prefetched_, charged to memory governor */
+        int64_t prefetched_bytes_;
+        /*! \brief samples of batches dropped to release memory, by seq, produced before sampling more */
+        std::map<int64_t, sampler::Samples> requeued_;
+        /*! \brief seq of next batch taken from sampler */
+        int64_t next_seq_;
+        bool prefetch_stop_;
+        bool prefetch_done_;
+        std::exception_ptr prefetch_error_;
+        std::unique_ptr<LoaderAutotuner> tuner_;
 };  // class VideoLoader
 }  // namespace decord
 
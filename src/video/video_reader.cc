@@ -10,6 +10,7 @@
 #include "nvcodec/cuda_threaded_decoder.h"
 #endif
 #include <algorithm>
+#include <thread>
 #include <decord/runtime/ndarray.h>
 
 namespace decord {
@@ -21,9 +22,73 @@ using FFMPEGThreadedDecoder = ffmpeg::FFMPEGThreadedDecoder;
 using AVFramePool = ffmpeg::AVFramePool;
 using AVPacketPool = ffmpeg::AVPacketPool;
 
-VideoReader::VideoReader(std::string fn, DLContext ctx, int width, int height)
-     : ctx_(ctx), codecs_(), actv_stm_idx_(-1), decoder_(), curr_frame_(0),
-     width_(width), height_(height), eof_(false) {
+/*! \brief number of keyframes sampled for crop detection */
+static const std::size_t kCropDetectSamples = 5;
+/*! \brief maximum packets fed to decoder for one sample */
+static const int kCropDetectMaxPackets = 64;
+/*! \brief consecutive demuxing errors skipped before giving up on the rest of the file */
+static const int kMaxDemuxRetries = 16;
+/*! \brief reference frames assumed held by a decoder on top of one frame per thread */
+static const int kDecoderRefFrames = 4;
+
+/**
+ * \brief Scope of a public call.
+ *
+ * Marks the reader busy, so the memory governor leaves its decoder alone, and reopens a decoder
+ * the governor closed. Nested calls, e.g. seeking inside GetBatch, only add depth.
+ */
+class VideoReader::UseGuard {
+    public:
+        UseGuard(VideoReader* reader, bool resume, bool restore = false)
+            : reader_(reader), lock_(reader->use_mutex_) {
+            ++reader_->busy_;
+            reader_->last_use_ = MemoryGovernor::Get()->Tick();
+            if (resume && reader_->suspended_) reader_->Resume(restore);
+        }
+        ~UseGuard() { --reader_->busy_; }
+
+    private:
+        VideoReader* reader_;
+        std::lock_guard<std::recursive_mutex> lock_;
+};  // class VideoReader::UseGuard
+
+VideoReader::VideoReader(std::string fn, DLContext ctx, int width, int height, FrameOptions opts, int stream_nb)
+     : fn_(fn), ctx_(ctx), codecs_(), actv_stm_idx_(-1), decoder_(), curr_frame_(0),
+     width_(width), height_(height), frame_opts_(opts), eof_(false), shared_index_(false), demux_errors_(0),
+     decoder_threads_(0), decoded_packets_(0), decode_errors_(0), busy_(0), suspended_(false), last_use_(0),
+     decoder_memory_(0), decoder_estimate_(0) {
+    OpenInput(fn);
+    // find best video stream (-1 means auto, relay on FFMPEG or pick rendition by output size)
+    SetVideoStream(stream_nb);
+    // LOG(INFO) << "Set video stream";
+    MemoryGovernor::Get()->Register(this, kMemoryReader);
+
+    // // allocate AVFrame buffer
+    // frame_ = av_frame_alloc();
+    // CHECK(frame_) << "ERROR failed to allocated memory for AVFrame";
+
+    // // allocate AVPacket buffer
+    // pkt_ = av_packet_alloc();
+    // CHECK(pkt_) << "ERROR failed to allocated memory for AVPacket";
+}
+
+VideoReader::VideoReader(const VideoReader& proto)
+     : fn_(proto.fn_), ctx_(proto.ctx_), key_indices_(proto.key_indices_), codecs_(), actv_stm_idx_(-1),
+     decoder_(), curr_frame_(0), width_(proto.width_), height_(proto.height_),
+     frame_opts_(proto.frame_opts_), eof_(false), shared_index_(true), demux_errors_(0),
+     decoder_threads_(proto.decoder_threads_), decoded_packets_(0), decode_errors_(0), busy_(0), suspended_(false),
+     last_use_(0), decoder_memory_(0), decoder_estimate_(0) {
+    // output size and detected crop are final, stream is the one picked by prototype
+    OpenInput(fn_);
+    SetVideoStream(proto.actv_stm_idx_);
+    MemoryGovernor::Get()->Register(this, kMemoryReader);
+}
+
+std::unique_ptr<VideoReader> VideoReader::Clone() const {
+    return std::unique_ptr<VideoReader>(new VideoReader(*this));
+}
+
+void VideoReader::OpenInput(const std::string& fn) {
     // av_register_all deprecated in latest versions
     #if ( LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58,9,100) )
     av_register_all();
@@ -62,29 +127,61 @@ VideoReader::VideoReader(std::string fn, DLContext ctx, int width, int height)
         }
     }
     // LOG(INFO) << "initialized all streams";
-    // find best video stream (-1 means auto, relay on FFMPEG)
-    SetVideoStream(-1);
-    // LOG(INFO) << "Set video stream";
-    decoder_->Start();
-
-    // // allocate AVFrame buffer
-    // frame_ = av_frame_alloc();
-    // CHECK(frame_) << "ERROR failed to allocated memory for AVFrame";
-
-    // // allocate AVPacket buffer
-    // pkt_ = av_packet_alloc();
-    // CHECK(pkt_) << "ERROR failed to allocated memory for AVPacket";
 }
 
 VideoReader::~VideoReader(){
-    // avformat_free_context(fmt_ctx_);
-    // avformat_close_input(&fmt_ctx_);
-    // LOG(INFO) << "Destruct Video REader";
+    MemoryGovernor::Get()->Unregister(this);
+    // stop worker and free codec before the demuxer its packets came from
+    decoder_.reset();
+    ChargeDecoder(0);
+    fmt_ctx_.reset();
+}
+
+int VideoReader::SelectRendition(AVFormatContext *fmt_ctx, int width, int height, bool autorotate) {
+    int best = -1;
+    int64_t best_area = 0;
+    int largest = -1;
+    int64_t largest_area = 0;
+    for (uint32_t i = 0; i < fmt_ctx->nb_streams; ++i) {
+        AVStream *st = fmt_ctx->streams[i];
+        if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) continue;
+        if (!avcodec_find_decoder(st->codecpar->codec_id)) continue;
+        if (st->disposition & AV_DISPOSITION_ATTACHED_PIC) continue;
+        int w = st->codecpar->width;
+        int h = st->codecpar->height;
+        if (w < 1 || h < 1) continue;
+        if (autorotate) {
+            // compare in display orientation
+            int rotation = 0;
+            bool hflip = false;
+            ffmpeg::GetDisplayOrientation(st, &rotation, &hflip);
+            if (rotation == 90 || rotation == 270) std::swap(w, h);
+        }
+        int64_t area = static_cast<int64_t>(w) * h;
+        if (area > largest_area) {
+            largest = i;
+            largest_area = area;
+        }
+        bool sufficient = (width < 1 || w >= width) && (height < 1 || h >= height);
+        if (sufficient && (best < 0 || area < best_area)) {
+            best = i;
+            best_area = area;
+        }
+    }
+    // nothing large enough, keep as much detail as possible
+    return best >= 0 ? best : largest;
 }
 
 void VideoReader::SetVideoStream(int stream_nb) {
+    // opens a decoder anyway, no need to resume a closed one
+    UseGuard guard(this, false);
+    suspended_ = false;
     CHECK(fmt_ctx_ != NULL);
     AVCodec *dec;
+    if (stream_nb < 0 && (width_ > 0 || height_ > 0)) {
+        // several renditions of same content, decode the smallest one covering output size
+        stream_nb = SelectRendition(fmt_ctx_.get(), width_, height_, frame_opts_.autorotate);
+    }
     int st_nb = av_find_best_stream(fmt_ctx_.get(), AVMEDIA_TYPE_VIDEO, stream_nb, -1, &dec, 0);
     // LOG(INFO) << "find best stream: " << st_nb;
     CHECK_GE(st_nb, 0) << "ERROR cannot find video stream with wanted index: " << stream_nb;
@@ -95,9 +192,16 @@ void VideoReader::SetVideoStream(int stream_nb) {
     codecpar.reset(avcodec_parameters_alloc());
     CHECK_GE(avcodec_parameters_copy(codecpar.get(), fmt_ctx_->streams[st_nb]->codecpar), 0)
         << "Error copy stream->codecpar to buffer codecpar";
+    if (decoder_) decode_errors_ += decoder_->GetErrorCount();
     if (kDLCPU == ctx_.device_type) {
         decoder_ = std::unique_ptr<ThreadedDecoderInterface>(new FFMPEGThreadedDecoder());
     } else if (kDLGPU == ctx_.device_type) {
+        CHECK(frame_opts_.pix_fmt == AV_PIX_FMT_RGB24 && !frame_opts_.tone_mapping)
+            << "GPU decoding only supports RGB24 output without tone mapping.";
+        if (frame_opts_.deinterlace != kDeinterlaceNone) {
+            LOG(WARNING) << "Deinterlacing is not supported by GPU decoding, ignored.";
+            frame_opts_.deinterlace = kDeinterlaceNone;
+        }
 #ifdef DECORD_USE_CUDA
         // note: cuda threaded decoder will modify codecpar
         decoder_ = std::unique_ptr<ThreadedDecoderInterface>(new cuda::CUThreadedDecoder(
@@ -109,33 +213,55 @@ void VideoReader::SetVideoStream(int stream_nb) {
         LOG(FATAL) << "Unknown device type: " << ctx_.device_type;
     }
 
-    auto dec_ctx = avcodec_alloc_context3(dec);
-	dec_ctx->thread_count = 0;
+    // owned here until handed to decoder, freed if anything below fails
+    ffmpeg::AVCodecContextPtr dec_ctx_holder(avcodec_alloc_context3(dec));
+    AVCodecContext *dec_ctx = dec_ctx_holder.get();
+    CHECK(dec_ctx) << "ERROR allocating codec context";
+	dec_ctx->thread_count = decoder_threads_;
+    // conceal damaged macroblocks instead of dropping frames
+    dec_ctx->error_concealment = FF_EC_GUESS_MVS | FF_EC_DEBLOCK;
 	// LOG(INFO) << "Original decoder multithreading: " << dec_ctx->thread_count;
     // CHECK_GE(avcodec_copy_context(dec_ctx, fmt_ctx_->streams[stream_nb]->codec), 0) << "Error: copy context";
     // CHECK_GE(avcodec_parameters_to_context(dec_ctx, fmt_ctx_->streams[st_nb]->codecpar), 0) << "Error: copy parameters to codec context.";
     // copy codec parameters to context
     CHECK_GE(avcodec_parameters_to_context(dec_ctx, codecpar.get()), 0)
         << "ERROR copying codec parameters to context";
-    // initialize AVCodecContext to use given AVCodec
-    int open_ret = avcodec_open2(dec_ctx, codecs_[st_nb], NULL);
-    if (open_ret < 0 ) {
-        char errstr[200];
-        av_strerror(open_ret, errstr, 200);
-        LOG(FATAL) << "ERROR open codec through avcodec_open2: " << errstr;
-        return;
-    }
-    // CHECK_GE(avcodec_open2(dec_ctx, codecs_[st_nb], NULL), 0)
-    //     << "ERROR open codec through avcodec_open2";
-    // LOG(INFO) << "codecs opened.";
+    // codec is opened by the decoder on first use, idle readers hold no codec buffers or frame threads
     actv_stm_idx_ = st_nb;
     // LOG(INFO) << "time base: " << fmt_ctx_->streams[st_nb]->time_base.num << " / " << fmt_ctx_->streams[st_nb]->time_base.den;
     dec_ctx->time_base = fmt_ctx_->streams[st_nb]->time_base;
+    frame_opts_.rotation = 0;
+    frame_opts_.hflip = false;
+    if (frame_opts_.autorotate) {
+        ffmpeg::GetDisplayOrientation(fmt_ctx_->streams[st_nb], &frame_opts_.rotation, &frame_opts_.hflip);
+        if (kDLGPU == ctx_.device_type && (frame_opts_.rotation != 0 || frame_opts_.hflip)) {
+            LOG(WARNING) << "Display rotation is not supported by GPU decoding, ignored.";
+            frame_opts_.rotation = 0;
+            frame_opts_.hflip = false;
+        }
+    }
+    if (shared_index_) {
+        // index and crop rectangle are taken from the prototype reader
+        shared_index_ = false;
+    } else {
+        frame_opts_.crop = improc::CropRect();
+        if (frame_opts_.crop_detect && kDLGPU == ctx_.device_type) {
+            LOG(WARNING) << "Crop detection is not supported by GPU decoding, ignored.";
+            frame_opts_.crop_detect = false;
+        }
+        // index before decoder setup, crop rectangle is detected along with the index
+        IndexKeyframes();
+    }
+    const improc::CropRect& crop = frame_opts_.crop;
+    int src_width = crop.Empty() ? codecpar->width : crop.width;
+    int src_height = crop.Empty() ? codecpar->height : crop.height;
+    // default output size follows display orientation
+    bool transposed = frame_opts_.rotation == 90 || frame_opts_.rotation == 270;
     if (width_ < 1) {
-        width_ = codecpar->width;
+        width_ = transposed ? src_height : src_width;
     }
     if (height_ < 1) {
-        height_ = codecpar->height;
+        height_ = transposed ? src_width : src_height;
     }
 
     // adjust width to match cpu alignment
@@ -151,9 +277,24 @@ void VideoReader::SetVideoStream(int stream_nb) {
     //     width_ = new_width;
     //     height_ = new_height;
     // }
-    ndarray_pool_ = NDArrayPool(32, {height_, width_, 3}, kUInt8, ctx_);
-    decoder_->SetCodecContext(dec_ctx, width_, height_);
-    IndexKeyframes();
+    ndarray_pool_.Init(32, ffmpeg::FrameShape(frame_opts_.pix_fmt, height_, width_),
+                       ffmpeg::FrameDType(frame_opts_.pix_fmt), ctx_);
+    decoder_->SetCodecContext(dec_ctx_holder.release(), width_, height_, frame_opts_);
+    // rewind after indexing, decoder is started on first use
+    if (av_seek_frame(fmt_ctx_.get(), actv_stm_idx_, 0, AVSEEK_FLAG_BACKWARD) < 0) {
+        LOG(WARNING) << "Failed to seek file to position: 0";
+    }
+    curr_frame_ = 0;
+    eof_ = false;
+    // frames held by FFmpeg in source resolution 4:2:0, plus one converted output frame
+    int64_t threads = decoder_threads_ > 0 ? decoder_threads_
+        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int64_t src_bytes = static_cast<int64_t>(codecpar->width) * codecpar->height * 3 / 2;
+    int64_t out_bytes = (ffmpeg::FrameDType(frame_opts_.pix_fmt).bits + 7) / 8;
+    for (auto dim : ffmpeg::FrameShape(frame_opts_.pix_fmt, height_, width_)) out_bytes *= dim;
+    decoder_estimate_ = src_bytes * (threads + kDecoderRefFrames) + out_bytes;
+    // charged once decoding starts
+    ChargeDecoder(0);
     // LOG(INFO) << "Printing key frames...";
     // for (auto i : key_indices_) {
     //     LOG(INFO) << i;
@@ -231,6 +372,7 @@ std::vector<int64_t> VideoReader::FramesToPTS(const std::vector<int64_t>& positi
 }
 
 bool VideoReader::Seek(int64_t pos) {
+    UseGuard guard(this, true);
     if (curr_frame_ == pos) return true;
     decoder_->Clear();
     eof_ = false;
@@ -248,7 +390,7 @@ bool VideoReader::Seek(int64_t pos) {
     //                             0);
     if (ret < 0) LOG(WARNING) << "Failed to seek file to position: " << pos;
     // LOG(INFO) << "seek return: " << ret;
-    decoder_->Start();
+    StartDecoder();
     if (ret >= 0) {
         curr_frame_ = pos;
     }
@@ -264,6 +406,7 @@ int64_t VideoReader::LocateKeyframe(int64_t pos) {
 }
 
 bool VideoReader::SeekAccurate(int64_t pos) {
+    UseGuard guard(this, true);
     if (curr_frame_ == pos) return true;
     int64_t key_pos = LocateKeyframe(pos);
     int64_t curr_key_pos = LocateKeyframe(curr_frame_);
@@ -288,10 +431,17 @@ void VideoReader::PushNext() {
     // AVPacket *packet = av_packet_alloc();
     AVPacketPtr packet = AVPacketPool::Get()->Acquire();
     int ret = -1;
+    int failures = 0;
     while (!eof_) {
         ret = av_read_frame(fmt_ctx_.get(), packet.get());
+        if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR_EXIT && ++failures <= kMaxDemuxRetries) {
+            // damaged container data, demuxer resyncs on the next read
+            ++demux_errors_;
+            continue;
+        }
         if (ret < 0) {
-            if (ret == AVERROR_EOF) {
+            if (ret == AVERROR_EOF || failures > kMaxDemuxRetries) {
+                if (ret != AVERROR_EOF) LOG(WARNING) << "Demuxing failed repeatedly, treated as end of file";
                 eof_ = true;
                 // flush buffer
                 if (ctx_.device_type != kDLGPU) {
@@ -307,6 +457,8 @@ void VideoReader::PushNext() {
             }
             return;
         }
+        // retries only bound consecutive failures, e.g. reads of other streams in between reset them
+        failures = 0;
         if (packet->stream_index == actv_stm_idx_) {
             // LOG(INFO) << "Packet index: " << packet->stream_index << " vs. " << actv_stm_idx_;
             // av_packet_unref(packet);
@@ -331,6 +483,7 @@ void VideoReader::PushNext() {
                     // use preallocated memory pool for GPU
                     decoder_->Push(packet, ndarray_pool_.Acquire());
                 }
+            ++decoded_packets_;
             // LOG(INFO) << "Pushed packet to decoder.";
             break;
         }
@@ -340,7 +493,7 @@ void VideoReader::PushNext() {
 
 NDArray VideoReader::NextFrameImpl() {
     NDArray frame;
-    decoder_->Start();
+    StartDecoder();
     bool ret = false;
     int rewind_offset = 0;
     while (!ret) {
@@ -364,11 +517,13 @@ NDArray VideoReader::NextFrameImpl() {
 }
 
 NDArray VideoReader::NextFrame() {
+    UseGuard guard(this, true, true);
     return  NextFrameImpl();
 }
 
 void VideoReader::IndexKeyframes() {
     key_indices_.clear();
+    std::vector<int64_t> key_pts;
     AVPacketPtr packet = AVPacketPool::Get()->Acquire();
     int ret = -1;
     bool eof = false;
@@ -387,13 +542,67 @@ void VideoReader::IndexKeyframes() {
         if (packet->stream_index == actv_stm_idx_) {
             if (packet->flags & AV_PKT_FLAG_KEY) {
                 key_indices_.emplace_back(cnt);
+                int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                if (pts != AV_NOPTS_VALUE) key_pts.emplace_back(pts);
             }
             ++cnt;
         }
         av_packet_unref(packet.get());
     }
-    curr_frame_ = GetFrameCount();
-	ret = Seek(0);
+    if (frame_opts_.crop_detect) {
+        frame_opts_.crop = DetectCrop(key_pts);
+    }
+}
+
+improc::CropRect VideoReader::DetectCrop(const std::vector<int64_t>& key_pts) {
+    improc::CropRect rect;
+    if (key_pts.empty()) return rect;
+    AVStream *st = fmt_ctx_->streams[actv_stm_idx_];
+    AVCodec *dec = codecs_[actv_stm_idx_];
+    // standalone software decoder, only a handful of keyframes are decoded
+    ffmpeg::AVCodecContextPtr dec_ctx(avcodec_alloc_context3(dec));
+    CHECK_GE(avcodec_parameters_to_context(dec_ctx.get(), st->codecpar), 0)
+        << "ERROR copying codec parameters to context";
+    CHECK_GE(avcodec_open2(dec_ctx.get(), dec, NULL), 0) << "ERROR open codec for crop detection";
+    AVPacketPtr packet = AVPacketPool::Get()->Acquire();
+    AVFramePtr frame = AVFramePool::Get()->Acquire();
+    std::size_t num_samples = std::min(kCropDetectSamples, key_pts.size());
+    for (std::size_t i = 0; i < num_samples; ++i) {
+        // spread over the video, away from the very beginning which is often a black intro
+        int64_t pts = key_pts[(2 * i + 1) * key_pts.size() / (2 * num_samples)];
+        if (av_seek_frame(fmt_ctx_.get(), actv_stm_idx_, pts, AVSEEK_FLAG_BACKWARD) < 0) continue;
+        avcodec_flush_buffers(dec_ctx.get());
+        for (int n = 0; n < kCropDetectMaxPackets; ) {
+            int ret = av_read_frame(fmt_ctx_.get(), packet.get());
+            if (ret >= 0 && packet->stream_index != actv_stm_idx_) {
+                av_packet_unref(packet.get());
+                continue;
+            }
+            ++n;
+            // send NULL packet to drain decoder at end of file
+            avcodec_send_packet(dec_ctx.get(), ret < 0 ? NULL : packet.get());
+            if (ret >= 0) av_packet_unref(packet.get());
+            if (avcodec_receive_frame(dec_ctx.get(), frame.get()) == 0) {
+                const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+                if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))) {
+                    LOG(WARNING) << "Crop detection requires YUV or gray frames, ignored.";
+                    return improc::CropRect();
+                }
+                const AVComponentDescriptor& luma = desc->comp[0];
+                rect = improc::UnionRect(rect, improc::DetectActiveArea(
+                    frame->data[luma.plane] + luma.offset, frame->linesize[luma.plane], luma.step,
+                    luma.depth + luma.shift, frame->width, frame->height));
+                av_frame_unref(frame.get());
+                break;
+            }
+            if (ret < 0) break;
+        }
+    }
+    if (rect.width == st->codecpar->width && rect.height == st->codecpar->height) {
+        // nothing to crop
+        return improc::CropRect();
+    }
+    return rect;
 }
 
 runtime::NDArray VideoReader::GetKeyIndices() {
@@ -422,11 +631,75 @@ double VideoReader::GetAverageFPS() const {
     return static_cast<double>(active_st->avg_frame_rate.num) / active_st->avg_frame_rate.den;
 }
 
+void VideoReader::SetDecoderThreads(int num) {
+    num = std::max(0, num);
+    if (num == decoder_threads_) return;
+    std::lock_guard<std::recursive_mutex> lock(use_mutex_);
+    decoder_threads_ = num;
+    // closed decoder picks up the thread count when reopened
+    if (suspended_) return;
+    // thread count is fixed once codec is opened, reopen it on the same stream without indexing again
+    shared_index_ = true;
+    SetVideoStream(actv_stm_idx_);
+}
+
+int64_t VideoReader::GetDecodeErrorCount() const {
+    // decoder may be closed by ReleaseMemory on another thread
+    std::lock_guard<std::recursive_mutex> lock(use_mutex_);
+    return decode_errors_ + (decoder_ ? decoder_->GetErrorCount() : 0);
+}
+
+int64_t VideoReader::GetDemuxErrorCount() const {
+    // may be read while a speculative decoder reads on another thread
+    std::lock_guard<std::recursive_mutex> lock(use_mutex_);
+    return demux_errors_;
+}
+
+bool VideoReader::IsSuspended() const {
+    std::lock_guard<std::recursive_mutex> lock(use_mutex_);
+    return suspended_;
+}
+
+void VideoReader::StartDecoder() {
+    decoder_->Start();
+    ChargeDecoder(decoder_estimate_);
+}
+
+void VideoReader::ChargeDecoder(int64_t bytes) {
+    MemoryGovernor::Get()->Charge(kMemoryReader, bytes - decoder_memory_);
+    bool grown = bytes > decoder_memory_;
+    decoder_memory_ = bytes;
+    // this reader is busy while opening, the governor looks elsewhere
+    if (grown) MemoryGovernor::Get()->Enforce();
+}
+
+int64_t VideoReader::ReleaseMemory(int64_t /*bytes*/) {
+    std::unique_lock<std::recursive_mutex> lock(use_mutex_, std::try_to_lock);
+    // in use by another thread, or by the call on this thread that is enforcing the budget
+    if (!lock.owns_lock() || busy_ > 0 || suspended_ || !decoder_ || decoder_memory_ == 0) return 0;
+    int64_t released = decoder_memory_;
+    decode_errors_ += decoder_->GetErrorCount();
+    // joins frame threads and frees codec context, file and index are kept
+    decoder_.reset();
+    suspended_ = true;
+    ChargeDecoder(0);
+    return released;
+}
+
+void VideoReader::Resume(bool restore) {
+    const int64_t pos = curr_frame_;
+    // same stream, index and crop are kept
+    shared_index_ = true;
+    SetVideoStream(actv_stm_idx_);
+    if (restore && pos > 0 && pos < GetFrameCount()) SeekAccurate(pos);
+}
+
 std::vector<int64_t> VideoReader::GetKeyIndicesVector() const {
     return key_indices_;
 }
 
 void VideoReader::SkipFrames(int64_t num) {
+    UseGuard guard(this, true, true);
     // check if skip pass keyframes, if so, we can seek to latest keyframe first
     // LOG(INFO) << " Skip Frame start: " << num << " current frame: " << curr_frame_;
     if (num < 1) return;
@@ -447,7 +720,7 @@ void VideoReader::SkipFrames(int64_t num) {
 
     // LOG(INFO) << "started skipping with: " << num;
     NDArray frame;
-    decoder_->Start();
+    StartDecoder();
     bool ret = false;
     std::vector<int64_t> frame_pos(num);
     std::iota(frame_pos.begin(), frame_pos.end(), curr_frame_);
@@ -465,6 +738,7 @@ void VideoReader::SkipFrames(int64_t num) {
 }
 
 NDArray VideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
+    UseGuard guard(this, true);
     std::size_t bs = indices.size();
     // find the first occurance of each index to avoid duplicate access
     std::unordered_map<int64_t, std::size_t> unique_indices;
@@ -476,13 +750,16 @@ NDArray VideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
             unique_indices[value] = i;
         }
     }
+    std::vector<int64_t> frame_shape = ffmpeg::FrameShape(frame_opts_.pix_fmt, height_, width_);
+    DLDataType frame_dtype = ffmpeg::FrameDType(frame_opts_.pix_fmt);
     if (!buf.defined()) {
-        buf = NDArray::Empty({static_cast<int64_t>(bs), height_, width_, 3}, kUInt8, ctx_);
+        std::vector<int64_t> buf_shape = {static_cast<int64_t>(bs)};
+        buf_shape.insert(buf_shape.end(), frame_shape.begin(), frame_shape.end());
+        buf = NDArray::Empty(buf_shape, frame_dtype, ctx_);
     }
     // LOG(INFO) << height_ << " "  << width_ << " Buf size: " << bs << " total: " << bs * height_ * width_ * 3;
     int64_t frame_count = GetFrameCount();
     uint64_t offset = 0;
-    std::vector<int64_t> frame_shape = {height_, width_, 3};
     for (std::size_t i = 0; i < indices.size(); ++i) {
         int64_t pos = indices[i];
         auto it = unique_indices.find(pos);
@@ -491,8 +768,8 @@ NDArray VideoReader::GetBatch(std::vector<int64_t> indices, NDArray buf) {
             CHECK(i > it->second);
             CHECK(i > 0);
             uint64_t old_offset = offset / i * it->second;
-            auto old_view = buf.CreateOffsetView(frame_shape, kUInt8, &old_offset);
-            auto view = buf.CreateOffsetView(frame_shape, kUInt8, &offset);
+            auto old_view = buf.CreateOffsetView(frame_shape, frame_dtype, &old_offset);
+            auto view = buf.CreateOffsetView(frame_shape, frame_dtype, &offset);
             old_view.CopyTo(view); 
         }
         else {
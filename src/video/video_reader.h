@@ -9,8 +9,12 @@
 
 #include "threaded_decoder_interface.h"
 #include "storage_pool.h"
+#include "memory_governor.h"
 #include <decord/video_interface.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -20,15 +24,37 @@
 
 namespace decord {
 
-class VideoReader : public VideoReaderInterface {
+/**
+ * \brief FFmpeg video reader.
+ *
+ * Registered with the memory governor, which may close the decoder of an idle reader, the file stays
+ * open and the decoder is reopened at the same position on next use.
+ */
+class VideoReader : public VideoReaderInterface, public MemoryConsumer {
     using ThreadedDecoderPtr = std::unique_ptr<ThreadedDecoderInterface>;
     using NDArray = runtime::NDArray;
     public:
-        VideoReader(std::string fn, DLContext ctx, int width=-1, int height=-1);
+        /**
+         * \brief Open a video file and index its stream.
+         *
+         * \param stream_nb Video stream to decode, an explicit index is always kept, -1 picks one:
+         * the smallest rendition covering width and height if given, otherwise FFmpeg's best stream
+         */
+        VideoReader(std::string fn, DLContext ctx, int width=-1, int height=-1,
+                    FrameOptions opts=FrameOptions(), int stream_nb=-1);
+        /**
+         * \brief New cursor on the same file with its own demuxer and decoder.
+         *
+         * Index, output size and detected crop are copied, so the file is not scanned again.
+         * Only settings fixed at construction are read, safe while this reader is in use.
+         */
+        std::unique_ptr<VideoReader> Clone() const;
         /*! \brief Destructor, note that FFMPEG resources has to be managed manually to avoid resource leak */
         ~VideoReader();
         void SetVideoStream(int stream_nb = -1);
         unsigned int QueryStreams() const;
+        /*! \brief index of the decoded video stream */
+        int GetVideoStream() const { return actv_stm_idx_; }
         int64_t GetFrameCount() const;
         int64_t GetCurrentPosition() const;
         NDArray NextFrame();
@@ -38,17 +64,63 @@ class VideoReader : public VideoReaderInterface {
         bool SeekAccurate(int64_t pos);
         runtime::NDArray GetKeyIndices();
         double GetAverageFPS() const;
+        /*! \brief output frame width */
+        int GetWidth() const { return width_; }
+        /*! \brief output frame height */
+        int GetHeight() const { return height_; }
+        /*! \brief packets that failed to decode, concealed by repeating the previous frame */
+        int64_t GetDecodeErrorCount() const;
+        /*! \brief damaged container reads skipped */
+        int64_t GetDemuxErrorCount() const;
+        /*! \brief reopen decoder with num threads, 0 lets FFmpeg decide, index is kept */
+        void SetDecoderThreads(int num);
+        int GetDecoderThreads() const { return decoder_threads_; }
+        /*! \brief packets sent to decoder so far, including frames decoded only to reach a target */
+        int64_t GetDecodedPacketCount() const { return decoded_packets_; }
+        /**
+         * \brief close decoder if idle, frees codec buffers and frame threads
+         *
+         * All or nothing: a decoder cannot shrink, so the whole decoder is released whatever the
+         * bytes wanted. The governor asks least recently used readers first, so an active reader
+         * is only closed if idle ones did not free enough.
+         */
+        int64_t ReleaseMemory(int64_t bytes);
+        int64_t LastUse() const { return last_use_.load(); }
+        /*! \brief decoder is closed by memory governor until next use */
+        bool IsSuspended() const;
+        /**
+         * \brief smallest video stream with resolution no less than output size, -1 if none
+         *
+         * Reads stream headers only, so a probe picks the stream a reader opened at that size decodes.
+         */
+        static int SelectRendition(AVFormatContext *fmt_ctx, int width, int height, bool autorotate);
     protected:
         friend class VideoLoader;
         std::vector<int64_t> GetKeyIndicesVector() const;
     private:
+        /*! \brief scope of a public call, see video_reader.cc */
+        class UseGuard;
+        /*! \brief cursor sharing index of proto, see Clone */
+        explicit VideoReader(const VideoReader& proto);
+        /*! \brief open file and record codecs of all streams */
+        void OpenInput(const std::string& fn);
         void IndexKeyframes();
+        /*! \brief detect black borders on a few keyframes, empty if nothing to crop */
+        improc::CropRect DetectCrop(const std::vector<int64_t>& key_pts);
         void PushNext();
         int64_t LocateKeyframe(int64_t pos);
         NDArray NextFrameImpl();
         int64_t FrameToPTS(int64_t pos);
         std::vector<int64_t> FramesToPTS(const std::vector<int64_t>& positions);
+        /*! \brief reopen decoder closed by ReleaseMemory, seek back to position if restore */
+        void Resume(bool restore);
+        /*! \brief update estimated decoder memory charged to governor */
+        void ChargeDecoder(int64_t bytes);
+        /*! \brief open codec and start decoder thread on first use, charge its memory */
+        void StartDecoder();
 
+        /*! \brief file name, kept for Clone */
+        std::string fn_;
         DLContext ctx_;
         std::vector<int64_t> key_indices_;
         /*! \brief Video Streams Codecs in original videos */
@@ -61,8 +133,24 @@ class VideoReader : public VideoReaderInterface {
         int64_t curr_frame_;  // current frame location
         int width_;   // output video width
         int height_;  // output video height
+        FrameOptions frame_opts_;  // output pixel format and conversions
         bool eof_;  // end of file indicator
+        bool shared_index_;  // index is copied from prototype, skip scanning in SetVideoStream
+        int64_t demux_errors_;  // damaged reads skipped by PushNext
+        int decoder_threads_;  // codec thread count, 0 for auto
+        int64_t decoded_packets_;  // packets pushed to decoder
+        int64_t decode_errors_;  // errors of decoders replaced so far
         NDArrayPool ndarray_pool_;
+        /*! \brief held by public calls and accessors of decoder state, ReleaseMemory only closes decoder if it can take it */
+        mutable std::recursive_mutex use_mutex_;
+        /*! \brief nesting depth of public calls on the thread holding use_mutex_ */
+        int busy_;
+        bool suspended_;
+        std::atomic<int64_t> last_use_;
+        /*! \brief estimated decoder memory charged to governor */
+        int64_t decoder_memory_;
+        /*! \brief estimated memory of running decoder of current stream */
+        int64_t decoder_estimate_;
 };  // class VideoReader
 }  // namespace decord
 #endif  // DECORD_VIDEO_VIDEO_READER_H_
@@ -0,0 +1,293 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file video_writer.cc
+ * \brief FFmpeg threaded video writer, implements VideoWriterInterface
+ */
+
+#include "video_writer.h"
+
+#include <dmlc/logging.h>
+
+namespace decord {
+
+using NDArray = runtime::NDArray;
+using AVFramePool = ffmpeg::AVFramePool;
+using AVPacketPool = ffmpeg::AVPacketPool;
+
+VideoWriter::VideoWriter(std::string fn, double fps, int width, int height, EncoderOptions opts)
+    : fn_(fn), fps_(fps), width_(width), height_(height), opts_(opts), stream_(nullptr),
+    in_width_(-1), in_height_(-1), opened_(false), closed_(false), next_pts_(0),
+    submitted_(0), encoded_(0), pkt_pushed_(0), pkt_muxed_(0), failed_(false) {
+    CHECK_GT(fps_, 0) << "Invalid fps: " << fps_;
+    CHECK_GT(opts_.queue_size, 0) << "Invalid queue size: " << opts_.queue_size;
+    CHECK(opts_.thread_type == FF_THREAD_FRAME || opts_.thread_type == FF_THREAD_SLICE)
+        << "Invalid encoder thread type: " << opts_.thread_type;
+    if (width_ > 0 && height_ > 0) Open(width_, height_);
+}
+
+VideoWriter::~VideoWriter() {
+    try {
+        Close();
+    } catch (const std::exception& e) {
+        LOG(WARNING) << "Error closing " << fn_ << ": " << e.what();
+    }
+}
+
+void VideoWriter::Open(int width, int height) {
+    width_ = width;
+    height_ = height;
+    AVFormatContext *fmt_ctx = nullptr;
+    CHECK_GE(avformat_alloc_output_context2(&fmt_ctx, NULL, NULL, fn_.c_str()), 0)
+        << "Could not deduce output container from file name: " << fn_;
+    fmt_ctx_.reset(fmt_ctx);
+
+    const AVCodec *codec = opts_.codec.empty() ? avcodec_find_encoder(fmt_ctx->oformat->video_codec)
+        : avcodec_find_encoder_by_name(opts_.codec.c_str());
+    CHECK(codec) << "Encoder not found: " << (opts_.codec.empty() ? "default of container" : opts_.codec);
+    AVPixelFormat pix_fmt = opts_.pix_fmt;
+    if (pix_fmt == AV_PIX_FMT_NONE) {
+        // prefer yuv420p, the most widely decodable format
+        pix_fmt = codec->pix_fmts ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+        for (const AVPixelFormat *p = codec->pix_fmts; p && *p != AV_PIX_FMT_NONE; ++p) {
+            if (*p == AV_PIX_FMT_YUV420P) pix_fmt = *p;
+        }
+    }
+
+    enc_ctx_.reset(avcodec_alloc_context3(codec));
+    AVCodecContext *enc = enc_ctx_.get();
+    CHECK(enc) << "Error allocating encoder context";
+    enc->width = width_;
+    enc->height = height_;
+    enc->pix_fmt = pix_fmt;
+    enc->framerate = av_d2q(fps_, 100000);
+    enc->time_base = av_inv_q(enc->framerate);
+    enc->sample_aspect_ratio = {1, 1};
+    if (opts_.bit_rate > 0) enc->bit_rate = opts_.bit_rate;
+    enc->thread_type = opts_.thread_type;
+    enc->thread_count = opts_.thread_count;
+    if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    AVDictionary *dict = NULL;
+    if (!opts_.options.empty()) {
+        CHECK_GE(av_dict_parse_string(&dict, opts_.options.c_str(), "=", ",", 0), 0)
+            << "Invalid encoder options: " << opts_.options;
+    }
+    int ret = avcodec_open2(enc, codec, &dict);
+    AVDictionaryEntry *unused = NULL;
+    while ((unused = av_dict_get(dict, "", unused, AV_DICT_IGNORE_SUFFIX))) {
+        LOG(WARNING) << "Encoder option not used: " << unused->key << "=" << unused->value;
+    }
+    av_dict_free(&dict);
+    CHECK_GE(ret, 0) << "Error opening encoder " << codec->name << " for " << fn_ << ": " << ret;
+
+    stream_ = avformat_new_stream(fmt_ctx, NULL);
+    CHECK(stream_) << "Error creating output stream";
+    stream_->time_base = enc->time_base;
+    stream_->avg_frame_rate = enc->framerate;
+    CHECK_GE(avcodec_parameters_from_context(stream_->codecpar, enc), 0)
+        << "Error copying encoder parameters";
+    if (!(fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+        CHECK_GE(avio_open(&fmt_ctx->pb, fn_.c_str(), AVIO_FLAG_WRITE), 0) << "Error opening " << fn_;
+    }
+    CHECK_GE(avformat_write_header(fmt_ctx, NULL), 0) << "Error writing header of " << fn_;
+
+    frame_queue_.reset(new FrameQueue());
+    encode_queue_.reset(new EncodeQueue());
+    pkt_queue_.reset(new PacketQueue());
+    slot_queue_.reset(new SlotQueue());
+    for (int i = 0; i < opts_.queue_size; ++i) slot_queue_->Push(i);
+    opened_ = true;
+    convert_thread_ = std::thread(&VideoWriter::ConvertThread, this);
+    encode_thread_ = std::thread(&VideoWriter::EncodeThread, this);
+    mux_thread_ = std::thread(&VideoWriter::MuxThread, this);
+}
+
+void VideoWriter::Write(NDArray frames) {
+    CHECK(!closed_) << "Writing to closed video: " << fn_;
+    CheckError();
+    CHECK(frames.defined()) << "Empty frames";
+    const int ndim = frames->ndim;
+    CHECK(ndim == 3 || ndim == 4) << "Expect frame [H, W, 3] or batch [N, H, W, 3], given ndim: " << ndim;
+    CHECK_EQ(frames->shape[ndim - 1], 3) << "Expect RGB24 frames with 3 channels";
+    CHECK(frames->dtype.code == kDLUInt && frames->dtype.bits == 8) << "Expect uint8 frames";
+    const int64_t n = ndim == 4 ? frames->shape[0] : 1;
+    const int64_t height = frames->shape[ndim - 3];
+    const int64_t width = frames->shape[ndim - 2];
+    if (!opened_) {
+        Open(width_ > 0 ? width_ : static_cast<int>(width), height_ > 0 ? height_ : static_cast<int>(height));
+    }
+    // own a contiguous CPU copy, caller is free to reuse its buffer once Write returns
+    std::vector<int64_t> shape(frames->shape, frames->shape + ndim);
+    NDArray copy = NDArray::Empty(shape, frames->dtype, kCPU);
+    copy.CopyFrom(frames);
+    uint64_t offset = 0;
+    for (int64_t i = 0; i < n; ++i) {
+        int slot;
+        if (!slot_queue_->Pop(&slot)) {
+            CheckError();
+            LOG(FATAL) << "VideoWriter stopped: " << fn_;
+        }
+        NDArray view = copy.CreateOffsetView({height, width, 3}, frames->dtype, &offset);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++submitted_;
+        }
+        frame_queue_->Push(view);
+    }
+}
+
+void VideoWriter::ConvertThread() {
+    try {
+        while (true) {
+            NDArray frame;
+            if (!frame_queue_->Pop(&frame)) return;
+            if (!frame.defined()) break;
+            int height = static_cast<int>(frame->shape[0]);
+            int width = static_cast<int>(frame->shape[1]);
+            if (!filter_graph_ || width != in_width_ || height != in_height_) {
+                ffmpeg::AVCodecContextPtr par(avcodec_alloc_context3(NULL));
+                par->width = width;
+                par->height = height;
+                par->pix_fmt = AV_PIX_FMT_RGB24;
+                par->time_base = {1, AV_TIME_BASE};
+                par->sample_aspect_ratio = {1, 1};
+                char descr[128];
+                std::snprintf(descr, sizeof(descr), "scale=%d:%d", width_, height_);
+                filter_graph_.reset(new ffmpeg::FFMPEGFilterGraph(descr, par.get(), enc_ctx_->pix_fmt));
+                in_width_ = width;
+                in_height_ = height;
+            }
+            // wrap NDArray memory, filter graph keeps its own reference of the data
+            AVFramePtr in = AVFramePool::Get()->Acquire();
+            in->format = AV_PIX_FMT_RGB24;
+            in->width = width;
+            in->height = height;
+            in->data[0] = static_cast<uint8_t*>(frame->data) + frame->byte_offset;
+            in->linesize[0] = width * 3;
+            in->pts = next_pts_;
+            filter_graph_->Push(in.get());
+            AVFramePtr out = AVFramePool::Get()->Acquire();
+            AVFrame *out_p = out.get();
+            CHECK(filter_graph_->Pop(&out_p)) << "Error fetch filtered frame.";
+            out->pts = next_pts_++;
+            encode_queue_->Push(out);
+        }
+        // end of stream
+        encode_queue_->Push(AVFramePtr());
+    } catch (const std::exception& e) {
+        Fail(e.what());
+    }
+}
+
+void VideoWriter::Encode(AVFrame *frame) {
+    AVCodecContext *enc = enc_ctx_.get();
+    CHECK_GE(avcodec_send_frame(enc, frame), 0) << "Error sending frame to encoder";
+    while (true) {
+        AVPacketPtr pkt = AVPacketPool::Get()->Acquire();
+        int ret = avcodec_receive_packet(enc, pkt.get());
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+        CHECK_GE(ret, 0) << "Error encoding frame: " << ret;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++pkt_pushed_;
+        }
+        pkt_queue_->Push(pkt);
+    }
+    if (frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++encoded_;
+    }
+    cv_.notify_all();
+}
+
+void VideoWriter::EncodeThread() {
+    try {
+        while (true) {
+            AVFramePtr frame;
+            if (!encode_queue_->Pop(&frame)) return;
+            if (!frame) {
+                // drain delayed packets
+                Encode(nullptr);
+                break;
+            }
+            Encode(frame.get());
+            // frame is owned by encoder now, release its slot
+            slot_queue_->Push(0);
+        }
+        pkt_queue_->Push(AVPacketPtr());
+    } catch (const std::exception& e) {
+        Fail(e.what());
+    }
+}
+
+void VideoWriter::MuxThread() {
+    try {
+        while (true) {
+            AVPacketPtr pkt;
+            if (!pkt_queue_->Pop(&pkt) || !pkt) return;
+            av_packet_rescale_ts(pkt.get(), enc_ctx_->time_base, stream_->time_base);
+            pkt->stream_index = stream_->index;
+            CHECK_GE(av_interleaved_write_frame(fmt_ctx_.get(), pkt.get()), 0) << "Error writing packet to " << fn_;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++pkt_muxed_;
+            }
+            cv_.notify_all();
+        }
+    } catch (const std::exception& e) {
+        Fail(e.what());
+    }
+}
+
+void VideoWriter::Fail(const std::string& msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ += msg;
+        failed_.store(true);
+    }
+    cv_.notify_all();
+    frame_queue_->SignalForKill();
+    encode_queue_->SignalForKill();
+    pkt_queue_->SignalForKill();
+    slot_queue_->SignalForKill();
+}
+
+void VideoWriter::CheckError() {
+    if (!failed_.load()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    LOG(FATAL) << "VideoWriter failed on " << fn_ << ": " << error_;
+}
+
+void VideoWriter::Flush() {
+    CheckError();
+    if (!opened_ || closed_) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] {
+            return failed_.load() || (encoded_ == submitted_ && pkt_muxed_ == pkt_pushed_);
+        });
+    }
+    CheckError();
+    if (fmt_ctx_->pb) avio_flush(fmt_ctx_->pb);
+}
+
+void VideoWriter::Close() {
+    if (closed_) return;
+    closed_ = true;
+    if (!opened_) {
+        LOG(WARNING) << "No frame written, " << fn_ << " is not created.";
+        return;
+    }
+    frame_queue_->Push(NDArray());
+    convert_thread_.join();
+    encode_thread_.join();
+    mux_thread_.join();
+    filter_graph_.reset();
+    if (!failed_.load()) {
+        CHECK_GE(av_write_trailer(fmt_ctx_.get()), 0) << "Error writing trailer of " << fn_;
+    }
+    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) avio_closep(&fmt_ctx_->pb);
+    enc_ctx_.reset();
+    CheckError();
+}
+
+}  // namespace decord
@@ -0,0 +1,127 @@
+/*!
+ *  Copyright (c) 2019 by Contributors if not otherwise specified
+ * \file video_writer.h
+ * \brief FFmpeg threaded video writer, implements VideoWriterInterface
+ */
+
+#ifndef DECORD_VIDEO_VIDEO_WRITER_H_
+#define DECORD_VIDEO_VIDEO_WRITER_H_
+
+#include "ffmpeg/filter_graph.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <decord/video_interface.h>
+#include <dmlc/concurrency.h>
+
+namespace decord {
+
+/*! \brief encoder settings of VideoWriter */
+struct EncoderOptions {
+    /*! \brief encoder name, e.g. libx264, mpeg4; default encoder of container if empty */
+    std::string codec;
+    /*! \brief encoder pixel format, first format supported by encoder if AV_PIX_FMT_NONE */
+    AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
+    /*! \brief target bit rate, encoder default if 0 */
+    int64_t bit_rate = 0;
+    /*! \brief FF_THREAD_FRAME or FF_THREAD_SLICE */
+    int thread_type = FF_THREAD_FRAME;
+    /*! \brief encoder threads, 0 for auto */
+    int thread_count = 0;
+    /*! \brief private encoder options, e.g. "crf=23,preset=fast" */
+    std::string options;
+    /*! \brief max number of frames queued before Write blocks */
+    int queue_size = 16;
+};  // struct EncoderOptions
+
+/**
+ * \brief Video writer with a three stage pipeline.
+ *
+ * Write copies frames and returns once a queue slot is available. A conversion thread scales
+ * RGB24 to the encoder pixel format with a filter graph, an encoding thread feeds the
+ * (frame or slice threaded) encoder, and a muxing thread writes packets to the container.
+ */
+class VideoWriter : public VideoWriterInterface {
+    using AVFramePtr = ffmpeg::AVFramePtr;
+    using AVPacketPtr = ffmpeg::AVPacketPtr;
+    using FrameQueue = dmlc::ConcurrentBlockingQueue<NDArray>;
+    using EncodeQueue = dmlc::ConcurrentBlockingQueue<AVFramePtr>;
+    using PacketQueue = dmlc::ConcurrentBlockingQueue<AVPacketPtr>;
+    using SlotQueue = dmlc::ConcurrentBlockingQueue<int>;
+    /*! \brief output context, io is closed separately */
+    using AVOutputContextPtr = std::unique_ptr<
+        AVFormatContext, ffmpeg::Deleter<AVFormatContext, void, avformat_free_context> >;
+
+    public:
+        /**
+         * \brief Create writer, encoder is opened with the first frame if width or height is -1.
+         * \param fn Output file, container is guessed from extension
+         * \param fps Frame rate
+         * \param width Output width, follows first frame if -1
+         * \param height Output height, follows first frame if -1
+         * \param opts Encoder settings
+         */
+        VideoWriter(std::string fn, double fps, int width = -1, int height = -1,
+                    EncoderOptions opts = EncoderOptions());
+        ~VideoWriter();
+        void Write(NDArray frames);
+        void Flush();
+        void Close();
+        int64_t GetFrameCount() const { return submitted_; }
+
+    private:
+        void Open(int width, int height);
+        void ConvertThread();
+        void EncodeThread();
+        void MuxThread();
+        /*! \brief send frame to encoder, nullptr to drain, and forward produced packets */
+        void Encode(AVFrame *frame);
+        /*! \brief record error of a worker and wake up everyone waiting on the pipeline */
+        void Fail(const std::string& msg);
+        void CheckError();
+
+        std::string fn_;
+        double fps_;
+        int width_;
+        int height_;
+        EncoderOptions opts_;
+        AVOutputContextPtr fmt_ctx_;
+        ffmpeg::AVCodecContextPtr enc_ctx_;
+        AVStream *stream_;
+        /*! \brief size of input frames, filter graph is rebuilt if it changes */
+        int in_width_;
+        int in_height_;
+        std::unique_ptr<ffmpeg::FFMPEGFilterGraph> filter_graph_;
+        bool opened_;
+        bool closed_;
+        int64_t next_pts_;
+
+        std::unique_ptr<FrameQueue> frame_queue_;
+        std::unique_ptr<EncodeQueue> encode_queue_;
+        std::unique_ptr<PacketQueue> pkt_queue_;
+        /*! \brief free slots, bounds frames in flight between Write and encoder */
+        std::unique_ptr<SlotQueue> slot_queue_;
+        std::thread convert_thread_;
+        std::thread encode_thread_;
+        std::thread mux_thread_;
+
+        /*! \brief pipeline progress, guarded by mutex_ */
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        int64_t submitted_;
+        int64_t encoded_;
+        int64_t pkt_pushed_;
+        int64_t pkt_muxed_;
+        std::atomic<bool> failed_;
+        std::string error_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoWriter);
+};  // class VideoWriter
+
+}  // namespace decord
+
+#endif  // DECORD_VIDEO_VIDEO_WRITER_H_
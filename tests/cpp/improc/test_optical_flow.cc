@@ -0,0 +1,51 @@
+// Dense flow must recover the direction and magnitude of a known translation.
+#include "../../../src/improc/optical_flow.h"
+#include <dmlc/logging.h>
+#include <cmath>
+#include <vector>
+
+using namespace decord::improc;
+
+// smooth texture, values in [0, 255]
+float Texture(float x, float y) {
+    return 127.5f + 60.f * std::sin(0.21f * x + 0.05f * y) + 60.f * std::cos(0.17f * y - 0.08f * x);
+}
+
+int main(int argc, const char **argv) {
+    // odd width, so the scalar tail of the SSE2 loops runs too
+    const int width = 131, height = 96;
+    for (auto shift : {std::make_pair(2.f, -1.f), std::make_pair(-1.5f, 2.5f), std::make_pair(0.f, 0.f)}) {
+        std::vector<float> prev(width * height), next(width * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                prev[y * width + x] = Texture(x, y);
+                // content moves by shift, next(x + shift) = prev(x)
+                next[y * width + x] = Texture(x - shift.first, y - shift.second);
+            }
+        }
+        std::vector<float> flow(width * height * 2);
+        DenseFlow(prev.data(), next.data(), width, height, flow.data());
+        // borders see content entering the frame, smeared further by coarse levels, only the interior is checked
+        const int margin = 16;
+        double sum_u = 0, sum_v = 0;
+        int count = 0, close = 0;
+        for (int y = margin; y < height - margin; ++y) {
+            for (int x = margin; x < width - margin; ++x) {
+                float u = flow[2 * (y * width + x)], v = flow[2 * (y * width + x) + 1];
+                sum_u += u;
+                sum_v += v;
+                if (std::hypot(u - shift.first, v - shift.second) < 0.5f) ++close;
+                ++count;
+            }
+        }
+        const double mean_u = sum_u / count, mean_v = sum_v / count;
+        LOG(INFO) << "shift (" << shift.first << ", " << shift.second << "): mean flow (" << mean_u << ", "
+                  << mean_v << "), " << close << " of " << count << " pixels within 0.5";
+        CHECK_LT(std::abs(mean_u - shift.first), 0.1) << "horizontal flow " << mean_u << " for shift " << shift.first;
+        CHECK_LT(std::abs(mean_v - shift.second), 0.1) << "vertical flow " << mean_v << " for shift " << shift.second;
+        // a few pixels with nearly parallel gradients in the window may stray
+        CHECK_GT(close, count * 0.95) << "only " << close << " of " << count << " pixels within 0.5";
+    }
+    LOG(INFO) << "Dense flow recovers translations";
+    return 0;
+}
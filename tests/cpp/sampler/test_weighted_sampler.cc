@@ -0,0 +1,79 @@
+// Weighted draws must follow the video weights, reproducibly for a fixed seed.
+#include "../../../src/sampler/weighted_sampler.h"
+#include <dmlc/logging.h>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace decord::sampler;
+
+// batches per video of each epoch, drawn with given options
+std::vector<std::vector<size_t> > Draw(const std::vector<int64_t>& lens, WeightedSamplerOptions opts, int epochs) {
+    std::vector<int64_t> range;
+    for (auto len : lens) {
+        range.emplace_back(0);
+        range.emplace_back(len - 1);
+    }
+    WeightedSampler sampler(lens, range, 1, 0, 0, opts);
+    std::vector<std::vector<size_t> > ret;
+    for (int e = 0; e < epochs; ++e) {
+        sampler.Reset();
+        std::vector<size_t> videos;
+        while (sampler.HasNext()) videos.emplace_back(sampler.Next()[0].first);
+        ret.emplace_back(videos);
+    }
+    return ret;
+}
+
+int main(int argc, const char **argv) {
+    // with replacement, video shares follow weights whatever the video lengths
+    {
+        WeightedSamplerOptions opts;
+        opts.weights = {1, 3, 0, 4};
+        opts.seed = 42;
+        const std::vector<int64_t> lens = {1000, 200, 500, 3000};
+        auto epochs = Draw(lens, opts, 20);
+        std::vector<double> counts(lens.size(), 0);
+        double total = 0;
+        for (const auto& epoch : epochs) {
+            // len - 2 batches of each video, range end excluded
+            CHECK_EQ(epoch.size(), 4692u);
+            for (auto v : epoch) counts[v] += 1;
+            total += epoch.size();
+        }
+        for (size_t v = 0; v < lens.size(); ++v) {
+            double expected = opts.weights[v] / 8.;
+            // about 94k draws, binomial standard deviation below 0.0017
+            CHECK_LT(std::abs(counts[v] / total - expected), 0.01)
+                << "video " << v << " drawn " << counts[v] / total << ", expected " << expected;
+        }
+        CHECK_EQ(counts[2], 0) << "weight 0 video drawn";
+        CHECK(Draw(lens, opts, 2) == std::vector<std::vector<size_t> >(epochs.begin(), epochs.begin() + 2))
+            << "same seed must give the same epochs";
+    }
+
+    // without replacement, every positive weight batch once per epoch, also under geometric weights
+    // where each draw holds half of the remaining mass
+    {
+        WeightedSamplerOptions opts;
+        opts.replacement = false;
+        opts.seed = 7;
+        const size_t num_videos = 1000;
+        std::vector<int64_t> lens(num_videos, 3);
+        for (size_t v = 0; v < num_videos; ++v) opts.weights.emplace_back(std::ldexp(1., -static_cast<int>(v)));
+        lens.emplace_back(1000002);
+        opts.weights.emplace_back(std::ldexp(1., -1000));
+        auto start = std::chrono::steady_clock::now();
+        auto epochs = Draw(lens, opts, 1);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::vector<size_t> counts(num_videos + 1, 0);
+        for (auto v : epochs[0]) ++counts[v];
+        for (size_t v = 0; v < num_videos; ++v) CHECK_EQ(counts[v], 1u) << "video " << v;
+        CHECK_EQ(counts[num_videos], 1000000u);
+        // rebuilding an alias table per drawn geometric video costs over 10 s here
+        CHECK_LT(secs, 5) << "without replacement draw took " << secs << " s";
+        LOG(INFO) << epochs[0].size() << " batches without replacement in " << secs << " s";
+    }
+    LOG(INFO) << "Weighted sampler draws follow weights";
+    return 0;
+}
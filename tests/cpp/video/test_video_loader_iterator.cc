@@ -0,0 +1,21 @@
+#include <decord/loader_iterator.h>
+#include <dmlc/logging.h>
+
+int main(int argc, const char **argv) {
+    decord::LoaderRange loader("/tmp/testsrc_h264_10s_default.mp4", 4, 224, 224, 1, 10, 0);
+    int64_t cnt = 0;
+    for (auto& batch : loader) {
+        CHECK_EQ(batch.data().ndim, 4);
+        CHECK_EQ(batch.data().shape[0], 4);
+        CHECK_EQ(batch.indices().shape[0], 4);
+        cnt++;
+    }
+    CHECK_EQ(cnt, loader.size());
+    // batches own their tensors after release
+    auto it = loader.begin();
+    DLManagedTensor *data = it->ReleaseData();
+    LOG(INFO) << "Batches per epoch: " << cnt << ", first frame byte: "
+              << static_cast<int>(static_cast<uint8_t*>(data->dl_tensor.data)[data->dl_tensor.byte_offset]);
+    data->deleter(data);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Opens and closes many readers, RSS, open fds and threads must stay flat.
+// usage: test_video_reader_lifecycle [num_readers=100000]
+#include <decord/video_interface.h>
+#include <decord/base.h>
+#include <dmlc/logging.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using NDArray = decord::runtime::NDArray;
+using namespace decord;
+
+// 64x64 clips from tests/utils/generate_test_videos.sh
+static const char* kClips[] = {
+    "/tmp/testsrc_h264_64x64_1s.mp4",
+    "/tmp/testsrc_mpeg4_64x64_1s.mp4",
+};
+
+// field of /proc/self/status, e.g. VmRSS in kB or Threads
+int64_t ProcStatus(const std::string& key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") != 0) continue;
+        std::istringstream ss(line.substr(key.size() + 1));
+        int64_t value = 0;
+        ss >> value;
+        return value;
+    }
+    return -1;
+}
+
+int64_t OpenFds() {
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) return -1;
+    int64_t cnt = 0;
+    while (readdir(dir)) ++cnt;
+    closedir(dir);
+    // ., .. and the fd of dir itself
+    return cnt - 3;
+}
+
+void OpenAndClose(int64_t i) {
+    auto vr = GetVideoReader(kClips[i % 2], kCPU);
+    // every other reader decodes, the others only probe
+    if (i % 4 < 2) {
+        NDArray frame = vr->NextFrame();
+        CHECK_GT(frame.Size(), 0);
+    } else {
+        CHECK_GT(vr->GetFrameCount(), 0);
+    }
+}
+
+int main(int argc, const char **argv) {
+    const int64_t num = argc > 1 ? std::atoll(argv[1]) : 100000;
+    const int64_t warmup = std::min<int64_t>(1000, num / 10);
+    if (ProcStatus("VmRSS") < 0) {
+        LOG(INFO) << "/proc/self/status not available, skipped";
+        return 0;
+    }
+
+    // footprint of open idle readers
+    {
+        const int64_t threads = ProcStatus("Threads");
+        const int64_t rss = ProcStatus("VmRSS");
+        const int64_t fds = OpenFds();
+        std::vector<VideoReaderPtr> readers;
+        for (int i = 0; i < 200; ++i) readers.emplace_back(GetVideoReader(kClips[0], kCPU));
+        LOG(INFO) << "Idle reader footprint: " << (ProcStatus("VmRSS") - rss) / 200 << " kB, "
+                  << (OpenFds() - fds) / 200.0 << " fds";
+        CHECK_EQ(ProcStatus("Threads"), threads) << "idle readers must not start decoder threads";
+        for (auto& vr : readers) vr->NextFrame();
+        LOG(INFO) << "Decoding reader footprint: " << (ProcStatus("VmRSS") - rss) / 200 << " kB, "
+                  << (ProcStatus("Threads") - threads) / 200.0 << " threads";
+        readers.clear();
+        CHECK_EQ(ProcStatus("Threads"), threads) << "threads left behind by closed readers";
+    }
+
+    for (int64_t i = 0; i < warmup; ++i) OpenAndClose(i);
+    const int64_t rss = ProcStatus("VmRSS");
+    const int64_t fds = OpenFds();
+    const int64_t threads = ProcStatus("Threads");
+    for (int64_t i = warmup; i < num; ++i) {
+        OpenAndClose(i);
+        if ((i + 1) % 10000 == 0) {
+            LOG(INFO) << i + 1 << " readers, RSS " << ProcStatus("VmRSS") << " kB (+"
+                      << ProcStatus("VmRSS") - rss << "), fds " << OpenFds() << ", threads " << ProcStatus("Threads");
+        }
+    }
+    CHECK_EQ(OpenFds(), fds) << "file descriptors leaked";
+    CHECK_EQ(ProcStatus("Threads"), threads) << "threads leaked";
+    // allocator fragmentation only, a leak of 1 kB per reader already exceeds this at 100k readers
+    CHECK_LT(ProcStatus("VmRSS") - rss, 32 * 1024) << "RSS grew over " << num << " readers";
+    LOG(INFO) << num << " readers opened and closed, RSS +" << ProcStatus("VmRSS") - rss << " kB";
+    return 0;
+}
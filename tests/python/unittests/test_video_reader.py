@@ -1,9 +1,29 @@
 import os
 import random
-from decord import VideoReader
+import shutil
+import struct
+import subprocess
+import tempfile
+import time
+import unittest
+import numpy as np
+from decord import VideoReader, MultiStreamVideoReader, ImageSequenceReader, ConcatVideoReader
+from decord import VideoClipDataset, VideoWriter, PacketReader, ThreadSafeVideoReader, get_batch_multi
+from decord import MultiCursorVideoReader, VideoLoader, cpu
+from decord import set_memory_budget, memory_usage
+
+def _get_default_test_video_path():
+    return os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..', 'examples', 'flipping_a_pancake.mkv'))
 
 def _get_default_test_video():
-    return VideoReader(os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..', 'examples', 'flipping_a_pancake.mkv')))
+    return VideoReader(_get_default_test_video_path())
+
+def _wait_until(cond, timeout=10):
+    """Poll cond until true or timeout in seconds, returns the last result."""
+    deadline = time.time() + timeout
+    while not cond() and time.time() < deadline:
+        time.sleep(0.01)
+    return cond()
 
 def test_video_reader_len():
     vr = _get_default_test_video()
@@ -40,6 +60,552 @@ def test_video_get_batch():
     rand_lst = lst[:num]
     frames = vr.get_batch(rand_lst)
 
+def test_multi_stream_video_reader_single_stream():
+    vr = MultiStreamVideoReader(_get_default_test_video_path())
+    assert len(vr) == 311
+    assert len(vr.streams) == 1
+    frames = vr.get_batch([0, 10, 5, 10])
+    assert frames.shape[0] == 1 and frames.shape[1] == 4
+    ref = _get_default_test_video().get_batch([0, 10, 5, 10])
+    assert frames.shape[1:] == ref.shape
+
+def test_multi_stream_video_reader():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        # stream 0 at 10 fps, stream 1 with other content at 5 fps
+        path = os.path.join(tmpdir, 'angles.mp4')
+        subprocess.check_call(_ffmpeg_cmd() + [
+            '-f', 'lavfi', '-i', 'testsrc=duration=2:size=64x48:rate=10',
+            '-f', 'lavfi', '-i', 'testsrc=duration=2:size=64x48:rate=5,negate',
+            '-map', '0:v', '-map', '1:v', '-pix_fmt', 'yuv420p', path])
+        vr = MultiStreamVideoReader(path)
+        assert vr.streams == [0, 1]
+        assert len(vr) == 20
+        # even indices of the reference stream fall exactly on frames of stream 1
+        indices = [0, 8, 4, 8, 18]
+        frames = vr.get_batch(indices).asnumpy()
+        assert frames.shape == (2, 5, 48, 64, 3)
+        ref = VideoReader(path, stream=0).get_batch(indices).asnumpy()
+        assert (frames[0] == ref).all()
+        ref = VideoReader(path, stream=1).get_batch([i // 2 for i in indices]).asnumpy()
+        assert (frames[1] == ref).all()
+        assert (frames[0] != frames[1]).any()
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_reader_output_format():
+    fn = _get_default_test_video_path()
+    ref = _get_default_test_video()[0]
+    frame = VideoReader(fn, output_format='rgb48')[0]
+    assert frame.shape == ref.shape and frame.dtype == 'uint16'
+    frame = VideoReader(fn, output_format='gray')[0]
+    assert frame.shape == (ref.shape[0], ref.shape[1], 1)
+    # SDR source is untouched by tone mapping
+    frame = VideoReader(fn, tone_mapping=True)[0]
+    assert (frame.asnumpy() == ref.asnumpy()).all()
+
+def test_video_reader_crop_detect():
+    fn = _get_default_test_video_path()
+    ref = _get_default_test_video()[0]
+    vr = VideoReader(fn, crop_detect=True)
+    assert len(vr) == 311
+    frame = vr[0]
+    assert frame.shape[0] <= ref.shape[0] and frame.shape[1] <= ref.shape[1]
+    # explicit size is kept
+    frame = VideoReader(fn, width=320, height=240, crop_detect=True)[0]
+    assert frame.shape == (240, 320, 3)
+
+def test_video_reader_crop_detect_letterbox():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        # lossless, so the active area decodes to the source pixels
+        src = os.path.join(tmpdir, 'src.mkv')
+        boxed = os.path.join(tmpdir, 'boxed.mkv')
+        enc = ['-f', 'lavfi', '-i', 'testsrc=duration=1:size=96x48:rate=5', '-pix_fmt', 'yuv420p', '-c:v', 'ffv1']
+        subprocess.check_call(_ffmpeg_cmd() + enc + [src])
+        subprocess.check_call(_ffmpeg_cmd() + enc + ['-vf', 'pad=128:80:16:16:black', boxed])
+        assert VideoReader(boxed)[0].shape == (80, 128, 3)
+        vr = VideoReader(boxed, crop_detect=True)
+        ref = VideoReader(src)
+        assert len(vr) == len(ref)
+        frames = vr.get_batch([0, 3]).asnumpy()
+        assert frames.shape == (2, 48, 96, 3)
+        err = np.abs(frames.astype('int32') - ref.get_batch([0, 3]).asnumpy().astype('int32')).mean()
+        assert err < 1, err
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_reader_deinterlace_progressive():
+    fn = _get_default_test_video_path()
+    ref = _get_default_test_video()[0].asnumpy()
+    # progressive frames are never touched
+    for mode in ['field', 'blend']:
+        frame = VideoReader(fn, deinterlace=mode)[0].asnumpy()
+        assert (frame == ref).all()
+
+def test_video_reader_deinterlace():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        # two moving frames woven into one, coded as interlaced
+        path = os.path.join(tmpdir, 'interlaced.mp4')
+        subprocess.check_call(_ffmpeg_cmd() + [
+            '-f', 'lavfi', '-i', 'testsrc=duration=2:size=96x64:rate=10', '-vf', 'tinterlace=4',
+            '-flags', '+ilme+ildct', '-c:v', 'mpeg4', '-q:v', '2', '-pix_fmt', 'yuv420p', path])
+        vr = VideoReader(path)
+        ref = vr.get_batch([2, 5]).asnumpy().astype('int32')
+        assert ref.shape == (2, 64, 96, 3)
+        for mode in ['field', 'blend']:
+            frames = VideoReader(path, deinterlace=mode).get_batch([2, 5]).asnumpy().astype('int32')
+            assert frames.shape == ref.shape
+            assert np.abs(frames - ref).mean() > 1, mode
+    finally:
+        shutil.rmtree(tmpdir)
+
+def _write_bmp(fn, img):
+    h, w, _ = img.shape
+    row = (w * 3 + 3) // 4 * 4
+    data = np.zeros((h, row), dtype=np.uint8)
+    # bottom-up BGR rows
+    data[:, :w * 3] = img[::-1, :, ::-1].reshape(h, w * 3)
+    with open(fn, 'wb') as f:
+        f.write(struct.pack('<2sIHHI', b'BM', 54 + data.size, 0, 0, 54))
+        f.write(struct.pack('<IiiHHIIiiII', 40, w, h, 1, 24, 0, data.size, 0, 0, 0, 0))
+        f.write(data.tobytes())
+
+def test_image_sequence_reader():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        imgs = [np.full((24, 32, 3), i * 20, dtype=np.uint8) for i in range(12)]
+        for i, img in enumerate(imgs):
+            _write_bmp(os.path.join(tmpdir, 'img_{}.bmp'.format(i)), img)
+        vr = ImageSequenceReader(tmpdir)
+        assert len(vr) == 12
+        # natural order, img_10 after img_9
+        frames = vr.get_batch([10, 2, 10]).asnumpy()
+        assert frames.shape == (3, 24, 32, 3)
+        assert (frames[0] == imgs[10]).all() and (frames[1] == imgs[2]).all() and (frames[2] == imgs[10]).all()
+        vr = ImageSequenceReader(os.path.join(tmpdir, 'img_1*.bmp'), width=16, height=12)
+        assert len(vr) == 3
+        assert vr[0].shape == (12, 16, 3)
+        # scaling graphs are reused across images of the same size
+        frames = vr.get_batch([0, 1, 2, 0]).asnumpy()
+        assert (frames[0] == frames[3]).all() and (frames[1] == 20 * 10).all()
+        # existing files with glob characters in name are videos, not patterns
+        video = os.path.join(tmpdir, 'clip[1].mkv')
+        shutil.copy(_get_default_test_video_path(), video)
+        vl = VideoLoader([video], ctx=cpu(0), shape=(2, 32, 32, 3), interval=0, skip=100, shuffle=0)
+        assert len(vl) > 0
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_concat_video_reader():
+    fn = _get_default_test_video_path()
+    vr = ConcatVideoReader([fn, fn])
+    assert len(vr) == 622
+    frames = vr.get_batch([5, 311 + 5, 6]).asnumpy()
+    assert (frames[0] == frames[1]).all()
+    assert vr.get_frame_timestamp(311) > vr.get_frame_timestamp(310)
+    vr.seek_accurate(309)
+    for _ in range(4):
+        vr.next()
+    assert vr.get_frame_timestamp(-1) > vr.get_frame_timestamp(0)
+    # frames on both sides of every boundary match the segment readers
+    single = VideoReader(fn)
+    n = len(single)
+    vr = ConcatVideoReader([fn, fn, fn])
+    assert len(vr) == 3 * n
+    local = [n - 2, n - 1, 0, 1]
+    expected = single.get_batch(local).asnumpy()
+    for boundary in (n, 2 * n):
+        frames = vr.get_batch([boundary + i - 2 for i in range(4)]).asnumpy()
+        assert (frames == expected).all()
+    assert (vr[3 * n - 1].asnumpy() == single[n - 1].asnumpy()).all()
+    # segment paths are passed verbatim
+    tmpdir = tempfile.mkdtemp()
+    try:
+        seg = os.path.join(tmpdir, ' clip, 1.mp4')
+        shutil.copy(fn, seg)
+        vr = ConcatVideoReader([fn, seg])
+        assert len(vr) == 2 * n
+        assert (vr[2 * n - 1].asnumpy() == single[n - 1].asnumpy()).all()
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_clip_dataset():
+    fn = _get_default_test_video_path()
+    tmpdir = tempfile.mkdtemp()
+    try:
+        annotation = os.path.join(tmpdir, 'clips.csv')
+        with open(annotation, 'w') as f:
+            f.write('path,label,start,end\n')
+            f.write('{},flip,1.0,3.0\n'.format(fn))
+            f.write('{},"eat, pancake",4.0,\n'.format(fn))
+            f.write('{},flip,0,1.0\n'.format(fn))
+        ds = VideoClipDataset(annotation, batch_size=2, num_frames=4, width=320, height=240)
+        assert len(ds) == 3
+        assert ds.num_batches == 1
+        assert ds.classes == ['eat, pancake', 'flip']
+        frames, label = ds[1]
+        assert frames.shape == (4, 240, 320, 3)
+        assert label == 0
+        data, labels, indices = ds.next()
+        assert data.shape == (2, 4, 240, 320, 3)
+        assert labels.asnumpy().tolist() == [1, 0]
+        assert (data.asnumpy()[1] == frames.asnumpy()).all()
+        indices = indices.asnumpy()
+        assert indices.shape == (8, 2)
+        assert indices[4:, 1].min() >= 4 * VideoReader(fn).get_avg_fps() - 1
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_clip_dataset_image_sequence():
+    fn = _get_default_test_video_path()
+    tmpdir = tempfile.mkdtemp()
+    try:
+        imgs = [np.full((24, 32, 3), i * 20, dtype=np.uint8) for i in range(12)]
+        for i, img in enumerate(imgs):
+            _write_bmp(os.path.join(tmpdir, 'img_{}.bmp'.format(i)), img)
+        annotation = os.path.join(tmpdir, 'clips.csv')
+        with open(annotation, 'w') as f:
+            f.write('path,label,start,end\n')
+            f.write('{},video,1.0,3.0\n'.format(fn))
+            f.write('{},images,0,\n'.format(os.path.join(tmpdir, 'img_*.bmp')))
+            f.write('{},video,4.0,\n'.format(fn))
+        # video and image sequence readers decoded in the same parallel batch
+        ds = VideoClipDataset(annotation, batch_size=3, num_frames=4, width=32, height=24)
+        data, labels, indices = ds.next()
+        assert data.shape == (3, 4, 24, 32, 3)
+        frames = data.asnumpy()[1]
+        for i, idx in enumerate(indices.asnumpy()[4:8, 1]):
+            assert (frames[i] == imgs[idx]).all()
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_writer():
+    vr = _get_default_test_video()
+    frames = vr.get_batch(range(10))
+    tmpdir = tempfile.mkdtemp()
+    fn = os.path.join(tmpdir, 'out.mp4')
+    try:
+        with VideoWriter(fn, fps=vr.get_avg_fps(), codec='mpeg4', thread_type='slice', queue_size=4) as vw:
+            vw.write(frames)
+            vw.write(frames.asnumpy()[0])
+            vw.flush()
+            assert len(vw) == 11
+        vr2 = VideoReader(fn)
+        assert len(vr2) == 11
+        assert vr2[0].shape == frames[0].shape
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_reader_batch_diff():
+    vr = _get_default_test_video()
+    frames = vr.get_batch([8, 9, 10, 0]).asnumpy().astype(np.int16)
+    vr = _get_default_test_video()
+    diff = vr.get_batch_diff([10, 0], num_diff=2).asnumpy()
+    assert diff.shape == (2, 2) + frames.shape[1:]
+    assert (diff[0, 0] == frames[2] - frames[1]).all()
+    assert (diff[0, 1] == frames[1] - frames[0]).all()
+    assert (diff[1] == 0).all()
+    diff = vr.get_batch_diff([10], dtype='float32').asnumpy()
+    assert np.allclose(diff[0, 0], (frames[2] - frames[1]) / 255.)
+
+def test_video_reader_batch_flow():
+    vr = _get_default_test_video()
+    frames, flow = vr.get_batch_flow([0, 10, 310], stride=2, downscale=2)
+    assert frames.shape[0] == 3
+    assert flow.shape == (3, frames.shape[1] // 2, frames.shape[2] // 2, 2)
+    # last frame pairs with itself, no motion
+    assert np.abs(flow.asnumpy()[2].astype(np.int32) - 128).max() <= 1
+
+def test_packet_reader():
+    fn = _get_default_test_video_path()
+    pr = PacketReader(fn, bitstream_filter=None)
+    assert len(pr) == 311
+    keys = pr.get_key_indices()
+    assert keys[0] == 0
+    start = keys[1] + 2 if len(keys) > 1 else 5
+    pkts = pr.get_packets(start, start + 4)
+    offsets = pkts['offsets'].asnumpy()
+    frame_indices = pkts['frame_indices'].asnumpy()
+    assert offsets[-1] == pkts['data'].shape[0]
+    assert len(offsets) == len(frame_indices) + 1
+    # aligned to preceding keyframe
+    assert pkts['flags'].asnumpy()[0] & 1
+    if len(keys) > 1:
+        assert frame_indices[0] == keys[1]
+    assert frame_indices.min() <= start
+    assert set(range(start, start + 4)) <= set(frame_indices.tolist())
+
+def test_packet_reader_annexb():
+    fn = _get_default_test_video_path()
+    # H.264 in matroska stores length prefixed NAL units, 'auto' converts them to Annex B
+    pr = PacketReader(fn)
+    assert pr.codec_name == 'h264'
+    raw = PacketReader(fn, bitstream_filter=None)
+    pkts = pr.get_packets(0, 4)
+    raw_pkts = raw.get_packets(0, 4)
+    assert (pkts['frame_indices'].asnumpy() == raw_pkts['frame_indices'].asnumpy()).all()
+    data = pkts['data'].asnumpy().tobytes()
+    offsets = pkts['offsets'].asnumpy()
+    for begin in offsets[:-1]:
+        assert data[begin:begin + 4] == b'\x00\x00\x00\x01' or data[begin:begin + 3] == b'\x00\x00\x01'
+    # parameter sets are inserted in front of the first IDR frame
+    key = data[offsets[0]:offsets[1]]
+    nal_types = [key[i + 3] & 0x1f for i in range(len(key) - 3) if key[i:i + 3] == b'\x00\x00\x01']
+    assert 7 in nal_types and 5 in nal_types
+
+def test_video_reader_batch_multi():
+    vrs = [_get_default_test_video() for _ in range(3)]
+    indices = [[0, 5, 10], [100], [20, 300]]
+    frames = get_batch_multi(vrs + [vrs[0]], indices + [[1]]).asnumpy()
+    assert frames.shape[0] == 7
+    vr = _get_default_test_video()
+    expected = vr.get_batch([0, 5, 10, 100, 20, 300, 1]).asnumpy()
+    assert (frames == expected).all()
+
+def test_get_batch_multi_image_sequence():
+    vr = _get_default_test_video()
+    height, width, _ = vr[0].shape
+    tmpdir = tempfile.mkdtemp()
+    try:
+        imgs = [np.full((24, 32, 3), i * 20, dtype=np.uint8) for i in range(6)]
+        for i, img in enumerate(imgs):
+            _write_bmp(os.path.join(tmpdir, 'img_{}.bmp'.format(i)), img)
+        # image sequences decode in parallel on their own, here from inside a pool task
+        seqs = [ImageSequenceReader(tmpdir, width=width, height=height) for _ in range(2)]
+        frames = get_batch_multi([vr, seqs[0], seqs[1]], [[0, 10], [5, 1, 3], [2, 4]]).asnumpy()
+        assert frames.shape == (7, height, width, 3)
+        assert (frames[:2] == _get_default_test_video().get_batch([0, 10]).asnumpy()).all()
+        for frame, i in zip(frames[2:], [5, 1, 3, 2, 4]):
+            assert (frame == i * 20).all()
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_thread_safe_video_reader():
+    from concurrent.futures import ThreadPoolExecutor
+    fn = _get_default_test_video_path()
+    vr = ThreadSafeVideoReader(fn, max_cursors=3)
+    assert len(vr) == 311
+    expected = _get_default_test_video().get_batch([0, 50, 100, 150, 200, 250, 300]).asnumpy()
+    with ThreadPoolExecutor(max_workers=6) as pool:
+        results = list(pool.map(lambda i: vr.get_batch([i * 50]).asnumpy(), range(7)))
+    for i, frames in enumerate(results):
+        assert (frames[0] == expected[i]).all()
+    assert 1 <= vr.num_cursors <= 3
+    assert (vr[100].asnumpy() == expected[2]).all()
+
+def test_multi_cursor_video_reader():
+    fn = _get_default_test_video_path()
+    vr = MultiCursorVideoReader(fn, num_cursors=2)
+    keys = vr.get_key_indices()
+    regions = [keys[-1], keys[len(keys) // 2]] if len(keys) > 2 else [200, 100]
+    expected = _get_default_test_video().get_batch([regions[0], regions[0] + 1, regions[1], regions[1] + 1]).asnumpy()
+    for step in range(2):
+        assert (vr.get_batch([regions[0] + step]).asnumpy()[0] == expected[step]).all()
+        assert (vr.get_batch([regions[1] + step]).asnumpy()[0] == expected[2 + step]).all()
+    stats = vr.get_cursor_stats()
+    assert stats['requests'] == 4
+    assert stats['opened'] == 2
+    # second visits continue forward on the parked cursors
+    assert stats['hits'] >= 2
+    assert stats['recycled'] == 0
+
+def test_video_reader_batch_deadline():
+    vr = _get_default_test_video()
+    expected = vr.get_batch([5, 200, 5]).asnumpy()
+    frames, mask = vr.get_batch_deadline([5, 200, 5], timeout_ms=1e6)
+    assert mask.all()
+    assert (frames.asnumpy() == expected).all()
+    # budget already spent, only first frame in ascending order is decoded
+    frames, mask = vr.get_batch_deadline([200, 5, 6], timeout_ms=0)
+    assert mask.tolist() == [False, True, False]
+    frames = frames.asnumpy()
+    assert (frames[0] == expected[0]).all() and (frames[2] == expected[0]).all()
+    frames, mask = vr.get_batch_deadline([6, 5], timeout_ms=0, fill='zeros')
+    assert mask.tolist() == [False, True]
+    assert (frames.asnumpy()[0] == 0).all()
+    # reader is consistent afterwards
+    assert (vr[200].asnumpy() == expected[1]).all()
+
+def test_video_reader_batch_stream():
+    vr = _get_default_test_video()
+    indices = [30, 2, 100, 2, 50]
+    expected = vr.get_batch(indices).asnumpy()
+    seen = []
+    def callback(frames, positions):
+        assert frames.shape[0] == len(positions) <= 2
+        for frame, pos in zip(frames.asnumpy(), positions):
+            assert (frame == expected[pos]).all()
+            seen.append(indices[pos])
+    vr.get_batch_stream(indices, callback, chunk_size=2)
+    # decode order
+    assert seen == sorted(indices)
+    calls = []
+    def stop(frames, positions):
+        calls.append(positions)
+        return False
+    vr.get_batch_stream(indices, stop, chunk_size=1)
+    assert len(calls) == 1
+
+def test_video_loader_quarantine():
+    video = _get_default_test_video_path()
+    assert _get_default_test_video().get_error_counts() == {'decode': 0, 'demux': 0}
+    with tempfile.NamedTemporaryFile(suffix='.mp4') as bad:
+        bad.write(os.urandom(4096))
+        bad.flush()
+        vl = VideoLoader([bad.name, video], ctx=cpu(0), shape=(2, 64, 64, 3), interval=1,
+                         skip=100, shuffle=0, on_error='quarantine')
+        assert vl.quarantined == [bad.name]
+        for frames, indices in vl:
+            assert frames.shape == (2, 64, 64, 3)
+        raised = False
+        try:
+            VideoLoader([bad.name, video], ctx=cpu(0), shape=(2, 64, 64, 3), interval=1, skip=100, shuffle=0)
+        except Exception:
+            raised = True
+        assert raised, "unreadable video must raise by default"
+
+def test_video_loader_autotune():
+    video = _get_default_test_video_path()
+    old_env = {k: os.environ.get(k) for k in ('DECORD_CACHE_DIR', 'DECORD_AUTOTUNE_BATCHES')}
+    cache_dir = tempfile.mkdtemp()
+    os.environ['DECORD_CACHE_DIR'] = cache_dir
+    # a couple of candidates are enough to exercise the search
+    os.environ['DECORD_AUTOTUNE_BATCHES'] = '40'
+    try:
+        args = ([video], cpu(0), (2, 64, 64, 3), 0, 0, 0)
+        vl = VideoLoader(*args, autotune=True)
+        assert vl.config['tuning']
+        for frames, indices in vl:
+            assert frames.shape == (2, 64, 64, 3)
+            if not vl.config['tuning']:
+                break
+        tuned = vl.config
+        assert not tuned['tuning']
+        assert len(os.listdir(cache_dir)) == 1
+        # saved configuration is reused without tuning
+        assert VideoLoader(*args, autotune=True).config == tuned
+    finally:
+        for k, v in old_env.items():
+            if v is None:
+                os.environ.pop(k, None)
+            else:
+                os.environ[k] = v
+        shutil.rmtree(cache_dir)
+
+def test_video_reader_speculate():
+    video = _get_default_test_video_path()
+    vr = _get_default_test_video()
+    svr = VideoReader(video, speculate=4)
+    # constant stride, then a repeated window
+    positions = list(range(0, 120, 6)) + [200, 201, 202] * 4
+    for pos in positions:
+        assert (svr[pos].asnumpy() == vr[pos].asnumpy()).all()
+    assert svr.get_speculation_stats()['requests'] == len(positions)
+    # hits depend on how far the background decoder got, only wait until it decoded ahead
+    assert _wait_until(lambda: svr.get_speculation_stats()['decoded'] > 0)
+    batch = svr.get_batch([130, 140, 150, 130])
+    assert (batch.asnumpy() == vr.get_batch([130, 140, 150, 130]).asnumpy()).all()
+    # counters of the wrapped reader
+    assert svr.get_error_counts() == {'decode': 0, 'demux': 0}
+
+def test_memory_budget():
+    video = _get_default_test_video_path()
+    args = ([video], cpu(0), (2, 64, 64, 3), 0, 0, 0)
+    expected = [indices.asnumpy() for _, (_, indices) in zip(range(8), VideoLoader(*args))]
+    vrs = [_get_default_test_video() for _ in range(3)]
+    for vr in vrs:
+        vr[10]
+    vl = VideoLoader(*args, prefetch=4)
+    batch_bytes = 2 * 64 * 64 * 3
+    try:
+        # more than the next batch must be prefetched, it is never dropped
+        assert _wait_until(lambda: memory_usage()['prefetch']['used'] >= 2 * batch_bytes)
+        set_memory_budget(1)
+        usage = memory_usage()
+        assert usage['reader']['released'] > 0
+        assert usage['prefetch']['released'] > 0
+        # closed decoders reopen at the same position
+        ref = _get_default_test_video().get_batch([11]).asnumpy()[0]
+        for vr in vrs:
+            assert (vr.next().asnumpy() == ref).all()
+        # dropped batches are decoded again in order
+        for (_, indices), exp in zip(vl, expected):
+            assert (indices.asnumpy() == exp).all()
+        # configured depth comes back as batches are produced with memory available again
+        set_memory_budget(None)
+        vl.next()
+        assert _wait_until(lambda: memory_usage()['prefetch']['used'] >= 4 * batch_bytes)
+    finally:
+        set_memory_budget(None)
+
+def test_video_loader_weighted():
+    video = _get_default_test_video_path()
+    args = ([video, video], cpu(0), (2, 32, 32, 3), 0, 20, 5)
+    vl = VideoLoader(*args, weights=[0, 1])
+    assert all((indices.asnumpy()[:, 0] == 1).all() for _, indices in vl)
+    # new weights apply from next epoch
+    vl.set_weights([1, 0])
+    vl.reset()
+    assert all((indices.asnumpy()[:, 0] == 0).all() for _, indices in vl)
+    # shards split an epoch without overlap, weight 0 videos are left out
+    shards = [VideoLoader(*args, weights=[1, 0], replacement=False, num_shards=2, shard_id=i, seed=3)
+              for i in range(2)]
+    seen = [tuple(indices.asnumpy()[0]) for vl in shards for _, indices in vl]
+    assert len(seen) == len(set(seen)) == len(shards[0]) * 2
+    assert all(v == 0 for v, _ in seen)
+
+def _ffmpeg_cmd():
+    """Command prefix of the ffmpeg binary, skip the test if not installed."""
+    if shutil.which('ffmpeg') is None:
+        raise unittest.SkipTest('ffmpeg binary required to generate test clip')
+    return ['ffmpeg', '-y', '-loglevel', 'error']
+
+def _make_rotated_clip(path, clockwise):
+    """Encode a 96x48 clip with display matrix rotation."""
+    cmd = _ffmpeg_cmd()
+    enc = ['-f', 'lavfi', '-i', 'testsrc=duration=1:size=96x48:rate=5', '-pix_fmt', 'yuv420p']
+    # ffmpeg 6+ takes counter clockwise -display_rotation, older versions the clockwise rotate tag
+    if subprocess.call(cmd + ['-display_rotation', str((360 - clockwise) % 360)] + enc + [path]) != 0:
+        subprocess.check_call(cmd + enc + ['-metadata:s:v:0', 'rotate={}'.format(clockwise), path])
+
+def test_video_reader_autorotate():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        for clockwise, k in ((90, -1), (270, 1)):
+            path = os.path.join(tmpdir, 'rot{}.mp4'.format(clockwise))
+            _make_rotated_clip(path, clockwise)
+            raw = VideoReader(path, autorotate=False)[0].asnumpy().astype('int32')
+            frame = VideoReader(path)[0].asnumpy().astype('int32')
+            assert raw.shape == (48, 96, 3)
+            assert frame.shape == (96, 48, 3)
+            # rotated the displayed way, not the opposite one
+            err = np.abs(frame - np.rot90(raw, k=k)).mean()
+            assert err < 2, err
+            assert np.abs(frame - np.rot90(raw, k=-k)).mean() > err + 10
+    finally:
+        shutil.rmtree(tmpdir)
+
+def test_video_reader_rendition():
+    tmpdir = tempfile.mkdtemp()
+    try:
+        # stream 0 is 128x64, stream 1 the same content at 64x32
+        path = os.path.join(tmpdir, 'renditions.mp4')
+        subprocess.check_call(_ffmpeg_cmd() + [
+            '-f', 'lavfi', '-i', 'testsrc=duration=1:size=128x64:rate=5',
+            '-filter_complex', '[0:v]split=2[a][b];[b]scale=64:32[c]',
+            '-map', '[a]', '-map', '[c]', '-pix_fmt', 'yuv420p', path])
+        assert VideoReader(path, width=60, height=30).stream == 1
+        assert VideoReader(path, width=100, height=50).stream == 0
+        # explicit stream is kept, whatever the output size
+        vr = VideoReader(path, width=60, height=30, stream=0)
+        assert vr.stream == 0
+        assert vr[0].shape == (30, 60, 3)
+        assert VideoReader(path, stream=1)[0].shape == (32, 64, 3)
+    finally:
+        shutil.rmtree(tmpdir)
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
@@ -8,3 +8,7 @@ ffmpeg -n -f lavfi -i testsrc=duration=3000:size=1280x720:rate=1 -pix_fmt yuv420
 
 # generate 100 sec testsrc H.264 video, with keyframes interval 5
 ffmpeg -n -f lavfi -i testsrc=duration=3000:size=1280x720:rate=1 -pix_fmt yuv420p -vcodec libx264 -x264-params keyint=5:scenecut=0 /tmp/testsrc_h264_100s_ki5.mp4
+
+# generate 1 sec 64x64 H.264 and MPEG-4 clips, for reader lifecycle tests
+ffmpeg -n -f lavfi -i testsrc=duration=1:size=64x64:rate=25 -pix_fmt yuv420p -vcodec libx264 /tmp/testsrc_h264_64x64_1s.mp4
+ffmpeg -n -f lavfi -i testsrc=duration=1:size=64x64:rate=25 -pix_fmt yuv420p -vcodec mpeg4 /tmp/testsrc_mpeg4_64x64_1s.mp4